@@ -1,19 +1,72 @@
 #include "WebSocketServer.hpp"
+#include <array>
+#include <chrono>
+#include <cstdlib>
 #include <iostream>
 #include <thread>
 #include <nlohmann/json.hpp>
 #include <boost/beast/core.hpp>
+#if defined(__linux__)
+#include <linux/sockios.h>
+#include <sys/ioctl.h>
+#endif
 
 // Include các Module để xử lý logic đặc thù
 #include "../modules/WebcamManager.hpp"
 #include "../modules/ScreenManager.hpp"
 #include "../modules/FileManager.hpp"
 #include "../modules/EdgeManager.hpp"
+#include "../utils/FrameBufferPool.hpp"
 
 namespace beast = boost::beast;
 namespace websocket = beast::websocket;
 using json = nlohmann::json;
 
+namespace {
+// payload.layer -> ScreenProtocol::Layer, tên lạ = LAYER_NONE
+uint8_t parse_layer(const std::string& name) {
+    if (name == "thumbnail") return ScreenProtocol::LAYER_THUMBNAIL;
+    if (name == "medium") return ScreenProtocol::LAYER_MEDIUM;
+    if (name == "full") return ScreenProtocol::LAYER_FULL;
+    return ScreenProtocol::LAYER_NONE;
+}
+
+const char* layer_name(int layer) {
+    switch (layer) {
+        case ScreenProtocol::LAYER_THUMBNAIL: return "thumbnail";
+        case ScreenProtocol::LAYER_MEDIUM: return "medium";
+        case ScreenProtocol::LAYER_FULL: return "full";
+        default: return "custom";
+    }
+}
+
+// Đo kết nối của 1 session cho bộ điều khiển tốc độ của screen stream: ping WebSocket mang thời điểm gửi,
+// pong về (xử lý trong lúc thread session đang read) thì ra RTT. Ping xếp hàng sau dữ liệu chưa gửi
+// nên RTT gồm cả thời gian chờ trong buffer socket.
+struct StreamLink {
+    static constexpr uint64_t PING_INTERVAL_US = 1000000;
+    std::atomic<uint64_t> ping_sent_us{0};
+    std::atomic<bool> awaiting{false};
+    std::atomic<int64_t> rtt_us{-1};
+};
+
+// Toạ độ / kích thước vùng chụp trong payload: số quá lớn (hoặc số thực) kẹp về +-MAX_REGION_COORD
+// trước khi thành int, để phép cộng x + width phía sau không tràn
+constexpr int64_t MAX_REGION_COORD = 1 << 20;
+
+int region_coord(const json& region, const char* key) {
+    auto it = region.find(key);
+    // Đọc dạng double (đúng cho cả số nguyên âm / dương / số thực), kẹp xong mới ép về int
+    const double v = (it != region.end() && it->is_number()) ? it->get<double>() : 0.0;
+    return (int)std::max<double>(-MAX_REGION_COORD, std::min<double>(MAX_REGION_COORD, v));
+}
+
+uint64_t steady_us() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+} // namespace
+
 WebSocketServer::WebSocketServer(net::io_context& ioc, unsigned short port, CommandDispatcher& dispatcher)
     : ioc_(ioc), acceptor_(ioc, {tcp::v4(), port}), dispatcher_(dispatcher) {}
 
@@ -46,12 +99,23 @@ void WebSocketServer::do_accept() {
 void WebSocketServer::handle_session(tcp::socket socket) {
     auto ws = std::make_shared<websocket::stream<tcp::socket>>(std::move(socket));
     auto ws_mutex = std::make_shared<std::mutex>();
+    const uint64_t session_id = next_session_id_++;
+    uint64_t last_capture_hash = 0;   // Hash ảnh của CAPTURE_BINARY gần nhất đã gửi cho session này
+    uint32_t capture_seq = 0;         // seq của MSG_JPEG_SCAN, tăng mỗi lần chụp progressive
+    auto link = std::make_shared<StreamLink>();
 
     try {
         std::string client_ip = ws->next_layer().remote_endpoint().address().to_string();
         std::cout << "[SESSION] CONNECTED: " << client_ip << "\n";
 
         ws->accept();
+        ws->control_callback([link](websocket::frame_type kind, beast::string_view payload) {
+            if (kind != websocket::frame_type::pong || !link->awaiting) return;
+            const uint64_t sent = std::strtoull(std::string(payload).c_str(), nullptr, 10);
+            if (sent != link->ping_sent_us) return;   // Pong của ping khác (client tự gửi)
+            link->rtt_us = (int64_t)(steady_us() - sent);
+            link->awaiting = false;
+        });
         {
             std::lock_guard<std::mutex> lock(sessions_mtx_);
             sessions_.push_back(ws.get());
@@ -85,14 +149,186 @@ void WebSocketServer::handle_session(tcp::socket socket) {
                     }
                 }
             }
+            else if (module == "SCREEN" && (cmd == "START_STREAM" || cmd == "STOP_STREAM" || cmd == "STREAM_STATS"
+                                            || cmd == "REQUEST_KEYFRAME" || cmd == "SET_LAYER")) {
+                auto* screen = dynamic_cast<ScreenManager*>(dispatcher_.get_module("SCREEN"));
+                if (!screen) {
+                    response = {{"status", "error"}, {"message", "Screen module not available"}};
+                }
+                else if (cmd == "START_STREAM") {
+                    ScreenStreamOptions opts;
+                    if (request.contains("payload")) {
+                        opts.fps = request["payload"].value("fps", opts.fps);
+                        opts.quality = request["payload"].value("quality", opts.quality);
+                        opts.view_width = request["payload"].value("view_width", opts.view_width);
+                        opts.view_height = request["payload"].value("view_height", opts.view_height);
+                        opts.video = request["payload"].value("mode", std::string("tiles")) == "video";
+                        opts.bitrate_kbps = request["payload"].value("bitrate_kbps", opts.bitrate_kbps);
+                        std::string codec = request["payload"].value("codec", std::string("jpeg"));
+                        if (codec == "lossless" || codec == "qoi") opts.codec = ScreenProtocol::CODEC_QOI;
+                        else if (codec == "webp") opts.codec = ScreenProtocol::CODEC_WEBP;
+                        opts.adaptive = codec == "auto";
+                        opts.webp_method = request["payload"].value("webp_method", opts.webp_method);
+                        opts.refine_ms = request["payload"].value("refine_ms", opts.refine_ms);
+                        opts.refine_quality = request["payload"].value("refine_quality", opts.refine_quality);
+                        opts.latency_ms = request["payload"].value("latency_ms", opts.latency_ms);
+                        opts.layer = parse_layer(request["payload"].value("layer", std::string("custom")));
+                    }
+                    // Không hỗ trợ video thì stream tile như cũ, client xem "mode" trong response.
+                    // Lớp simulcast luôn là tile
+                    opts.video = opts.video && screen->video_stream_supported() && opts.layer == ScreenProtocol::LAYER_NONE;
+                    // Không có libwebp thì tile JPEG, client xem "codec" trong response
+                    if (opts.codec == ScreenProtocol::CODEC_WEBP && !screen->webp_supported()) opts.codec = ScreenProtocol::CODEC_JPEG;
+                    auto probe = [ws, ws_mutex, link](ScreenLinkState& out) {
+                        const uint64_t now = steady_us();
+#if defined(__linux__)
+                        int unsent = 0;
+                        if (ioctl(ws->next_layer().native_handle(), SIOCOUTQ, &unsent) == 0) out.unsent_bytes = unsent;
+#endif
+                        int64_t rtt = link->rtt_us;
+                        if (link->awaiting) {
+                            // Pong chưa về: RTT ít nhất bằng thời gian đã chờ
+                            rtt = std::max(rtt, (int64_t)(now - link->ping_sent_us));
+                        } else if (now - link->ping_sent_us >= StreamLink::PING_INTERVAL_US) {
+                            std::lock_guard<std::mutex> lock(*ws_mutex);
+                            try {
+                                if (ws->is_open()) {
+                                    link->ping_sent_us = now;
+                                    link->awaiting = true;
+                                    ws->ping(websocket::ping_data(std::to_string(now).c_str()));
+                                }
+                            } catch (...) {}
+                        }
+                        if (rtt >= 0) out.rtt_ms = (double)rtt / 1000.0;
+                    };
+                    screen->start_stream(session_id, opts, [ws, ws_mutex](const std::vector<uint8_t>& data) {
+                        std::lock_guard<std::mutex> lock(*ws_mutex);
+                        try { if(ws->is_open()) { ws->binary(true); ws->write(net::buffer(data.data(), data.size())); } } catch (...) {}
+                    }, probe);
+                    response = {{"module", "SCREEN"}, {"command", "START_STREAM"}, {"status", "success"},
+                                {"mode", opts.video ? "video" : "tiles"},
+                                {"codec", opts.adaptive ? "auto" : opts.codec == ScreenProtocol::CODEC_QOI ? "lossless"
+                                          : opts.codec == ScreenProtocol::CODEC_WEBP ? "webp" : "jpeg"},
+                                {"layer", layer_name(opts.layer)}};
+                }
+                else if (cmd == "STREAM_STATS") {
+                    ScreenStreamStats st;
+                    if (screen->stream_stats(session_id, st)) {
+                        response = {{"module", "SCREEN"}, {"command", "STREAM_STATS"}, {"status", "success"},
+                                    {"data", {{"frames_sent", st.frames_sent}, {"bytes_sent", st.bytes_sent},
+                                              {"frames_skipped", st.frames_skipped}, {"frames_merged", st.frames_merged},
+                                              {"last_age_ms", st.last_age_ms}, {"avg_age_ms", st.avg_age_ms},
+                                              {"max_age_ms", st.max_age_ms}, {"avg_encode_ms", st.avg_encode_ms},
+                                              {"scale", st.scale}, {"cursor_sent", st.cursor_sent},
+                                              {"copy_rects", st.copy_rects}, {"refine_passes", st.refine_passes},
+                                              {"layer", layer_name(st.layer)}, {"regions_shared", st.regions_shared}}}};
+                        response["data"]["link"] = {{"avg_write_ms", st.avg_write_ms}, {"send_kbps", st.send_kbps},
+                                                    {"unsent_bytes", st.unsent_bytes}, {"rtt_ms", st.rtt_ms}};
+                        response["data"]["rate"] = {{"delay_ms", st.delay_ms}, {"budget", st.rate_budget},
+                                                    {"fps", st.rate_fps}, {"quality", st.rate_quality},
+                                                    {"changes", st.rate_changes}};
+                        FrameBufferStats pool = FrameBufferPool::shared().stats();
+                        response["data"]["buffers"] = {{"allocated", pool.allocated}, {"acquired", pool.acquired},
+                                                       {"reused", pool.reused}, {"grown", pool.grown},
+                                                       {"in_use", pool.in_use}, {"pooled", pool.pooled},
+                                                       {"retained_bytes", pool.retained_bytes}, {"dropped", pool.dropped}};
+                    } else {
+                        response = {{"module", "SCREEN"}, {"command", "STREAM_STATS"}, {"status", "error"},
+                                    {"message", "Stream not running"}};
+                    }
+                }
+                else if (cmd == "SET_LAYER") {
+                    std::string name = request.contains("payload")
+                                           ? request["payload"].value("layer", std::string("custom")) : "custom";
+                    if (screen->set_stream_layer(session_id, parse_layer(name))) {
+                        response = {{"module", "SCREEN"}, {"command", "SET_LAYER"}, {"status", "success"},
+                                    {"layer", layer_name(parse_layer(name))}};
+                    } else {
+                        response = {{"module", "SCREEN"}, {"command", "SET_LAYER"}, {"status", "error"},
+                                    {"message", "Stream not running or layers not supported"}};
+                    }
+                }
+                else if (cmd == "REQUEST_KEYFRAME") {
+                    screen->request_keyframe(session_id);
+                    continue;   // Không cần trả lời, frame đầy đủ sẽ tới trong stream
+                }
+                else {
+                    screen->stop_stream(session_id);
+                    response = {{"module", "SCREEN"}, {"command", "STOP_STREAM"}, {"status", "success"}};
+                }
+            }
             else if (module == "SCREEN" && cmd == "CAPTURE_BINARY") {
-                std::vector<uint8_t> jpg_data;
-                std::string err;
+                auto* screen = dynamic_cast<ScreenManager*>(dispatcher_.get_module("SCREEN"));
+                FrameBuffer frame;   // Có thể dùng chung với session khác: chỉ đọc
+                std::string err = "Screen module not available";
                 bool should_save = true;
-                if (request.contains("payload") && request["payload"].contains("save")) {
-                    should_save = request["payload"]["save"].get<bool>();
+                bool if_changed = false;
+                bool progressive = false;
+                uint8_t codec = ScreenProtocol::CODEC_JPEG;
+                ScreenCaptureRegion region;
+                if (request.contains("payload")) {
+                    const json& payload = request["payload"];
+                    if (payload.contains("save")) should_save = payload["save"].get<bool>();
+                    if_changed = payload.value("if_changed", false);
+                    // format = "webp": ảnh WebP (nhỏ hơn JPEG) nếu server có libwebp, không thì vẫn JPEG
+                    if (payload.value("format", std::string("jpeg")) == "webp") codec = ScreenProtocol::CODEC_WEBP;
+                    // progressive = true: JPEG progressive, gửi từng scan (MSG_JPEG_SCAN) để client vẽ bản thô trước
+                    progressive = payload.value("progressive", false);
+                    region.monitor = payload.value("monitor", region.monitor);
+                    if (payload.contains("region")) {
+                        region.x = region_coord(payload["region"], "x");
+                        region.y = region_coord(payload["region"], "y");
+                        region.width = region_coord(payload["region"], "width");
+                        region.height = region_coord(payload["region"], "height");
+                    }
+                }
+                uint64_t hash = 0;
+                std::vector<size_t> scan_ends;
+                if (!screen || !screen->capture_screen_data(frame, err, should_save, region, &hash, codec,
+                                                            progressive ? &scan_ends : nullptr)) {
+                    response = {{"status", "error"}, {"message", err}};
+                }
+                else if (if_changed && !should_save && hash != 0 && hash == last_capture_hash) {
+                    // Client xin "chỉ gửi khi đổi" và ảnh giống hệt lần trước -> message nhỏ thay vì cả JPEG
+                    response = {{"module", "SCREEN"}, {"command", "CAPTURE_UNCHANGED"}, {"status", "success"}};
+                }
+                else if (!scan_ends.empty()) {
+                    // Mỗi scan 1 message, nhả khoá giữa các scan để frame stream / lệnh khác không phải chờ cả ảnh.
+                    // Header ghép với đoạn byte trong buffer dùng chung khi ghi (không copy ảnh)
+                    last_capture_hash = hash;
+                    const std::vector<uint8_t>& jpg_data = frame.bytes();
+                    const uint64_t start_us = steady_us();
+                    const size_t count = std::min<size_t>(scan_ends.size(), 255);
+                    const uint32_t seq = capture_seq++;
+                    std::vector<uint8_t> header;
+                    size_t begin = 0;
+                    double first_scan_ms = 0;
+                    for (size_t i = 0; i < count; i++) {
+                        const size_t end = (i + 1 == count) ? jpg_data.size() : scan_ends[i];
+                        ScreenProtocol::begin_message(header, ScreenProtocol::MSG_JPEG_SCAN, seq, start_us);
+                        ScreenProtocol::put_u8(header, (uint8_t)i);
+                        ScreenProtocol::put_u8(header, (uint8_t)count);
+                        const std::array<net::const_buffer, 2> message{
+                            net::buffer(header), net::buffer(jpg_data.data() + begin, end - begin)};
+                        {
+                            std::lock_guard<std::mutex> lock(*ws_mutex);
+                            ws->binary(true);
+                            ws->write(message);
+                        }
+                        if (i == 0) first_scan_ms = (double)(steady_us() - start_us) / 1000.0;
+                        begin = end;
+                    }
+                    // Thời gian ghi xong scan đầu / cả ảnh vào socket (phía server, chưa gồm mạng + giải mã ở client;
+                    // thời gian tới lúc ảnh hiện do client đo: "First paint")
+                    const double total_ms = (double)(steady_us() - start_us) / 1000.0;
+                    response = {{"module", "SCREEN"}, {"command", "CAPTURE_COMPLETE"}, {"status", "success"},
+                                {"progressive", true}, {"scans", count}, {"bytes", jpg_data.size()},
+                                {"first_scan_bytes", scan_ends[0]}, {"first_scan_ms", first_scan_ms},
+                                {"total_ms", total_ms}};
                 }
-                if (ScreenManager::capture_screen_data(jpg_data, err, should_save)) {
+                else {
+                    last_capture_hash = hash;
+                    const std::vector<uint8_t>& jpg_data = frame.bytes();
                     {
                         std::lock_guard<std::mutex> lock(*ws_mutex);
                         ws->binary(true);
@@ -100,8 +336,6 @@ void WebSocketServer::handle_session(tcp::socket socket) {
                     }
                     if (should_save) response = {{"module", "SCREEN"}, {"command", "CAPTURE_COMPLETE"}, {"status", "success"}};
                     else continue;
-                } else {
-                    response = {{"status", "error"}, {"message", err}};
                 }
             }
             else if (module == "FILE" && cmd == "GET") {
@@ -139,6 +373,9 @@ void WebSocketServer::handle_session(tcp::socket socket) {
     } catch (...) {}
 
     // Clean up session
+    if (auto* screen = dynamic_cast<ScreenManager*>(dispatcher_.get_module("SCREEN"))) {
+        screen->stop_stream(session_id);
+    }
     {
         std::lock_guard<std::mutex> lock(sessions_mtx_);
         sessions_.erase(std::remove(sessions_.begin(), sessions_.end(), ws.get()), sessions_.end());
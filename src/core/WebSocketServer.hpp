@@ -4,6 +4,7 @@
 #include <vector>
 #include <mutex>
 #include <memory>
+#include <atomic>
 #include "CommandDispatcher.hpp"
 
 namespace net = boost::asio;
@@ -23,6 +24,7 @@ private:
     // Quản lý session
     std::vector<boost::beast::websocket::stream<tcp::socket>*> sessions_;
     std::mutex sessions_mtx_;
+    std::atomic<uint64_t> next_session_id_{1}; // Định danh session cho SCREEN stream
 
     void do_accept();
     void handle_session(tcp::socket socket);
@@ -0,0 +1,135 @@
+#pragma once
+// Ngữ cảnh chụp màn hình X11 dùng lâu dài (chỉ dùng trên Linux).
+// Giữ kết nối Display, root window, kích thước và ảnh SHM tái sử dụng
+// để mỗi frame chỉ còn tốn phần đọc pixel + nén.
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+#ifdef HAVE_XDAMAGE
+#include <X11/extensions/Xdamage.h>
+#endif
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "ScreenProtocol.hpp"
+#include "../utils/PixelConvert.hpp"
+#include "../utils/TileDiffer.hpp"
+
+class X11CaptureContext {
+public:
+    X11CaptureContext() = default;
+    ~X11CaptureContext();
+
+    X11CaptureContext(const X11CaptureContext&) = delete;
+    X11CaptureContext& operator=(const X11CaptureContext&) = delete;
+
+    // Chụp toàn bộ root window. XImage trả về thuộc về context,
+    // chỉ hợp lệ tới lần grab() kế tiếp (không được XDestroyImage).
+    // Tự kết nối lại nếu X Server bị restart.
+    XImage* grab(std::string& error_msg);
+
+    // Chụp lại chỉ những vùng XDamage báo thay đổi từ lần gọi trước, ghi đè lên ảnh cũ.
+    // - full = true: đã đọc cả màn hình (lần đầu, đổi độ phân giải, damage quá lớn, không có XDamage)
+    // - full = false: chỉ các vùng trong damaged đã được đọc lại (rỗng = màn hình đứng yên)
+    // Dùng cho stream; CAPTURE_BINARY vẫn dùng grab().
+    XImage* grab_damaged(std::vector<TileRect>& damaged, bool& full, std::string& error_msg);
+
+    // Chỉ đọc 1 vùng của root window (đã cắt theo màn hình, rỗng -> nullptr).
+    // Ảnh riêng, không đụng tới ảnh của grab() / grab_damaged(); hợp lệ tới lần grab_region() kế tiếp.
+    XImage* grab_region(const TileRect& region, std::string& error_msg);
+
+    // Các màn hình vật lý theo XRandR (RandR >= 1.5), không có XRandR thì 1 màn hình = root window.
+    // Danh sách được cache, làm mới khi root window đổi kích thước hoặc kết nối lại.
+    bool monitors(std::vector<ScreenMonitor>& out, std::string& error_msg);
+
+    // Hình con trỏ chuột, RGBA (alpha thường), w*h*4 byte
+    struct PointerShape {
+        int width = 0, height = 0;
+        int xhot = 0, yhot = 0;
+        std::vector<uint8_t> rgba;
+    };
+
+    // Vị trí con trỏ (toạ độ root window). shape_changed = true khi hình con trỏ đã đổi từ lần gọi trước
+    // (XFixesCursorNotify), lúc đó shape chứa hình mới. Ngoài lúc đó chỉ tốn 1 XQueryPointer.
+    // false nếu không có XFixes hoặc mất kết nối.
+    bool query_cursor(int& x, int& y, bool& shape_changed, PointerShape& shape, std::string& error_msg);
+
+    // true nếu X Server có extension XFixes và đang theo dõi hình con trỏ
+    bool cursor_tracking() const { return cursor_tracking_; }
+
+    // true nếu X Server có extension DAMAGE và đang theo dõi root window
+    bool damage_tracking() const { return damage_ != 0; }
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+
+    // true nếu đang dùng MIT-SHM (XShmGetImage), false nếu fallback XGetImage
+    bool using_shm() const { return shm_image_ != nullptr; }
+
+    // Layout kênh màu tính từ red/green/blue_mask, chỉ tính lại khi kết nối mới
+    const PixelLayout& pixel_layout() const { return layout_; }
+
+private:
+    bool connect(std::string& error_msg);
+    void disconnect();
+    void drain_events();   // Xử lý ConfigureNotify khi đổi độ phân giải
+    void release_image();
+    XImage* finish_grab(XImage* img);
+    void init_layout(XImage* img);
+
+    // MIT-SHM: tạo 1 XImage trên shared memory, gắn 1 lần, dùng lại mỗi frame
+    XImage* create_shm(int w, int h, XShmSegmentInfo& info);
+    void destroy_shm(XImage*& img, XShmSegmentInfo& info);
+    bool create_shm_image();
+    void destroy_shm_image();
+    void release_region_images();
+    void query_monitors();
+
+    // XDamage: theo dõi root window, bỏ qua nếu server không hỗ trợ
+    void create_damage();
+    void destroy_damage();
+
+    // XFixes: nhận XFixesCursorNotify khi hình con trỏ đổi
+    void create_cursor_tracking();
+
+    static void on_io_error_exit(Display* display, void* user_data);
+    static int on_x_error(Display* display, XErrorEvent* ev);
+
+    Display* display_ = nullptr;
+    Window root_ = 0;
+    int width_ = 0;
+    int height_ = 0;
+
+    XImage* image_ = nullptr;      // Ảnh từ XGetImage (fallback), cấp phát mỗi frame
+    XImage* shm_image_ = nullptr;  // Ảnh shared memory, sống cùng kết nối
+    XShmSegmentInfo shm_info_{};
+    bool shm_available_ = false;   // Server có extension MIT-SHM và attach thành công
+    // XShmAttach đang chờ XSync: on_x_error chỉ đánh dấu lỗi có đúng opcode MIT-SHM + serial này
+    int shm_major_opcode_ = 0;
+    std::atomic<unsigned long> shm_attach_serial_{0};
+    std::atomic<bool> shm_attach_failed_{false};
+    PixelLayout layout_;
+    bool layout_ready_ = false;
+
+    // grab_region(): ảnh SHM theo kích thước vùng (tạo lại khi đổi kích thước) hoặc XGetImage
+    XImage* region_shm_ = nullptr;
+    XShmSegmentInfo region_shm_info_{};
+    XImage* region_image_ = nullptr;
+
+    std::vector<ScreenMonitor> monitors_;
+    bool monitors_ready_ = false;
+
+    XImage* last_image_ = nullptr; // Ảnh grab gần nhất, grab_damaged() cập nhật đè lên
+    unsigned long damage_ = 0;     // Damage handle (0 = không dùng XDamage)
+    unsigned long damage_region_ = 0;
+    int damage_event_base_ = 0;
+    bool damage_pending_ = false;  // Đã nhận DamageNotify, chưa lấy vùng ra
+
+    bool cursor_tracking_ = false;
+    int fixes_event_base_ = 0;
+    bool cursor_pending_ = false;  // Hình con trỏ đã đổi, chưa lấy ảnh
+
+    // Được set bởi IO error exit handler khi mất kết nối tới X Server
+    std::atomic<bool> connection_lost_{false};
+};
@@ -0,0 +1,560 @@
+#include "ScreenCapture.hpp"
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#ifdef HAVE_XFIXES
+#include <X11/extensions/Xfixes.h>
+#endif
+#ifdef HAVE_XRANDR
+#include <X11/extensions/Xrandr.h>
+#endif
+
+// XSetErrorHandler là toàn process: cài 1 lần, ghi nhớ display nào thuộc capture context.
+static std::once_flag g_x_error_handler_once;
+static XErrorHandler g_prev_x_error_handler = nullptr;
+static std::mutex g_capture_displays_mtx;
+static std::unordered_map<Display*, X11CaptureContext*> g_capture_displays;
+
+// Lỗi protocol trên display của capture context (VD: BadMatch khi đổi độ phân giải giữa chừng):
+// handler mặc định của Xlib sẽ exit() cả process -> chỉ log lại.
+// Display khác (InputManager...) chuyển cho handler cũ, giữ nguyên hành vi của chúng.
+int X11CaptureContext::on_x_error(Display* display, XErrorEvent* ev) {
+    X11CaptureContext* ctx = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(g_capture_displays_mtx);
+        auto it = g_capture_displays.find(display);
+        if (it != g_capture_displays.end()) ctx = it->second;
+    }
+    if (!ctx) return g_prev_x_error_handler ? g_prev_x_error_handler(display, ev) : 0;
+
+    // Lỗi của đúng request XShmAttach đang chờ XSync (VD: X Server ở máy khác -> BadAccess)
+    if (ctx->shm_major_opcode_ && ev->request_code == ctx->shm_major_opcode_
+        && ev->serial == ctx->shm_attach_serial_.load()) {
+        ctx->shm_attach_failed_ = true;
+        return 0;
+    }
+
+    char text[128] = {0};
+    XGetErrorText(display, ev->error_code, text, sizeof(text));
+    std::cerr << "[SCREEN] X error: " << text << " (request " << (int)ev->request_code << ")\n";
+    return 0;
+}
+
+X11CaptureContext::~X11CaptureContext() {
+    disconnect();
+}
+
+void X11CaptureContext::on_io_error_exit(Display* /*display*/, void* user_data) {
+    // Mặc định Xlib gọi exit() ở đây. Ta chỉ đánh dấu để grab() kết nối lại.
+    auto* self = static_cast<X11CaptureContext*>(user_data);
+    self->connection_lost_ = true;
+    std::cerr << "[SCREEN] Lost connection to X Server, will reconnect\n";
+}
+
+bool X11CaptureContext::connect(std::string& error_msg) {
+    display_ = XOpenDisplay(NULL);
+    if (!display_) {
+        error_msg = "Cannot open X Display";
+        return false;
+    }
+    connection_lost_ = false;
+    std::call_once(g_x_error_handler_once, [] {
+        g_prev_x_error_handler = XSetErrorHandler(&X11CaptureContext::on_x_error);
+    });
+    {
+        std::lock_guard<std::mutex> lock(g_capture_displays_mtx);
+        g_capture_displays[display_] = this;
+    }
+#ifdef HAVE_XSETIOERROREXITHANDLER
+    XSetIOErrorExitHandler(display_, &X11CaptureContext::on_io_error_exit, this);
+#else
+    // libX11 < 1.7: handler IO mặc định của Xlib exit() cả process, không kết nối lại được
+    static std::once_flag no_reconnect_logged;
+    std::call_once(no_reconnect_logged, [] {
+        std::cerr << "[SCREEN] libX11 < 1.7 (no XSetIOErrorExitHandler): losing the X connection ends the process\n";
+    });
+#endif
+
+    root_ = DefaultRootWindow(display_);
+
+    XWindowAttributes attributes;
+    XGetWindowAttributes(display_, root_, &attributes);
+    width_ = attributes.width;
+    height_ = attributes.height;
+
+    // Nhận ConfigureNotify để cập nhật kích thước mà không phải hỏi lại mỗi frame
+    XSelectInput(display_, root_, StructureNotifyMask);
+
+    // RC_SCREEN_NO_SHM=1 để ép dùng XGetImage (so sánh hiệu năng 2 backend)
+    const char* no_shm = std::getenv("RC_SCREEN_NO_SHM");
+    shm_available_ = XShmQueryExtension(display_) && !(no_shm && no_shm[0] == '1');
+    int shm_event = 0, shm_error = 0;
+    if (!XQueryExtension(display_, "MIT-SHM", &shm_major_opcode_, &shm_event, &shm_error)) shm_major_opcode_ = 0;
+    if (shm_available_ && !create_shm_image()) shm_available_ = false;
+
+    create_damage();
+    create_cursor_tracking();
+
+    std::cout << "[SCREEN] Capture context ready: " << width_ << "x" << height_
+              << " (" << (shm_available_ ? "MIT-SHM" : "XGetImage")
+              << (damage_ ? ", XDamage" : "") << (cursor_tracking_ ? ", XFixes cursor" : "") << ")\n";
+    return true;
+}
+
+XImage* X11CaptureContext::create_shm(int w, int h, XShmSegmentInfo& info) {
+    int screen = DefaultScreen(display_);
+    XImage* img = XShmCreateImage(display_, DefaultVisual(display_, screen), DefaultDepth(display_, screen),
+                                  ZPixmap, NULL, &info, w, h);
+    if (!img) return nullptr;
+
+    info.shmid = shmget(IPC_PRIVATE, (size_t)img->bytes_per_line * img->height, IPC_CREAT | 0600);
+    if (info.shmid < 0) {
+        XDestroyImage(img);
+        return nullptr;
+    }
+    info.shmaddr = img->data = (char*)shmat(info.shmid, NULL, 0);
+    info.readOnly = False;
+    if (info.shmaddr == (char*)-1) {
+        shmctl(info.shmid, IPC_RMID, NULL);
+        img->data = nullptr;
+        XDestroyImage(img);
+        return nullptr;
+    }
+
+    shm_attach_failed_ = false;
+    shm_attach_serial_ = NextRequest(display_);
+    Bool attached = XShmAttach(display_, &info);
+    XSync(display_, False);
+    shm_attach_serial_ = 0;
+
+    // Đánh dấu xoá ngay: segment tự giải phóng khi cả 2 phía detach (kể cả khi crash)
+    shmctl(info.shmid, IPC_RMID, NULL);
+
+    if (!attached || shm_attach_failed_) {
+        std::cerr << "[SCREEN] XShmAttach failed, falling back to XGetImage\n";
+        shmdt(info.shmaddr);
+        img->data = nullptr;
+        XDestroyImage(img);
+        return nullptr;
+    }
+    return img;
+}
+
+void X11CaptureContext::destroy_shm(XImage*& img, XShmSegmentInfo& info) {
+    if (!img) return;
+    if (!connection_lost_) XShmDetach(display_, &info);
+    shmdt(info.shmaddr);
+    img->data = nullptr;
+    XDestroyImage(img);
+    img = nullptr;
+}
+
+bool X11CaptureContext::create_shm_image() {
+    shm_image_ = create_shm(width_, height_, shm_info_);
+    return shm_image_ != nullptr;
+}
+
+void X11CaptureContext::destroy_shm_image() {
+    destroy_shm(shm_image_, shm_info_);
+}
+
+void X11CaptureContext::release_region_images() {
+    destroy_shm(region_shm_, region_shm_info_);
+    if (region_image_) {
+        XDestroyImage(region_image_);
+        region_image_ = nullptr;
+    }
+}
+
+void X11CaptureContext::create_damage() {
+#ifdef HAVE_XDAMAGE
+    // RC_SCREEN_NO_DAMAGE=1 để tắt XDamage (so sánh với so tile toàn màn hình)
+    const char* no_damage = std::getenv("RC_SCREEN_NO_DAMAGE");
+    if (no_damage && no_damage[0] == '1') return;
+
+    int error_base = 0;
+    if (!XDamageQueryExtension(display_, &damage_event_base_, &error_base)) {
+        std::cout << "[SCREEN] DAMAGE extension not available, comparing full frames\n";
+        return;
+    }
+    int fixes_event = 0, fixes_error = 0;
+    if (!XFixesQueryExtension(display_, &fixes_event, &fixes_error)) return;
+
+    // NonEmpty: chỉ 1 DamageNotify cho tới khi ta XDamageSubtract -> không bị ngập event
+    damage_ = XDamageCreate(display_, root_, XDamageReportNonEmpty);
+    damage_region_ = XFixesCreateRegion(display_, NULL, 0);
+    damage_pending_ = true;
+#endif
+}
+
+void X11CaptureContext::destroy_damage() {
+#ifdef HAVE_XDAMAGE
+    if (damage_ && !connection_lost_) {
+        XDamageDestroy(display_, damage_);
+        XFixesDestroyRegion(display_, damage_region_);
+    }
+#endif
+    damage_ = 0;
+    damage_region_ = 0;
+    damage_pending_ = false;
+}
+
+void X11CaptureContext::create_cursor_tracking() {
+#ifdef HAVE_XFIXES
+    int error_base = 0;
+    if (!XFixesQueryExtension(display_, &fixes_event_base_, &error_base)) return;
+    XFixesSelectCursorInput(display_, root_, XFixesDisplayCursorNotifyMask);
+    cursor_tracking_ = true;
+    cursor_pending_ = true;   // Lấy hình ngay lần đầu
+#endif
+}
+
+void X11CaptureContext::disconnect() {
+    destroy_damage();
+    release_image();
+    destroy_shm_image();
+    release_region_images();
+    last_image_ = nullptr;
+    monitors_ready_ = false;
+    cursor_tracking_ = false;
+    cursor_pending_ = false;
+    if (display_) {
+        // Sau IO error, XCloseDisplay chỉ giải phóng bộ nhớ, không gửi gì lên socket.
+        // Bỏ khỏi danh sách sau khi đóng: lỗi còn treo được flush trong XCloseDisplay vẫn chỉ bị log.
+        XCloseDisplay(display_);
+        {
+            std::lock_guard<std::mutex> lock(g_capture_displays_mtx);
+            auto it = g_capture_displays.find(display_);
+            if (it != g_capture_displays.end() && it->second == this) g_capture_displays.erase(it);
+        }
+        display_ = nullptr;
+    }
+    root_ = 0;
+    width_ = height_ = 0;
+    layout_ready_ = false;
+}
+
+void X11CaptureContext::release_image() {
+    if (image_) {
+        if (last_image_ == image_) last_image_ = nullptr;
+        XDestroyImage(image_);
+        image_ = nullptr;
+    }
+}
+
+void X11CaptureContext::drain_events() {
+    while (XPending(display_) > 0) {
+        XEvent ev;
+        XNextEvent(display_, &ev);
+#ifdef HAVE_XDAMAGE
+        if (damage_ && ev.type == damage_event_base_ + XDamageNotify) {
+            damage_pending_ = true;
+            continue;
+        }
+#endif
+#ifdef HAVE_XFIXES
+        if (cursor_tracking_ && ev.type == fixes_event_base_ + XFixesCursorNotify) {
+            cursor_pending_ = true;
+            continue;
+        }
+#endif
+        if (ev.type == ConfigureNotify && ev.xconfigure.window == root_) {
+            if (ev.xconfigure.width == width_ && ev.xconfigure.height == height_) continue;
+            width_ = ev.xconfigure.width;
+            height_ = ev.xconfigure.height;
+            std::cout << "[SCREEN] Screen resized: " << width_ << "x" << height_ << "\n";
+            last_image_ = nullptr;   // Ảnh cũ sai kích thước -> grab_damaged() phải chụp lại toàn bộ
+            monitors_ready_ = false; // Cắm / rút / xếp lại màn hình đều đổi kích thước root window
+
+            // Ảnh SHM có kích thước cố định -> tạo lại theo độ phân giải mới
+            if (shm_image_) {
+                destroy_shm_image();
+                if (!create_shm_image()) shm_available_ = false;
+            }
+        }
+    }
+}
+
+XImage* X11CaptureContext::grab(std::string& error_msg) {
+    error_msg.clear();
+
+    if (display_ && connection_lost_) disconnect();
+    if (!display_ && !connect(error_msg)) return nullptr;
+
+    drain_events();
+    release_image();
+
+    if (shm_image_) {
+        // Zero-copy: server ghi thẳng vào vùng nhớ chia sẻ, không serialize qua socket
+        if (XShmGetImage(display_, root_, shm_image_, 0, 0, AllPlanes)) return finish_grab(shm_image_);
+        if (connection_lost_) {
+            error_msg = "X Server connection lost";
+            disconnect();
+            return nullptr;
+        }
+        std::cerr << "[SCREEN] XShmGetImage failed, falling back to XGetImage\n";
+    }
+
+    image_ = XGetImage(display_, root_, 0, 0, width_, height_, AllPlanes, ZPixmap);
+    if (!image_) {
+        error_msg = connection_lost_ ? "X Server connection lost" : "XGetImage failed";
+        if (connection_lost_) disconnect();
+        return nullptr;
+    }
+    return finish_grab(image_);
+}
+
+XImage* X11CaptureContext::finish_grab(XImage* img) {
+    last_image_ = img;
+    init_layout(img);
+    return img;
+}
+
+void X11CaptureContext::init_layout(XImage* img) {
+    if (!layout_ready_) {
+        layout_ = PixelLayout::from_masks(img->red_mask, img->green_mask, img->blue_mask,
+                                          img->bits_per_pixel, img->byte_order == MSBFirst);
+        layout_ready_ = true;
+        std::cout << "[SCREEN] Pixel layout: " << img->bits_per_pixel << "bpp, R<<" << layout_.red_shift
+                  << " G<<" << layout_.green_shift << " B<<" << layout_.blue_shift
+                  << ", kernel " << PixelConvert::kernel_name() << "\n";
+    }
+}
+
+XImage* X11CaptureContext::grab_region(const TileRect& region, std::string& error_msg) {
+    error_msg.clear();
+
+    if (display_ && connection_lost_) disconnect();
+    if (!display_ && !connect(error_msg)) return nullptr;
+    drain_events();
+
+    // Vùng đến từ payload của client: cộng x + w bằng int64_t để không tràn int
+    TileRect r;
+    r.x = std::max(0, region.x);
+    r.y = std::max(0, region.y);
+    const int64_t right = std::min<int64_t>(width_, (int64_t)region.x + region.w);
+    const int64_t bottom = std::min<int64_t>(height_, (int64_t)region.y + region.h);
+    if (right <= r.x || bottom <= r.y) {
+        error_msg = "Capture region is outside the screen";
+        return nullptr;
+    }
+    r.w = (int)(right - r.x);
+    r.h = (int)(bottom - r.y);
+
+    if (shm_available_) {
+        // Ảnh SHM đúng kích thước vùng: XShmGetImage đọc từ (x, y) đúng w x h pixel
+        if (region_shm_ && (region_shm_->width != r.w || region_shm_->height != r.h)) {
+            destroy_shm(region_shm_, region_shm_info_);
+        }
+        if (!region_shm_) region_shm_ = create_shm(r.w, r.h, region_shm_info_);
+        if (region_shm_ && XShmGetImage(display_, root_, region_shm_, r.x, r.y, AllPlanes)) {
+            init_layout(region_shm_);
+            return region_shm_;
+        }
+        if (connection_lost_) {
+            error_msg = "X Server connection lost";
+            disconnect();
+            return nullptr;
+        }
+    }
+
+    if (region_image_) XDestroyImage(region_image_);
+    region_image_ = XGetImage(display_, root_, r.x, r.y, r.w, r.h, AllPlanes, ZPixmap);
+    if (!region_image_) {
+        error_msg = connection_lost_ ? "X Server connection lost" : "XGetImage failed";
+        if (connection_lost_) disconnect();
+        return nullptr;
+    }
+    init_layout(region_image_);
+    return region_image_;
+}
+
+void X11CaptureContext::query_monitors() {
+    monitors_.clear();
+#ifdef HAVE_XRANDR
+    int event_base = 0, error_base = 0, major = 0, minor = 0;
+    if (XRRQueryExtension(display_, &event_base, &error_base) && XRRQueryVersion(display_, &major, &minor)
+        && (major > 1 || (major == 1 && minor >= 5))) {
+        int count = 0;
+        XRRMonitorInfo* infos = XRRGetMonitors(display_, root_, True, &count);
+        for (int i = 0; i < count; i++) {
+            ScreenMonitor m;
+            char* name = infos[i].name ? XGetAtomName(display_, infos[i].name) : nullptr;
+            m.name = name ? name : "monitor-" + std::to_string(i);
+            if (name) XFree(name);
+            m.x = infos[i].x;
+            m.y = infos[i].y;
+            m.width = infos[i].width;
+            m.height = infos[i].height;
+            m.primary = infos[i].primary;
+            monitors_.push_back(m);
+        }
+        if (infos) XRRFreeMonitors(infos);
+    }
+#endif
+    // Không có XRandR (hoặc server không báo màn hình nào): coi cả root window là 1 màn hình
+    if (monitors_.empty()) {
+        ScreenMonitor m;
+        m.name = "default";
+        m.width = width_;
+        m.height = height_;
+        m.primary = true;
+        monitors_.push_back(m);
+    }
+    monitors_ready_ = true;
+}
+
+bool X11CaptureContext::monitors(std::vector<ScreenMonitor>& out, std::string& error_msg) {
+    error_msg.clear();
+    if (display_ && connection_lost_) disconnect();
+    if (!display_ && !connect(error_msg)) return false;
+    drain_events();
+    if (!monitors_ready_) query_monitors();
+    out = monitors_;
+    return true;
+}
+
+XImage* X11CaptureContext::grab_damaged(std::vector<TileRect>& damaged, bool& full, std::string& error_msg) {
+    damaged.clear();
+    full = true;
+    error_msg.clear();
+
+    if (display_ && connection_lost_) disconnect();
+    if (!display_ && !connect(error_msg)) return nullptr;
+
+    drain_events();
+    if (!damage_ || !last_image_) {
+#ifdef HAVE_XDAMAGE
+        // Chụp toàn bộ nên damage tới lúc này đã nằm trong ảnh
+        if (damage_) XDamageSubtract(display_, damage_, None, None);
+        damage_pending_ = false;
+#endif
+        return grab(error_msg);
+    }
+
+    // Không có DamageNotify từ lần trước -> màn hình đứng yên, không đọc lại gì
+    if (!damage_pending_) {
+        full = false;
+        return last_image_;
+    }
+
+#ifdef HAVE_XDAMAGE
+    // Lấy vùng damage ra trước khi đọc pixel: thay đổi xảy ra sau đó sẽ có DamageNotify mới
+    XDamageSubtract(display_, damage_, None, damage_region_);
+    damage_pending_ = false;
+
+    int count = 0;
+    XRectangle* rects = XFixesFetchRegion(display_, damage_region_, &count);
+    long long area = 0;
+    for (int i = 0; i < count; i++) {
+        TileRect r;
+        r.x = std::max(0, (int)rects[i].x);
+        r.y = std::max(0, (int)rects[i].y);
+        r.w = std::min(width_, (int)rects[i].x + (int)rects[i].width) - r.x;
+        r.h = std::min(height_, (int)rects[i].y + (int)rects[i].height) - r.y;
+        if (r.w <= 0 || r.h <= 0) continue;
+        damaged.push_back(r);
+        area += (long long)r.w * r.h;
+    }
+    if (rects) XFree(rects);
+
+    // Vùng thay đổi lớn hoặc vụn quá -> 1 lần XShmGetImage cả màn hình rẻ hơn nhiều request nhỏ
+    if (area * 2 > (long long)width_ * height_ || damaged.size() > 64) {
+        damaged.clear();
+        return grab(error_msg);
+    }
+
+    // Đọc lại từng vùng qua XGetImage rồi chép đè lên ảnh đang giữ (SHM hoặc XGetImage)
+    XImage* dst = last_image_;
+    const int bpp = dst->bits_per_pixel / 8;
+    for (const TileRect& r : damaged) {
+        XImage* part = XGetImage(display_, root_, r.x, r.y, r.w, r.h, AllPlanes, ZPixmap);
+        if (!part) {
+            damaged.clear();
+            if (connection_lost_) {
+                error_msg = "X Server connection lost";
+                disconnect();
+                return nullptr;
+            }
+            return grab(error_msg);
+        }
+        for (int y = 0; y < r.h; y++) {
+            std::memcpy(dst->data + (size_t)(r.y + y) * dst->bytes_per_line + (size_t)r.x * bpp,
+                        part->data + (size_t)y * part->bytes_per_line, (size_t)r.w * bpp);
+        }
+        XDestroyImage(part);
+    }
+    full = false;
+    return dst;
+#else
+    return grab(error_msg);
+#endif
+}
+
+bool X11CaptureContext::query_cursor(int& x, int& y, bool& shape_changed, PointerShape& shape, std::string& error_msg) {
+    shape_changed = false;
+    error_msg.clear();
+    if (display_ && connection_lost_) disconnect();
+    if (!display_ && !connect(error_msg)) return false;
+    if (!cursor_tracking_) {
+        error_msg = "XFixes not available";
+        return false;
+    }
+    drain_events();
+
+#ifdef HAVE_XFIXES
+    if (cursor_pending_) {
+        // Ảnh con trỏ kèm luôn vị trí: chỉ 1 round trip
+        XFixesCursorImage* cur = XFixesGetCursorImage(display_);
+        if (!cur) {
+            error_msg = connection_lost_ ? "X Server connection lost" : "XFixesGetCursorImage failed";
+            if (connection_lost_) disconnect();
+            return false;
+        }
+        cursor_pending_ = false;
+        x = cur->x;
+        y = cur->y;
+        shape.width = cur->width;
+        shape.height = cur->height;
+        shape.xhot = cur->xhot;
+        shape.yhot = cur->yhot;
+        shape.rgba.resize((size_t)cur->width * cur->height * 4);
+        // pixels là unsigned long (8 byte trên 64-bit) chứa ARGB 32 bit đã premultiply
+        for (size_t i = 0; i < (size_t)cur->width * cur->height; i++) {
+            const uint32_t p = (uint32_t)cur->pixels[i];
+            const uint32_t a = p >> 24;
+            uint8_t* d = &shape.rgba[i * 4];
+            uint32_t r = (p >> 16) & 0xff, g = (p >> 8) & 0xff, b = p & 0xff;
+            if (a != 0 && a != 255) {
+                r = std::min(255u, (r * 255 + a / 2) / a);
+                g = std::min(255u, (g * 255 + a / 2) / a);
+                b = std::min(255u, (b * 255 + a / 2) / a);
+            }
+            d[0] = (uint8_t)r;
+            d[1] = (uint8_t)g;
+            d[2] = (uint8_t)b;
+            d[3] = (uint8_t)a;
+        }
+        XFree(cur);
+        shape_changed = true;
+        return true;
+    }
+#else
+    (void)shape;
+#endif
+
+    Window root_ret = 0, child_ret = 0;
+    int win_x = 0, win_y = 0;
+    unsigned int mask = 0;
+    if (!XQueryPointer(display_, root_, &root_ret, &child_ret, &x, &y, &win_x, &win_y, &mask)) {
+        // Con trỏ đang ở screen khác của cùng display
+        error_msg = "Pointer is on another screen";
+        return false;
+    }
+    return true;
+}
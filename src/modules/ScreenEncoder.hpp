@@ -0,0 +1,185 @@
+#pragma once
+// Bộ nén JPEG cho ảnh chụp màn hình (chỉ dùng trên Linux).
+// Giữ encoder sống giữa các frame và nén thẳng từ bộ nhớ XImage (BGRX)
+// khi có libjpeg-turbo, không cần buffer RGB trung gian.
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <csetjmp>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <jpeglib.h>
+#include "../utils/PixelConvert.hpp"
+
+#if defined(HAVE_TURBOJPEG)
+    #include <turbojpeg.h>
+#endif
+
+#if defined(HAVE_X264)
+    #include <x264.h>
+#endif
+
+#if defined(HAVE_WEBP)
+    #include <webp/encode.h>
+#endif
+
+class JpegEncoder {
+public:
+    JpegEncoder();
+    ~JpegEncoder();
+
+    JpegEncoder(const JpegEncoder&) = delete;
+    JpegEncoder& operator=(const JpegEncoder&) = delete;
+
+    // Nén ảnh (pixels theo layout, stride = bytes_per_line) ra out.
+    // out giữ nguyên capacity giữa các lần gọi -> không cấp phát lại nếu caller dùng lại vector.
+    bool encode(const uint8_t* pixels, int width, int height, int stride, const PixelLayout& layout,
+                int quality, std::vector<uint8_t>& out, std::string& error_msg);
+
+    // Progressive JPEG (jpeg_simple_progression, luôn qua libjpeg): scan_ends[i] = vị trí byte ngay sau scan i.
+    // out[0, scan_ends[i]) + EOI (FF D9) đã là 1 JPEG hợp lệ, thô hơn -> gửi từng đoạn để client vẽ sớm.
+    bool encode_progressive(const uint8_t* pixels, int width, int height, int stride, const PixelLayout& layout,
+                            int quality, std::vector<uint8_t>& out, std::vector<size_t>& scan_ends,
+                            std::string& error_msg);
+
+    // Tên đường nén đã dùng ở lần gọi gần nhất ("tjCompress2", "libjpeg-bgrx", "libjpeg-rgb")
+    const char* last_path() const { return last_path_; }
+
+    // Buffer đầu ra tạm của encoder: new[] không khởi tạo (khác vector::resize memset cả buffer),
+    // chỉ cấp lại khi cần lớn hơn
+    struct Scratch {
+        std::unique_ptr<uint8_t[]> data;
+        size_t size = 0;
+
+        uint8_t* get(size_t min_size) {
+            if (size < min_size) grow(min_size, 0);
+            return data.get();
+        }
+        // Cấp buffer new_size byte, giữ lại keep byte đầu
+        void grow(size_t new_size, size_t keep) {
+            std::unique_ptr<uint8_t[]> bigger(new uint8_t[new_size]);
+            if (keep) std::memcpy(bigger.get(), data.get(), keep);
+            data = std::move(bigger);
+            size = new_size;
+        }
+    };
+
+private:
+    bool encode_libjpeg(const uint8_t* pixels, int width, int height, int stride, const PixelLayout& layout,
+                        int quality, bool progressive, std::vector<uint8_t>& out, std::string& error_msg);
+    // Phần có setjmp tách riêng: không biến cục bộ nào bị đổi sau setjmp (tránh -Wclobbered)
+    bool compress_rows(const uint8_t* rows, int row_stride, int quality, bool progressive,
+                       std::vector<uint8_t>& out, std::string& error_msg);
+
+    // Error manager của libjpeg: mặc định gọi exit(), ta longjmp về encode()
+    struct ErrorMgr {
+        jpeg_error_mgr pub;
+        jmp_buf jump;
+        char message[JMSG_LENGTH_MAX];
+    };
+    static void on_error_exit(j_common_ptr cinfo);
+
+    jpeg_compress_struct cinfo_;
+    ErrorMgr jerr_;
+    std::vector<uint8_t> rgb_;   // Chỉ dùng khi phải convert sang RGB (layout lạ / libjpeg cũ)
+    Scratch scratch_;            // Đầu ra tạm của tjCompress2 / libjpeg
+    const char* last_path_ = "";
+
+#if defined(HAVE_TURBOJPEG)
+    tjhandle tj_ = nullptr;
+#endif
+};
+
+// Nhóm encoder chạy song song (stage nén của screen stream).
+// Mỗi worker giữ JpegEncoder riêng; thread gọi run() cũng làm việc như worker 0.
+class JpegEncoderPool {
+public:
+    // workers <= 0: lấy từ RC_SCREEN_ENCODERS, mặc định min(4, số core)
+    explicit JpegEncoderPool(int workers = 0);
+    ~JpegEncoderPool();
+
+    JpegEncoderPool(const JpegEncoderPool&) = delete;
+    JpegEncoderPool& operator=(const JpegEncoderPool&) = delete;
+
+    int size() const { return (int)encoders_.size(); }
+
+    // Gọi fn(i, encoder) với mọi i trong [0, count), chia cho các worker. Chặn tới khi xong hết.
+    void run(size_t count, const std::function<void(size_t, JpegEncoder&)>& fn);
+
+private:
+    void worker_loop(size_t worker);
+    void drain(JpegEncoder& encoder);
+
+    std::vector<std::unique_ptr<JpegEncoder>> encoders_;
+    std::vector<std::thread> threads_;
+
+    std::mutex mtx_;
+    std::condition_variable work_cv_;
+    std::condition_variable done_cv_;
+    const std::function<void(size_t, JpegEncoder&)>* fn_ = nullptr;
+    size_t count_ = 0;
+    std::atomic<size_t> next_{0};
+    uint64_t generation_ = 0;   // Tăng mỗi lần run() -> worker biết có batch mới
+    int busy_ = 0;              // Số worker chưa xong batch hiện tại
+    bool stopping_ = false;
+};
+
+// Nén WebP (lossy, VP8) bằng libwebp: nhỏ hơn JPEG ở cùng chất lượng nhìn thấy với nội dung màn hình,
+// trình duyệt giải mã sẵn. Không giữ trạng thái giữa các lần nén -> gọi song song từ nhiều thread được.
+class WebpEncoder {
+public:
+    // method: 0 (nhanh nhất) .. 6 (nhỏ nhất, chậm nhất) với preset mặc định của libwebp;
+    // FAST = preset cho stream: method 0 + tắt loop filter / tiền xử lý (nhanh hơn nữa, byte gần như bằng method 0)
+    static constexpr int FAST = -1;
+
+    // false nếu build không có libwebp
+    static bool available();
+
+    // pixels theo layout (stride = bytes_per_line), quality 0..100. out bị ghi đè, giữ capacity.
+    static bool encode(const uint8_t* pixels, int width, int height, int stride, const PixelLayout& layout,
+                       int quality, int method, std::vector<uint8_t>& out, std::string& error_msg);
+};
+
+// Nén H.264 bằng libx264 cho chế độ stream video (mỗi session 1 encoder vì giữ frame tham chiếu riêng).
+// Preset nhanh + tune zerolatency, không B-frame, GOP dài: keyframe chỉ khi được yêu cầu / đổi kích thước.
+// Đầu ra là 1 access unit Annex-B mỗi frame (SPS/PPS đi kèm mỗi IDR) để client giải mã bằng WebCodecs.
+class H264Encoder {
+public:
+    H264Encoder() = default;
+    ~H264Encoder();
+
+    H264Encoder(const H264Encoder&) = delete;
+    H264Encoder& operator=(const H264Encoder&) = delete;
+
+    // false nếu build không có libx264
+    static bool available();
+
+    // Mở (lại) encoder. width/height phải chẵn (I420).
+    // bitrate_kbps > 0: giới hạn bitrate (VBV ~1 frame, độ trễ thấp); 0: CRF tính theo quality (10..95)
+    bool open(int width, int height, int fps, int quality, int bitrate_kbps, int threads, std::string& error_msg);
+    void close();
+
+    // true nếu encoder đang mở đúng với các tham số này
+    bool matches(int width, int height, int fps, int quality, int bitrate_kbps) const;
+
+    // Nén 1 frame (pixels theo layout, stride = bytes_per_line). keyframe = true -> ép IDR.
+    // out: access unit Annex-B (rỗng nếu encoder chưa xuất frame nào).
+    bool encode(const uint8_t* pixels, int stride, const PixelLayout& layout, bool keyframe,
+                std::vector<uint8_t>& out, bool& is_keyframe, std::string& error_msg);
+
+private:
+    int width_ = 0, height_ = 0, fps_ = 0, quality_ = 0, bitrate_kbps_ = 0;
+    int64_t pts_ = 0;
+    std::vector<uint8_t> rgb_;   // 2 hàng RGB cho mỗi lần chuyển sang I420
+
+#if defined(HAVE_X264)
+    x264_t* enc_ = nullptr;
+    x264_picture_t pic_;
+#endif
+};
@@ -0,0 +1,525 @@
+#include "ScreenEncoder.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+// ==========================================================
+// Destination manager: libjpeg ghi vào buffer tạm của encoder (không khởi tạo, giữ giữa các frame),
+// xong mới copy đúng số byte đã nén sang std::vector của caller
+// (thay jpeg_mem_dest -> không malloc mỗi frame, không memset cả buffer đầu ra)
+// ==========================================================
+namespace {
+struct VectorDest {
+    jpeg_destination_mgr pub;
+    JpegEncoder::Scratch* scratch;
+    std::vector<uint8_t>* out;
+};
+
+void vector_init_destination(j_compress_ptr cinfo) {
+    auto* dest = reinterpret_cast<VectorDest*>(cinfo->dest);
+    // Đoán trước kích thước (~1/4 ảnh RGB), buffer tạm giữ lại cho các frame sau
+    size_t guess = (size_t)cinfo->image_width * cinfo->image_height * 3 / 4 + 4096;
+    dest->pub.next_output_byte = dest->scratch->get(guess);
+    dest->pub.free_in_buffer = dest->scratch->size;
+}
+
+boolean vector_empty_output_buffer(j_compress_ptr cinfo) {
+    auto* dest = reinterpret_cast<VectorDest*>(cinfo->dest);
+    size_t used = dest->scratch->size;
+    dest->scratch->grow(used * 2, used);
+    dest->pub.next_output_byte = dest->scratch->data.get() + used;
+    dest->pub.free_in_buffer = dest->scratch->size - used;
+    return TRUE;
+}
+
+void vector_term_destination(j_compress_ptr cinfo) {
+    auto* dest = reinterpret_cast<VectorDest*>(cinfo->dest);
+    const uint8_t* begin = dest->scratch->data.get();
+    dest->out->assign(begin, begin + (dest->scratch->size - dest->pub.free_in_buffer));
+}
+
+// Layout 32bpp căn byte -> colorspace mở rộng của libjpeg-turbo / pixel format của TurboJPEG
+struct NativeFormat {
+    int rb, gb, bb;
+#if defined(JCS_EXTENSIONS)
+    J_COLOR_SPACE jcs;
+#endif
+#if defined(HAVE_TURBOJPEG)
+    int tjpf;
+#endif
+};
+
+const NativeFormat* find_native_format(const PixelLayout& layout) {
+    static const NativeFormat formats[] = {
+#if defined(JCS_EXTENSIONS) && defined(HAVE_TURBOJPEG)
+        {2, 1, 0, JCS_EXT_BGRX, TJPF_BGRX}, {0, 1, 2, JCS_EXT_RGBX, TJPF_RGBX},
+        {3, 2, 1, JCS_EXT_XBGR, TJPF_XBGR}, {1, 2, 3, JCS_EXT_XRGB, TJPF_XRGB},
+#elif defined(JCS_EXTENSIONS)
+        {2, 1, 0, JCS_EXT_BGRX}, {0, 1, 2, JCS_EXT_RGBX},
+        {3, 2, 1, JCS_EXT_XBGR}, {1, 2, 3, JCS_EXT_XRGB},
+#elif defined(HAVE_TURBOJPEG)
+        {2, 1, 0, TJPF_BGRX}, {0, 1, 2, TJPF_RGBX},
+        {3, 2, 1, TJPF_XBGR}, {1, 2, 3, TJPF_XRGB},
+#else
+        {-1, -1, -1},
+#endif
+    };
+    if (!layout.is_byte_aligned_32()) return nullptr;
+    for (const auto& f : formats) {
+        if (f.rb * 8 == layout.red_shift && f.gb * 8 == layout.green_shift && f.bb * 8 == layout.blue_shift) return &f;
+    }
+    return nullptr;
+}
+
+// Đi qua các marker của JPEG, ghi vị trí kết thúc dữ liệu entropy của mỗi scan (SOS). Trong dữ liệu entropy,
+// FF 00 là byte FF thật và FF D0..D7 là restart marker; byte FF khác mở đầu marker kế tiếp.
+bool find_scan_ends(const std::vector<uint8_t>& jpg, std::vector<size_t>& scan_ends) {
+    const size_t n = jpg.size();
+    if (n < 4 || jpg[0] != 0xFF || jpg[1] != 0xD8) return false;
+    size_t p = 2;
+    while (p + 1 < n) {
+        if (jpg[p] != 0xFF) return false;
+        const uint8_t marker = jpg[p + 1];
+        if (marker == 0xFF) { p++; continue; }   // Byte đệm trước marker
+        if (marker == 0xD9) return !scan_ends.empty();
+        if (p + 3 >= n) return false;
+        const size_t len = ((size_t)jpg[p + 2] << 8) | jpg[p + 3];
+        p += 2 + len;
+        if (marker != 0xDA) continue;
+        while (p + 1 < n && !(jpg[p] == 0xFF && jpg[p + 1] != 0x00 && (jpg[p + 1] < 0xD0 || jpg[p + 1] > 0xD7))) p++;
+        scan_ends.push_back(p);
+    }
+    return false;
+}
+} // namespace
+
+// ==========================================================
+// JpegEncoder
+// ==========================================================
+void JpegEncoder::on_error_exit(j_common_ptr cinfo) {
+    auto* err = reinterpret_cast<ErrorMgr*>(cinfo->err);
+    (*cinfo->err->format_message)(cinfo, err->message);
+    longjmp(err->jump, 1);
+}
+
+JpegEncoder::JpegEncoder() {
+    cinfo_.err = jpeg_std_error(&jerr_.pub);
+    jerr_.pub.error_exit = &JpegEncoder::on_error_exit;
+    jerr_.message[0] = '\0';
+    jpeg_create_compress(&cinfo_);
+#if defined(HAVE_TURBOJPEG)
+    tj_ = tjInitCompress();
+#endif
+}
+
+JpegEncoder::~JpegEncoder() {
+    jpeg_destroy_compress(&cinfo_);
+#if defined(HAVE_TURBOJPEG)
+    if (tj_) tjDestroy(tj_);
+#endif
+}
+
+bool JpegEncoder::encode(const uint8_t* pixels, int width, int height, int stride, const PixelLayout& layout,
+                         int quality, std::vector<uint8_t>& out, std::string& error_msg) {
+#if defined(HAVE_TURBOJPEG)
+    const NativeFormat* fmt = find_native_format(layout);
+    if (tj_ && fmt) {
+        // Buffer tạm đủ cho trường hợp xấu nhất (không khởi tạo) -> TJFLAG_NOREALLOC,
+        // rồi chỉ copy đúng số byte đã nén sang out
+        unsigned long max_size = tjBufSize(width, height, TJSAMP_420);
+        unsigned char* buf = scratch_.get(max_size);
+        unsigned long size = max_size;
+        if (tjCompress2(tj_, pixels, width, stride, height, fmt->tjpf, &buf, &size,
+                        TJSAMP_420, quality, TJFLAG_NOREALLOC | TJFLAG_FASTDCT) == 0) {
+            out.assign(buf, buf + size);
+            last_path_ = "tjCompress2";
+            return true;
+        }
+        std::cerr << "[SCREEN] tjCompress2 failed: " << tjGetErrorStr2(tj_) << ", using libjpeg\n";
+    }
+#endif
+    return encode_libjpeg(pixels, width, height, stride, layout, quality, false, out, error_msg);
+}
+
+bool JpegEncoder::encode_progressive(const uint8_t* pixels, int width, int height, int stride,
+                                     const PixelLayout& layout, int quality, std::vector<uint8_t>& out,
+                                     std::vector<size_t>& scan_ends, std::string& error_msg) {
+    scan_ends.clear();
+    if (!encode_libjpeg(pixels, width, height, stride, layout, quality, true, out, error_msg)) return false;
+    if (!find_scan_ends(out, scan_ends)) {
+        error_msg = "JPEG encode failed: malformed progressive stream";
+        return false;
+    }
+    return true;
+}
+
+bool JpegEncoder::encode_libjpeg(const uint8_t* pixels, int width, int height, int stride, const PixelLayout& layout,
+                                 int quality, bool progressive, std::vector<uint8_t>& out, std::string& error_msg) {
+    cinfo_.image_width = width;
+    cinfo_.image_height = height;
+
+#if defined(JCS_EXTENSIONS)
+    const NativeFormat* fmt = find_native_format(layout);
+    if (fmt) {
+        // libjpeg-turbo đọc thẳng BGRX/RGBX từ XImage, stride = bytes_per_line
+        cinfo_.input_components = 4;
+        cinfo_.in_color_space = fmt->jcs;
+        last_path_ = "libjpeg-bgrx";
+        return compress_rows(pixels, stride, quality, progressive, out, error_msg);
+    }
+#endif
+    rgb_.resize((size_t)width * height * 3);
+    PixelConvert::to_rgb(pixels, stride, rgb_.data(), width * 3, width, height, layout);
+    cinfo_.input_components = 3;
+    cinfo_.in_color_space = JCS_RGB;
+    last_path_ = "libjpeg-rgb";
+    return compress_rows(rgb_.data(), width * 3, quality, progressive, out, error_msg);
+}
+
+bool JpegEncoder::compress_rows(const uint8_t* rows, int row_stride, int quality, bool progressive,
+                                std::vector<uint8_t>& out, std::string& error_msg) {
+    VectorDest dest;
+    dest.pub.init_destination = vector_init_destination;
+    dest.pub.empty_output_buffer = vector_empty_output_buffer;
+    dest.pub.term_destination = vector_term_destination;
+    dest.scratch = &scratch_;
+    dest.out = &out;
+
+    if (setjmp(jerr_.jump)) {
+        jpeg_abort_compress(&cinfo_);
+        cinfo_.dest = nullptr;
+        error_msg = std::string("JPEG encode failed: ") + jerr_.message;
+        return false;
+    }
+
+    cinfo_.dest = &dest.pub;
+    jpeg_set_defaults(&cinfo_);
+    jpeg_set_quality(&cinfo_, quality, TRUE);
+    // jpeg_set_defaults xoá scan script cũ -> encoder dùng lại cho frame baseline không bị ảnh hưởng
+    if (progressive) jpeg_simple_progression(&cinfo_);
+    jpeg_start_compress(&cinfo_, TRUE);
+
+    while (cinfo_.next_scanline < cinfo_.image_height) {
+        JSAMPROW row_pointer[1];
+        row_pointer[0] = const_cast<JSAMPROW>(rows + (size_t)cinfo_.next_scanline * row_stride);
+        jpeg_write_scanlines(&cinfo_, row_pointer, 1);
+    }
+
+    jpeg_finish_compress(&cinfo_);
+    cinfo_.dest = nullptr;
+    return true;
+}
+
+// ==========================================================
+// WebpEncoder
+// ==========================================================
+bool WebpEncoder::available() {
+#if defined(HAVE_WEBP)
+    return true;
+#else
+    return false;
+#endif
+}
+
+#if defined(HAVE_WEBP)
+namespace {
+// Writer của libwebp: nối thẳng vào std::vector của caller (không qua WebPMemoryWriter + copy)
+int vector_writer(const uint8_t* data, size_t size, const WebPPicture* picture) {
+    auto* out = static_cast<std::vector<uint8_t>*>(picture->custom_ptr);
+    out->insert(out->end(), data, data + size);
+    return 1;
+}
+} // namespace
+#endif
+
+bool WebpEncoder::encode(const uint8_t* pixels, int width, int height, int stride, const PixelLayout& layout,
+                         int quality, int method, std::vector<uint8_t>& out, std::string& error_msg) {
+#if defined(HAVE_WEBP)
+    WebPConfig config;
+    const bool fast = method == FAST;
+    if (!WebPConfigPreset(&config, WEBP_PRESET_DEFAULT, (float)std::max(0, std::min(100, quality)))) {
+        error_msg = "WebP: libwebp version mismatch";
+        return false;
+    }
+    config.method = fast ? 0 : std::max(0, std::min(6, method));
+    if (fast) {
+        // Tắt loop filter + tiền xử lý: bớt ~15% thời gian, byte gần như không đổi (đo bằng screen_codec_bench).
+        // Không hạ segments / SNS: ảnh màn hình to gấp đôi
+        config.filter_strength = 0;
+        config.autofilter = 0;
+        config.preprocessing = 0;
+    }
+    config.thread_level = 0;   // Stream đã nén song song nhiều vùng trên pool
+    if (!WebPValidateConfig(&config)) {
+        error_msg = "WebP: invalid config";
+        return false;
+    }
+
+    WebPPicture pic;
+    if (!WebPPictureInit(&pic)) {
+        error_msg = "WebP: libwebp version mismatch";
+        return false;
+    }
+    pic.width = width;
+    pic.height = height;
+
+    // BGRX / RGBX đọc thẳng từ XImage, layout khác chuyển sang RGB trước
+    int imported = 0;
+    if (layout.is_byte_aligned_32() && layout.red_shift == 16 && layout.blue_shift == 0) {
+        imported = WebPPictureImportBGRX(&pic, pixels, stride);
+    } else if (layout.is_byte_aligned_32() && layout.red_shift == 0 && layout.blue_shift == 16) {
+        imported = WebPPictureImportRGBX(&pic, pixels, stride);
+    } else {
+        thread_local std::vector<uint8_t> rgb;
+        rgb.resize((size_t)width * height * 3);
+        PixelConvert::to_rgb(pixels, stride, rgb.data(), width * 3, width, height, layout);
+        imported = WebPPictureImportRGB(&pic, rgb.data(), width * 3);
+    }
+    if (!imported) {
+        WebPPictureFree(&pic);
+        error_msg = "WebP: out of memory";
+        return false;
+    }
+
+    out.clear();
+    pic.writer = vector_writer;
+    pic.custom_ptr = &out;
+    const bool ok = WebPEncode(&config, &pic) != 0;
+    if (!ok) error_msg = "WebP encode failed (error " + std::to_string((int)pic.error_code) + ")";
+    WebPPictureFree(&pic);
+    return ok;
+#else
+    (void)pixels; (void)width; (void)height; (void)stride; (void)layout; (void)quality; (void)method; (void)out;
+    error_msg = "Server built without libwebp";
+    return false;
+#endif
+}
+
+// ==========================================================
+// JpegEncoderPool
+// ==========================================================
+JpegEncoderPool::JpegEncoderPool(int workers) {
+    if (workers <= 0) {
+        const char* env = std::getenv("RC_SCREEN_ENCODERS");
+        if (env) workers = std::atoi(env);
+    }
+    if (workers <= 0) workers = (int)std::min(4u, std::max(1u, std::thread::hardware_concurrency()));
+    workers = std::min(workers, 64);
+
+    for (int i = 0; i < workers; i++) encoders_.push_back(std::make_unique<JpegEncoder>());
+    for (int i = 1; i < workers; i++) threads_.emplace_back(&JpegEncoderPool::worker_loop, this, (size_t)i);
+}
+
+JpegEncoderPool::~JpegEncoderPool() {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stopping_ = true;
+    }
+    work_cv_.notify_all();
+    for (auto& t : threads_) t.join();
+}
+
+void JpegEncoderPool::drain(JpegEncoder& encoder) {
+    for (size_t i = next_++; i < count_; i = next_++) (*fn_)(i, encoder);
+}
+
+void JpegEncoderPool::run(size_t count, const std::function<void(size_t, JpegEncoder&)>& fn) {
+    if (count == 0) return;
+    if (threads_.empty() || count == 1) {
+        for (size_t i = 0; i < count; i++) fn(i, *encoders_[0]);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        fn_ = &fn;
+        count_ = count;
+        next_ = 0;
+        busy_ = (int)threads_.size();
+        generation_++;
+    }
+    work_cv_.notify_all();
+
+    drain(*encoders_[0]);
+
+    std::unique_lock<std::mutex> lock(mtx_);
+    done_cv_.wait(lock, [this] { return busy_ == 0; });
+    fn_ = nullptr;
+}
+
+void JpegEncoderPool::worker_loop(size_t worker) {
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> lock(mtx_);
+    for (;;) {
+        work_cv_.wait(lock, [&] { return stopping_ || generation_ != seen; });
+        if (stopping_) return;
+        seen = generation_;
+
+        lock.unlock();
+        drain(*encoders_[worker]);
+        lock.lock();
+
+        if (--busy_ == 0) done_cv_.notify_one();
+    }
+}
+
+// ==========================================================
+// H264Encoder
+// ==========================================================
+H264Encoder::~H264Encoder() {
+    close();
+}
+
+bool H264Encoder::available() {
+#if defined(HAVE_X264)
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool H264Encoder::matches(int width, int height, int fps, int quality, int bitrate_kbps) const {
+#if defined(HAVE_X264)
+    return enc_ && width == width_ && height == height_ && fps == fps_ && quality == quality_
+        && bitrate_kbps == bitrate_kbps_;
+#else
+    (void)width; (void)height; (void)fps; (void)quality; (void)bitrate_kbps;
+    return false;
+#endif
+}
+
+void H264Encoder::close() {
+#if defined(HAVE_X264)
+    if (enc_) {
+        x264_encoder_close(enc_);
+        x264_picture_clean(&pic_);
+        enc_ = nullptr;
+    }
+#endif
+    width_ = height_ = 0;
+}
+
+bool H264Encoder::open(int width, int height, int fps, int quality, int bitrate_kbps, int threads,
+                       std::string& error_msg) {
+    close();
+#if defined(HAVE_X264)
+    // RC_SCREEN_X264_PRESET: đổi preset (mặc định "superfast": nhỏ hơn ultrafast rõ rệt, vẫn nhẹ CPU)
+    const char* preset = std::getenv("RC_SCREEN_X264_PRESET");
+    x264_param_t param;
+    if (x264_param_default_preset(&param, preset && preset[0] ? preset : "superfast", "zerolatency") < 0) {
+        error_msg = "x264: unknown preset";
+        return false;
+    }
+    param.i_width = width;
+    param.i_height = height;
+    param.i_csp = X264_CSP_I420;
+    param.i_fps_num = fps;
+    param.i_fps_den = 1;
+    param.i_threads = threads;
+    param.b_sliced_threads = 1;        // Chia slice trong 1 frame: nhiều thread mà không thêm frame trễ
+    param.i_bframe = 0;
+    param.i_keyint_max = X264_KEYINT_MAX_INFINITE;   // Keyframe khi client yêu cầu (REQUEST_KEYFRAME)
+    param.b_repeat_headers = 1;        // SPS/PPS trước mỗi IDR: client vào giữa chừng vẫn giải mã được
+    param.b_annexb = 1;
+    param.i_log_level = X264_LOG_WARNING;
+    if (bitrate_kbps > 0) {
+        param.rc.i_rc_method = X264_RC_ABR;
+        param.rc.i_bitrate = bitrate_kbps;
+        param.rc.i_vbv_max_bitrate = bitrate_kbps;
+        param.rc.i_vbv_buffer_size = std::max(1, bitrate_kbps / fps);   // ~1 frame: không dồn frame lớn
+    } else {
+        // quality 10..95 -> CRF 38..18
+        param.rc.i_rc_method = X264_RC_CRF;
+        param.rc.f_rf_constant = 38.0f - (float)(quality - 10) * 20.0f / 85.0f;
+    }
+    // Baseline (constrained): trình duyệt nào có WebCodecs cũng giải mã được
+    if (x264_param_apply_profile(&param, "baseline") < 0) {
+        error_msg = "x264: cannot apply baseline profile";
+        return false;
+    }
+
+    if (x264_picture_alloc(&pic_, X264_CSP_I420, width, height) < 0) {
+        error_msg = "x264_picture_alloc failed";
+        return false;
+    }
+    enc_ = x264_encoder_open(&param);
+    if (!enc_) {
+        x264_picture_clean(&pic_);
+        error_msg = "x264_encoder_open failed";
+        return false;
+    }
+    width_ = width;
+    height_ = height;
+    fps_ = fps;
+    quality_ = quality;
+    bitrate_kbps_ = bitrate_kbps;
+    pts_ = 0;
+    rgb_.resize((size_t)width * 3 * 2);
+    return true;
+#else
+    (void)width; (void)height; (void)fps; (void)quality; (void)bitrate_kbps; (void)threads;
+    error_msg = "H.264 stream not available (built without libx264)";
+    return false;
+#endif
+}
+
+bool H264Encoder::encode(const uint8_t* pixels, int stride, const PixelLayout& layout, bool keyframe,
+                         std::vector<uint8_t>& out, bool& is_keyframe, std::string& error_msg) {
+    out.clear();
+    is_keyframe = false;
+#if defined(HAVE_X264)
+    if (!enc_) {
+        error_msg = "H.264 encoder not open";
+        return false;
+    }
+
+    // Mỗi lần 2 hàng: to_rgb (kernel SIMD) rồi RGB -> I420 BT.601 limited range, chroma lấy trung bình 2x2
+    const size_t rgb_stride = (size_t)width_ * 3;
+    for (int y = 0; y < height_; y += 2) {
+        PixelConvert::to_rgb(pixels + (size_t)y * stride, stride, rgb_.data(), (int)rgb_stride, width_, 2, layout);
+        const uint8_t* r0 = rgb_.data();
+        const uint8_t* r1 = r0 + rgb_stride;
+        uint8_t* y0 = pic_.img.plane[0] + (size_t)y * pic_.img.i_stride[0];
+        uint8_t* y1 = y0 + pic_.img.i_stride[0];
+        uint8_t* u = pic_.img.plane[1] + (size_t)(y / 2) * pic_.img.i_stride[1];
+        uint8_t* v = pic_.img.plane[2] + (size_t)(y / 2) * pic_.img.i_stride[2];
+        for (int x = 0; x < width_; x += 2) {
+            int rs = 0, gs = 0, bs = 0;
+            for (int dy = 0; dy < 2; dy++) {
+                const uint8_t* row = dy ? r1 : r0;
+                uint8_t* yrow = dy ? y1 : y0;
+                for (int dx = 0; dx < 2; dx++) {
+                    const uint8_t* p = row + (size_t)(x + dx) * 3;
+                    yrow[x + dx] = (uint8_t)(((66 * p[0] + 129 * p[1] + 25 * p[2] + 128) >> 8) + 16);
+                    rs += p[0]; gs += p[1]; bs += p[2];
+                }
+            }
+            rs = (rs + 2) >> 2; gs = (gs + 2) >> 2; bs = (bs + 2) >> 2;
+            u[x / 2] = (uint8_t)(((-38 * rs - 74 * gs + 112 * bs + 128) >> 8) + 128);
+            v[x / 2] = (uint8_t)(((112 * rs - 94 * gs - 18 * bs + 128) >> 8) + 128);
+        }
+    }
+
+    pic_.i_type = keyframe ? X264_TYPE_IDR : X264_TYPE_AUTO;
+    pic_.i_pts = pts_++;
+    x264_nal_t* nals = nullptr;
+    int nal_count = 0;
+    x264_picture_t pic_out;
+    int size = x264_encoder_encode(enc_, &nals, &nal_count, &pic_, &pic_out);
+    if (size < 0) {
+        error_msg = "x264_encoder_encode failed";
+        return false;
+    }
+    if (size > 0) {
+        // Các NAL của 1 frame nằm liền nhau bắt đầu từ nals[0].p_payload
+        out.assign(nals[0].p_payload, nals[0].p_payload + size);
+        is_keyframe = pic_out.b_keyframe != 0;
+    }
+    return true;
+#else
+    (void)pixels; (void)stride; (void)layout; (void)keyframe;
+    error_msg = "H.264 stream not available (built without libx264)";
+    return false;
+#endif
+}
@@ -2,6 +2,9 @@
 #include "../interfaces/IRemoteModule.hpp"
 #include <vector>
 #include <string>
+#include <cstdint>
+#include "ScreenProtocol.hpp"
+#include "../utils/FrameBufferPool.hpp"
 
 // --- CẤU HÌNH CHO WINDOWS ---
 #if defined(_WIN32)
@@ -16,6 +19,12 @@
     #include <jpeglib.h>
     #include <iostream>
     #include <cstring>
+    #include <chrono>
+    #include <mutex>
+    #include "ScreenCapture.hpp"
+    #include "ScreenEncoder.hpp"
+    #include "ScreenPersist.hpp"
+    #include "ScreenStream.hpp"
 #endif
 class ScreenManager : public IRemoteModule {
 public:
@@ -23,9 +32,62 @@ public:
         static const std::string name = "SCREEN"; return name; 
     }
     
+#if defined(__linux__)
+    ScreenManager();
+#endif
     json handle_command(const json& request) override;
 
-    // Hàm public để Main gọi trực tiếp
-    //static bool capture_screen_data(std::vector<uint8_t>& out_buffer, std::string& error_msg);
-    static bool capture_screen_data(std::vector<uint8_t>& out_buffer, std::string& error_msg, bool save_to_disk = true); // Mặc định là lưu vào ổ đĩa, còn khi streaming thì không lưu
+    // Hàm public để WebSocketServer gọi trực tiếp (lấy module qua dispatcher).
+    // out: JPEG trong buffer dùng chung, chỉ đọc (Linux: nhiều viewer cùng lúc nhận cùng 1 buffer)
+    bool capture_screen_data(FrameBuffer& out, std::string& error_msg, bool save_to_disk = true, // Mặc định là lưu vào ổ đĩa, còn khi streaming thì không lưu
+                             const ScreenCaptureRegion& region = {}, // Chỉ đọc + nén vùng / màn hình được chọn
+                             uint64_t* frame_hash = nullptr, // Hash ảnh gốc (FrameHash), 0 = không tính được
+                             uint8_t codec = ScreenProtocol::CODEC_JPEG, // CODEC_WEBP: nén WebP (Linux + libwebp), còn lại JPEG
+                             std::vector<size_t>* scan_ends = nullptr); // Khác null: progressive JPEG (Linux), nhận vị trí cuối mỗi scan; rỗng = ảnh thường
+
+    // Danh sách màn hình vật lý (lệnh LIST_MONITORS), index dùng cho CAPTURE_BINARY payload.monitor
+    bool list_monitors(std::vector<ScreenMonitor>& out, std::string& error_msg);
+
+    // Server tự đẩy frame cho session theo FPS (thay cho client gửi CAPTURE_BINARY liên tục).
+    // probe: đo kết nối cho bộ điều khiển tốc độ (opts.latency_ms), có thể rỗng
+    void start_stream(uint64_t session_id, const ScreenStreamOptions& opts, ScreenFrameCallback callback,
+                      ScreenLinkProbe probe = nullptr);
+    void stop_stream(uint64_t session_id);
+    // Số liệu stream của session (tuổi frame lúc gửi, frame bị gộp...). false nếu session không stream
+    bool stream_stats(uint64_t session_id, ScreenStreamStats& out);
+    // Gửi lại toàn bộ màn hình (chế độ video: frame IDR) ở lần gửi tới
+    void request_keyframe(uint64_t session_id);
+    // Chuyển session đang stream sang lớp simulcast khác (ScreenProtocol::Layer), không chụp lại từ đầu.
+    // false nếu session không stream hoặc không hỗ trợ (Windows)
+    bool set_stream_layer(uint64_t session_id, uint8_t layer);
+    // true nếu START_STREAM hỗ trợ mode = "video" (H.264)
+    bool video_stream_supported() const;
+    // true nếu tile stream / CAPTURE_BINARY nén được WebP (codec / format = "webp")
+    bool webp_supported() const;
+
+#if defined(__linux__)
+private:
+    // Kết nối X11 + buffer dùng lại giữa các frame, nhiều session dùng chung
+    X11CaptureContext capture_ctx_;
+    JpegEncoder jpeg_encoder_;
+    std::mutex capture_mtx_;
+    ScreenStreamer streamer_{capture_ctx_, capture_mtx_};
+    ScreenshotWriter screenshot_writer_;   // Lưu ảnh CAPTURE_BINARY ở thread nền
+    // Ảnh nén của lần CAPTURE_BINARY trước, dùng chung cho mọi viewer (buffer không sửa sau khi nén xong):
+    // trong capture_cache_ttl_ với cùng vùng + codec + quality (+ progressive) thì trả luôn, quá hạn thì chụp lại nhưng ảnh gốc
+    // cùng hash thì vẫn không nén lại. Khoá bằng capture_mtx_.
+    struct CaptureCache {
+        FrameBuffer jpg;
+        uint64_t hash = 0;
+        bool whole = true;
+        TileRect rect;
+        uint8_t codec = ScreenProtocol::CODEC_JPEG;
+        int quality = 0;
+        bool progressive = false;
+        std::vector<size_t> scan_ends;   // Chỉ khi progressive
+        std::chrono::steady_clock::time_point taken;
+    };
+    CaptureCache capture_cache_;
+    std::chrono::milliseconds capture_cache_ttl_{33};
+#endif
 };
@@ -1,117 +1,160 @@
 #include "ScreenManager.hpp"
+#include "../utils/FrameHash.hpp"
+#include <algorithm>
+#include <cstdlib>
+
+namespace {
+// Method WebP cho CAPTURE_BINARY (0..6): 2 đã nhỏ hơn JPEG cùng quality rõ rệt, còn 4 / 6 chỉ nhỏ thêm chút ít
+// mà chậm hơn nhiều (viewer gửi CAPTURE_BINARY liên tục sẽ thấy). Đo lại bằng screen_codec_bench, xem README
+constexpr int WEBP_SNAPSHOT_METHOD = 2;
+} // namespace
 
 json ScreenManager::handle_command(const json& request) {
     // Chúng ta sẽ xử lý capture binary ở main.cpp để truy cập socket trực tiếp
-    // Hàm này chỉ trả về OK để báo hiệu nếu cần.
+    // Ở đây chỉ còn các lệnh JSON thuần (LIST_MONITORS)
+    if (request.value("command", "") == "LIST_MONITORS") {
+        std::vector<ScreenMonitor> monitors;
+        std::string err;
+        if (!list_monitors(monitors, err)) {
+            return {{"module", "SCREEN"}, {"command", "LIST_MONITORS"}, {"status", "error"}, {"message", err}};
+        }
+        json list = json::array();
+        for (size_t i = 0; i < monitors.size(); i++) {
+            const ScreenMonitor& m = monitors[i];
+            list.push_back({{"index", i}, {"name", m.name}, {"x", m.x}, {"y", m.y},
+                            {"width", m.width}, {"height", m.height}, {"primary", m.primary}});
+        }
+        return {{"module", "SCREEN"}, {"command", "LIST_MONITORS"}, {"status", "success"}, {"data", {{"monitors", list}}}};
+    }
     return { {"status", "ok"} };
 }
 
-bool ScreenManager::capture_screen_data(std::vector<uint8_t>& out_buffer, std::string& error_msg, bool save_to_disk) {
-    error_msg.clear();
+bool ScreenManager::list_monitors(std::vector<ScreenMonitor>& out, std::string& error_msg) {
+    std::lock_guard<std::mutex> lock(capture_mtx_);
+    return capture_ctx_.monitors(out, error_msg);
+}
 
-    // 1. Kết nối với X Server
-    Display* display = XOpenDisplay(NULL);
-    if (!display) {
-        error_msg = "Cannot open X Display";
-        return false;
-    }
+ScreenManager::ScreenManager() {
+    // RC_SCREEN_CAPTURE_CACHE_MS: CAPTURE_BINARY trong khoảng này sau lần chụp trước (cùng vùng)
+    // dùng lại luôn ảnh đã nén, không chụp lại. 0 = tắt.
+    const char* ttl = std::getenv("RC_SCREEN_CAPTURE_CACHE_MS");
+    if (ttl) capture_cache_ttl_ = std::chrono::milliseconds(std::max(0, std::atoi(ttl)));
+}
 
-    Window root = DefaultRootWindow(display);
-    
-    // Lấy thông số màn hình
-    XWindowAttributes attributes;
-    XGetWindowAttributes(display, root, &attributes);
-    int width = attributes.width;
-    int height = attributes.height;
-
-    // 2. Chụp màn hình
-    XImage* img = XGetImage(display, root, 0, 0, width, height, AllPlanes, ZPixmap);
-    if (!img) {
-        error_msg = "XGetImage failed";
-        XCloseDisplay(display);
-        return false;
+bool ScreenManager::capture_screen_data(FrameBuffer& out, std::string& error_msg, bool save_to_disk,
+                                        const ScreenCaptureRegion& region, uint64_t* frame_hash, uint8_t codec,
+                                        std::vector<size_t>* scan_ends) {
+    error_msg.clear();
+    const bool webp = codec == ScreenProtocol::CODEC_WEBP && WebpEncoder::available();
+    if (!webp) codec = ScreenProtocol::CODEC_JPEG;
+    const bool progressive = scan_ends && !webp;
+
+    // Các viewer gọi cùng lúc xếp hàng ở đây; người sau thường gặp ngay ảnh người trước vừa chụp
+    std::lock_guard<std::mutex> lock(capture_mtx_);
+
+    // Vùng cần chụp (toạ độ màn hình ảo), là khoá của cache cùng với codec + quality
+    const bool whole = region.whole_screen();
+    TileRect r{region.x, region.y, region.width, region.height};
+    if (region.monitor >= 0) {
+        std::vector<ScreenMonitor> monitors;
+        if (!capture_ctx_.monitors(monitors, error_msg)) return false;
+        if ((size_t)region.monitor >= monitors.size()) {
+            error_msg = "Unknown monitor " + std::to_string(region.monitor);
+            return false;
+        }
+        const ScreenMonitor& m = monitors[region.monitor];
+        r = TileRect{m.x, m.y, m.width, m.height};
     }
-
-    // 3. Chuẩn bị dữ liệu RGB để nén
-    // X11 thường trả về BGRA, libjpeg cần RGB. Ta phải convert thủ công.
-    std::vector<uint8_t> rgb_data;
-    rgb_data.resize(width * height * 3);
-
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            unsigned long pixel = XGetPixel(img, x, y);
-            
-            // Tách màu dựa trên Mask của XImage (để an toàn với mọi loại màn hình)
-            uint8_t r = (pixel & img->red_mask) >> 16;  // Thường shift 16
-            uint8_t g = (pixel & img->green_mask) >> 8; // Thường shift 8
-            uint8_t b = (pixel & img->blue_mask);       // Thường shift 0
-            
-            // Nếu mask không đúng chuẩn (ví dụ màn hình BGR), code trên cần chỉnh lại shift
-            
-            int index = (y * width + x) * 3;
-            rgb_data[index] = r;
-            rgb_data[index + 1] = g;
-            rgb_data[index + 2] = b;
+    if (whole) r = TileRect{};
+    const int quality = 60;
+    CaptureCache& cache = capture_cache_;
+    const bool same_encoding = cache.jpg && cache.codec == codec && cache.quality == quality
+                            && cache.progressive == progressive;
+    const bool same_params = same_encoding && cache.whole == whole && cache.rect.x == r.x
+                          && cache.rect.y == r.y && cache.rect.w == r.w && cache.rect.h == r.h;
+    const auto now = std::chrono::steady_clock::now();
+
+    if (same_params && now - cache.taken < capture_cache_ttl_) {
+        // Trong cùng 1 khoảng frame: dùng chung buffer đã nén, không chụp / hash / nén lại
+        out = cache.jpg;
+    } else {
+        // 1. + 2. Chụp màn hình qua context dùng lại (không mở/đóng Display mỗi frame).
+        // Chọn 1 màn hình / 1 vùng: chỉ đọc lại đúng vùng đó (ảnh riêng, không ảnh hưởng stream)
+        XImage* img = whole ? capture_ctx_.grab(error_msg) : capture_ctx_.grab_region(r, error_msg);
+        if (!img) return false;
+
+        // Hash ảnh gốc (SIMD, nhanh hơn nén nhiều lần): trùng lần trước -> cùng pixel, cùng codec + quality -> cùng ảnh nén
+        const uint64_t hash = FrameHash::hash((const uint8_t*)img->data, img->width, img->height, img->bytes_per_line,
+                                              img->bits_per_pixel / 8);
+        if (!(same_encoding && hash == cache.hash)) {
+            // 3. + 4. Nén thẳng từ bộ nhớ XImage (BGRX), stride = bytes_per_line, vào buffer mới:
+            // buffer cũ có thể vẫn đang được viewer khác gửi đi, không ghi đè. Cỡ ảnh trước để lấy đúng lớp buffer
+            FrameBuffer jpg = FrameBufferPool::shared().acquire(cache.jpg ? cache.jpg.bytes().size() : 0);
+            const uint8_t* pixels = (const uint8_t*)img->data;
+            const PixelLayout& layout = capture_ctx_.pixel_layout();
+            cache.scan_ends.clear();
+            bool ok;
+            if (webp) {
+                ok = WebpEncoder::encode(pixels, img->width, img->height, img->bytes_per_line, layout, quality,
+                                         WEBP_SNAPSHOT_METHOD, jpg.bytes(), error_msg);
+            } else if (progressive) {
+                ok = jpeg_encoder_.encode_progressive(pixels, img->width, img->height, img->bytes_per_line, layout,
+                                                      quality, jpg.bytes(), cache.scan_ends, error_msg);
+            } else {
+                ok = jpeg_encoder_.encode(pixels, img->width, img->height, img->bytes_per_line, layout, quality,
+                                          jpg.bytes(), error_msg);
+            }
+            if (!ok) {
+                cache.jpg.reset();
+                return false;
+            }
+            cache.jpg = std::move(jpg);
+            cache.hash = hash;
         }
+        cache.whole = whole;
+        cache.rect = r;
+        cache.codec = codec;
+        cache.quality = quality;
+        cache.progressive = progressive;
+        cache.taken = now;
+        out = cache.jpg;
+        // XImage thuộc về capture_ctx_, không XDestroyImage ở đây
     }
+    if (frame_hash) *frame_hash = cache.hash;
+    if (scan_ends) *scan_ends = cache.scan_ends;
 
-    // 4. Nén sang JPEG bằng libjpeg
-    struct jpeg_compress_struct cinfo;
-    struct jpeg_error_mgr jerr;
-
-    cinfo.err = jpeg_std_error(&jerr);
-    jpeg_create_compress(&cinfo);
-
-    // Cấu hình output vào bộ nhớ (Memory Buffer) thay vì File
-    // out_buffer sẽ tự động được resize bởi libjpeg
-    unsigned char* mem_buffer = NULL;
-    unsigned long mem_size = 0;
-    jpeg_mem_dest(&cinfo, &mem_buffer, &mem_size); 
-
-    // Cấu hình thông số ảnh
-    cinfo.image_width = width;
-    cinfo.image_height = height;
-    cinfo.input_components = 3; // RGB
-    cinfo.in_color_space = JCS_RGB;
-
-    jpeg_set_defaults(&cinfo);
-    
-    // Đặt chất lượng nén (Quality = 60)
-    jpeg_set_quality(&cinfo, 60, TRUE);
-
-    // Bắt đầu nén
-    jpeg_start_compress(&cinfo, TRUE);
-
-    int row_stride = width * 3;
-    while (cinfo.next_scanline < cinfo.image_height) {
-        // Ghi từng dòng
-        JSAMPROW row_pointer[1];
-        row_pointer[0] = &rgb_data[cinfo.next_scanline * row_stride];
-        jpeg_write_scanlines(&cinfo, row_pointer, 1);
+    // --- Lưu file ảnh ra ổ đĩa: đẩy sang thread ghi nền (giữ tham chiếu buffer, không copy), không chờ đĩa ---
+    if (save_to_disk && !screenshot_writer_.submit(out, "screen", webp ? ".webp" : ".jpg")) {
+        error_msg = "Screenshot write queue full";
     }
+    return true;
+}
 
-    jpeg_finish_compress(&cinfo);
-    
-    // 5. Copy dữ liệu từ buffer của libjpeg sang vector output
-    out_buffer.assign(mem_buffer, mem_buffer + mem_size);
+void ScreenManager::start_stream(uint64_t session_id, const ScreenStreamOptions& opts, ScreenFrameCallback callback,
+                                 ScreenLinkProbe probe) {
+    streamer_.start(session_id, opts, std::move(callback), std::move(probe));
+}
 
-    // --- Lưu file JPEG ra ổ đĩa ---
-    FILE* fp = fopen("screenshot.jpg", "wb");
-    if (fp) {
-        fwrite(out_buffer.data(), 1, out_buffer.size(), fp);
-        fclose(fp);
-    } else {
-        error_msg = "Cannot write screenshot.jpg";
-        // Bạn có thể return false tùy nhu cầu
-    }
+void ScreenManager::stop_stream(uint64_t session_id) {
+    streamer_.stop(session_id);
+}
+
+bool ScreenManager::stream_stats(uint64_t session_id, ScreenStreamStats& out) {
+    return streamer_.stats(session_id, out);
+}
+
+void ScreenManager::request_keyframe(uint64_t session_id) {
+    streamer_.request_keyframe(session_id);
+}
 
-    // Dọn dẹp libjpeg
-    if (mem_buffer) free(mem_buffer); // jpeg_mem_dest cấp phát bằng malloc
-    jpeg_destroy_compress(&cinfo);
+bool ScreenManager::set_stream_layer(uint64_t session_id, uint8_t layer) {
+    return streamer_.set_layer(session_id, layer);
+}
 
-    // Dọn dẹp X11
-    XDestroyImage(img); // Hàm này tự free memory của img
-    XCloseDisplay(display);
+bool ScreenManager::video_stream_supported() const {
+    return H264Encoder::available();
+}
 
-    return true;
+bool ScreenManager::webp_supported() const {
+    return WebpEncoder::available();
 }
@@ -12,6 +12,12 @@
 #include <iomanip>
 #include <sstream>
 #include <direct.h> // Để tạo thư mục (_mkdir)
+#include <map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
 // Link thư viện GDI+ (Chỉ hoạt động với MSVC, nếu dùng MinGW cần thêm trong CMakeLists.txt)
 #pragma comment (lib,"Gdiplus.lib")
 
@@ -66,19 +72,68 @@ static void SaveDataToDisk(const std::vector<uint8_t>& data, const std::string&
     }
 }
 
+// === DANH SÁCH MÀN HÌNH (toạ độ màn hình ảo, màn hình phụ có thể âm) ===
+static BOOL CALLBACK CollectMonitor(HMONITOR hMonitor, HDC, LPRECT, LPARAM data) {
+    auto* out = reinterpret_cast<std::vector<ScreenMonitor>*>(data);
+    MONITORINFOEXA info;
+    info.cbSize = sizeof(info);
+    if (!GetMonitorInfoA(hMonitor, &info)) return TRUE;
+    ScreenMonitor m;
+    m.name = info.szDevice;
+    m.x = info.rcMonitor.left;
+    m.y = info.rcMonitor.top;
+    m.width = info.rcMonitor.right - info.rcMonitor.left;
+    m.height = info.rcMonitor.bottom - info.rcMonitor.top;
+    m.primary = (info.dwFlags & MONITORINFOF_PRIMARY) != 0;
+    out->push_back(m);
+    return TRUE;
+}
+
+static std::vector<ScreenMonitor> ListMonitors() {
+    std::vector<ScreenMonitor> monitors;
+    EnumDisplayMonitors(NULL, NULL, CollectMonitor, reinterpret_cast<LPARAM>(&monitors));
+    return monitors;
+}
+
 // === CAPTURE SCREEN TO JPEG BUFFER ===
-// === CAPTURE SCREEN ===
-bool ScreenManager::capture_screen_data(std::vector<uint8_t>& out_buffer, std::string& error_msg, bool save_to_disk) {
+// Mặc định chụp màn hình chính (0, 0, SM_CXSCREEN x SM_CYSCREEN); chọn vùng thì chỉ BitBlt đúng vùng đó
+static bool CaptureScreenJpeg(std::vector<uint8_t>& out_buffer, std::string& error_msg, ULONG quality,
+                              int& width, int& height, const ScreenCaptureRegion& region = {}) {
     error_msg.clear();
-    int width = GetSystemMetrics(SM_CXSCREEN);
-    int height = GetSystemMetrics(SM_CYSCREEN);
+    int left = 0, top = 0;
+    width = GetSystemMetrics(SM_CXSCREEN);
+    height = GetSystemMetrics(SM_CYSCREEN);
+    if (region.monitor >= 0) {
+        std::vector<ScreenMonitor> monitors = ListMonitors();
+        if ((size_t)region.monitor >= monitors.size()) {
+            error_msg = "Unknown monitor " + std::to_string(region.monitor);
+            return false;
+        }
+        const ScreenMonitor& m = monitors[region.monitor];
+        left = m.x; top = m.y; width = m.width; height = m.height;
+    } else if (!region.whole_screen()) {
+        // Cắt theo màn hình ảo (gồm mọi màn hình)
+        int vx = GetSystemMetrics(SM_XVIRTUALSCREEN), vy = GetSystemMetrics(SM_YVIRTUALSCREEN);
+        int vw = GetSystemMetrics(SM_CXVIRTUALSCREEN), vh = GetSystemMetrics(SM_CYVIRTUALSCREEN);
+        // Vùng đến từ payload của client: cộng x + width bằng int64_t để không tràn int
+        left = (std::max)(vx, region.x);
+        top = (std::max)(vy, region.y);
+        const int64_t right = (std::min)((int64_t)vx + vw, (int64_t)region.x + region.width);
+        const int64_t bottom = (std::min)((int64_t)vy + vh, (int64_t)region.y + region.height);
+        if (right <= left || bottom <= top) {
+            error_msg = "Capture region is outside the screen";
+            return false;
+        }
+        width = (int)(right - left);
+        height = (int)(bottom - top);
+    }
 
     HDC hScreenDC = GetDC(NULL);
     HDC hMemoryDC = CreateCompatibleDC(hScreenDC);
     HBITMAP hBitmap = CreateCompatibleBitmap(hScreenDC, width, height);
     HGDIOBJ hOldBitmap = SelectObject(hMemoryDC, hBitmap);
 
-    if (!BitBlt(hMemoryDC, 0, 0, width, height, hScreenDC, 0, 0, SRCCOPY)) {
+    if (!BitBlt(hMemoryDC, 0, 0, width, height, hScreenDC, left, top, SRCCOPY)) {
         error_msg = "BitBlt failed";
         return false;
     }
@@ -96,7 +151,6 @@ bool ScreenManager::capture_screen_data(std::vector<uint8_t>& out_buffer, std::s
     encoderParameters.Parameter[0].Guid = EncoderQuality;
     encoderParameters.Parameter[0].Type = EncoderParameterValueTypeLong;
     encoderParameters.Parameter[0].NumberOfValues = 1;
-    ULONG quality = 60; 
     encoderParameters.Parameter[0].Value = &quality;
 
     Status stat = bitmap->Save(stream, &jpgClsid, &encoderParameters);
@@ -110,10 +164,6 @@ bool ScreenManager::capture_screen_data(std::vector<uint8_t>& out_buffer, std::s
         stream->Seek(seekPos, STREAM_SEEK_SET, NULL);
         ULONG bytesRead;
         stream->Read(out_buffer.data(), streamSize, &bytesRead);
-
-        if (save_to_disk) { // Chỉ lưu khi biến này true
-            SaveDataToDisk(out_buffer, "screen");
-        }
     } else {
         error_msg = "GDI+ Save Failed";
     }
@@ -128,6 +178,149 @@ bool ScreenManager::capture_screen_data(std::vector<uint8_t>& out_buffer, std::s
     return (stat == Ok);
 }
 
+// === CAPTURE SCREEN ===
+bool ScreenManager::capture_screen_data(FrameBuffer& out, std::string& error_msg, bool save_to_disk,
+                                        const ScreenCaptureRegion& region, uint64_t* frame_hash, uint8_t codec,
+                                        std::vector<size_t>* scan_ends) {
+    (void)codec;   // Chỉ có GDI+ JPEG baseline
+    if (scan_ends) scan_ends->clear();
+    int width = 0, height = 0;
+    if (frame_hash) *frame_hash = 0;   // GDI+ nén thẳng từ bitmap, chưa hash ảnh gốc
+    static std::atomic<size_t> last_size{0};   // Cỡ ảnh lần trước -> lấy buffer đúng lớp trong pool
+    out = FrameBufferPool::shared().acquire(last_size.load(std::memory_order_relaxed));
+    std::vector<uint8_t>& out_buffer = out.bytes();
+    if (!CaptureScreenJpeg(out_buffer, error_msg, 60, width, height, region)) return false;
+    last_size.store(out_buffer.size(), std::memory_order_relaxed);
+
+    if (save_to_disk) { // Chỉ lưu khi biến này true
+        SaveDataToDisk(out_buffer, "screen");
+    }
+    return true;
+}
+
+// === SCREEN STREAM (mỗi session 1 thread, server tự đẩy frame theo FPS) ===
+struct WinScreenStream {
+    std::atomic<bool> running{true};
+    std::thread worker;
+    std::mutex stats_mtx;
+    ScreenStreamStats stats;
+};
+static std::map<uint64_t, std::unique_ptr<WinScreenStream>> g_streams;
+static std::mutex g_streams_mtx;
+
+void ScreenManager::start_stream(uint64_t session_id, const ScreenStreamOptions& opts, ScreenFrameCallback callback,
+                                 ScreenLinkProbe /*probe*/) {
+    // Chưa có bộ điều khiển tốc độ trên Windows: bỏ qua latency_ms và probe
+    stop_stream(session_id);
+
+    int fps = (std::max)(1, (std::min)(60, opts.fps));
+    ULONG quality = (ULONG)(std::max)(10, (std::min)(95, opts.quality));
+
+    auto stream = std::make_unique<WinScreenStream>();
+    WinScreenStream* raw = stream.get();
+    raw->worker = std::thread([raw, fps, quality, callback]() {
+        std::vector<uint8_t> jpg, packet;
+        std::string err;
+        uint32_t seq = 0;
+        auto period = std::chrono::microseconds(1000000 / fps);
+        auto next = std::chrono::steady_clock::now();
+
+        while (raw->running) {
+            int width = 0, height = 0;
+            if (CaptureScreenJpeg(jpg, err, quality, width, height)) {
+                uint64_t ts = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+                ScreenProtocol::begin_message(packet, ScreenProtocol::MSG_FRAME, seq++, ts);
+                ScreenProtocol::put_u16(packet, (uint16_t)width);
+                ScreenProtocol::put_u16(packet, (uint16_t)height);
+                ScreenProtocol::put_u8(packet, ScreenProtocol::CODEC_JPEG);
+                packet.insert(packet.end(), jpg.begin(), jpg.end());
+                callback(packet);
+
+                // Windows chụp -> nén -> gửi tuần tự trên 1 thread, ts lấy sau khi nén nên tuổi frame chỉ gồm thời gian ghi socket
+                uint64_t sent = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+                double age_ms = (double)(sent - ts) / 1000.0;
+                std::lock_guard<std::mutex> lock(raw->stats_mtx);
+                ScreenStreamStats& st = raw->stats;
+                st.frames_sent++;
+                st.bytes_sent += packet.size();
+                st.last_age_ms = age_ms;
+                st.avg_age_ms = (st.frames_sent == 1) ? age_ms : st.avg_age_ms * 0.9 + age_ms * 0.1;
+                st.max_age_ms = (std::max)(st.max_age_ms, age_ms);
+            }
+            next += period;
+            auto now = std::chrono::steady_clock::now();
+            if (next < now) next = now; // Trễ thì bỏ nhịp, không dồn frame
+            std::this_thread::sleep_until(next);
+        }
+    });
+
+    std::lock_guard<std::mutex> lock(g_streams_mtx);
+    g_streams[session_id] = std::move(stream);
+}
+
+void ScreenManager::stop_stream(uint64_t session_id) {
+    std::unique_ptr<WinScreenStream> stream;
+    {
+        std::lock_guard<std::mutex> lock(g_streams_mtx);
+        auto it = g_streams.find(session_id);
+        if (it == g_streams.end()) return;
+        stream = std::move(it->second);
+        g_streams.erase(it);
+    }
+    stream->running = false;
+    if (stream->worker.joinable()) stream->worker.join();
+}
+
+bool ScreenManager::stream_stats(uint64_t session_id, ScreenStreamStats& out) {
+    std::lock_guard<std::mutex> lock(g_streams_mtx);
+    auto it = g_streams.find(session_id);
+    if (it == g_streams.end()) return false;
+    std::lock_guard<std::mutex> stats_lock(it->second->stats_mtx);
+    out = it->second->stats;
+    return true;
+}
+
+bool ScreenManager::list_monitors(std::vector<ScreenMonitor>& out, std::string& error_msg) {
+    error_msg.clear();
+    out = ListMonitors();
+    if (out.empty()) {
+        error_msg = "EnumDisplayMonitors failed";
+        return false;
+    }
+    return true;
+}
+
+// Mỗi frame đã là 1 JPEG đầy đủ, không có gì để làm mới
+void ScreenManager::request_keyframe(uint64_t /*session_id*/) {}
+
+bool ScreenManager::set_stream_layer(uint64_t /*session_id*/, uint8_t /*layer*/) {
+    return false;   // Mỗi session 1 thread chụp riêng, không có lớp simulcast
+}
+
+bool ScreenManager::video_stream_supported() const {
+    return false;
+}
+
+bool ScreenManager::webp_supported() const {
+    return false;
+}
+
 json ScreenManager::handle_command(const json& request) {
+    if (request.value("command", "") == "LIST_MONITORS") {
+        std::vector<ScreenMonitor> monitors;
+        std::string err;
+        if (!list_monitors(monitors, err)) {
+            return {{"module", "SCREEN"}, {"command", "LIST_MONITORS"}, {"status", "error"}, {"message", err}};
+        }
+        json list = json::array();
+        for (size_t i = 0; i < monitors.size(); i++) {
+            const ScreenMonitor& m = monitors[i];
+            list.push_back({{"index", i}, {"name", m.name}, {"x", m.x}, {"y", m.y},
+                            {"width", m.width}, {"height", m.height}, {"primary", m.primary}});
+        }
+        return {{"module", "SCREEN"}, {"command", "LIST_MONITORS"}, {"status", "success"}, {"data", {{"monitors", list}}}};
+    }
     return { {"status", "ok"} };
 }
\ No newline at end of file
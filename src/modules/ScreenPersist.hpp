@@ -0,0 +1,51 @@
+#pragma once
+// Ghi ảnh chụp màn hình ra đĩa ở thread nền (chỉ dùng trên Linux).
+// CAPTURE_BINARY (save = true) chỉ copy JPEG vào hàng đợi rồi trả về ngay,
+// đĩa chậm không còn chặn thread WebSocket của session.
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "../utils/FrameBufferPool.hpp"
+
+class ScreenshotWriter {
+public:
+    // max_queue: số ảnh tối đa đang chờ ghi, đầy thì bỏ ảnh mới (không chặn capture)
+    explicit ScreenshotWriter(size_t max_queue = 8);
+    ~ScreenshotWriter();   // Ghi nốt hàng đợi rồi mới thoát
+
+    ScreenshotWriter(const ScreenshotWriter&) = delete;
+    ScreenshotWriter& operator=(const ScreenshotWriter&) = delete;
+
+    // Tên file: captured_data/<prefix>_YYYYmmdd_HHMMSS<ext> (giống SaveDataToDisk bên Windows),
+    // thời điểm lấy lúc submit. false nếu hàng đợi đầy.
+    bool submit(const uint8_t* data, size_t size, const std::string& prefix, const char* ext = ".jpg");
+    // Như trên nhưng giữ tham chiếu buffer (không copy), buffer không được sửa sau khi submit
+    bool submit(const FrameBuffer& jpg, const std::string& prefix, const char* ext = ".jpg");
+
+private:
+    struct Job {
+        FrameBuffer jpg;
+        std::string prefix;
+        const char* ext = ".jpg";
+        std::time_t taken = 0;
+    };
+
+    void run();
+    std::string make_path(const Job& job);
+
+    size_t max_queue_;
+    std::deque<Job> queue_;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    bool stopping_ = false;
+    std::thread thread_;
+
+    // Chỉ thread ghi dùng: tránh ghi đè khi nhiều ảnh cùng 1 giây
+    std::string last_stem_;
+    int same_stem_count_ = 0;
+};
@@ -0,0 +1,123 @@
+#include "ScreenPersist.hpp"
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+static const char* kCaptureDir = "captured_data";
+
+ScreenshotWriter::ScreenshotWriter(size_t max_queue) : max_queue_(max_queue) {
+    thread_ = std::thread(&ScreenshotWriter::run, this);
+}
+
+ScreenshotWriter::~ScreenshotWriter() {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) thread_.join();
+}
+
+bool ScreenshotWriter::submit(const uint8_t* data, size_t size, const std::string& prefix, const char* ext) {
+    FrameBuffer jpg = FrameBufferPool::shared().acquire(size);
+    jpg.bytes().assign(data, data + size);
+    return submit(jpg, prefix, ext);
+}
+
+bool ScreenshotWriter::submit(const FrameBuffer& jpg, const std::string& prefix, const char* ext) {
+    Job job;
+    job.taken = std::time(nullptr);
+    job.prefix = prefix;
+    job.ext = ext;
+    job.jpg = jpg;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (queue_.size() >= max_queue_) {
+            std::cerr << "[STORAGE] Write queue full, dropping " << prefix << " capture\n";
+            return false;
+        }
+        queue_.push_back(std::move(job));
+    }
+    cv_.notify_one();
+    return true;
+}
+
+std::string ScreenshotWriter::make_path(const Job& job) {
+    std::tm tm{};
+    localtime_r(&job.taken, &tm);
+    std::ostringstream oss;
+    oss << kCaptureDir << "/" << job.prefix << "_" << std::put_time(&tm, "%Y%m%d_%H%M%S");
+    std::string stem = oss.str();
+
+    // Nhiều ảnh trong cùng 1 giây -> thêm hậu tố _1, _2... thay vì ghi đè
+    if (stem == last_stem_) {
+        same_stem_count_++;
+        return stem + "_" + std::to_string(same_stem_count_) + job.ext;
+    }
+    last_stem_ = stem;
+    same_stem_count_ = 0;
+    return stem + job.ext;
+}
+
+void ScreenshotWriter::run() {
+    std::vector<Job> batch;
+    std::vector<int> fds;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            cv_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+            if (queue_.empty()) return;   // stopping_ và đã ghi hết
+            // Lấy cả lô đang chờ: 1 lần fsync thư mục cho cả lô
+            while (!queue_.empty()) {
+                batch.push_back(std::move(queue_.front()));
+                queue_.pop_front();
+            }
+        }
+
+        mkdir(kCaptureDir, 0755);
+        for (Job& job : batch) {
+            std::string path = make_path(job);
+            int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (fd < 0) {
+                std::cerr << "[STORAGE] Cannot open " << path << ": " << std::strerror(errno) << "\n";
+                continue;
+            }
+            const std::vector<uint8_t>& bytes = job.jpg.bytes();
+            size_t written = 0;
+            while (written < bytes.size()) {
+                ssize_t n = write(fd, bytes.data() + written, bytes.size() - written);
+                if (n < 0 && errno == EINTR) continue;
+                if (n <= 0) break;
+                written += (size_t)n;
+            }
+            if (written != bytes.size()) {
+                std::cerr << "[STORAGE] Short write " << path << ": " << std::strerror(errno) << "\n";
+                close(fd);
+                continue;
+            }
+            fds.push_back(fd);
+            std::cout << "[STORAGE] Saved: " << path << std::endl;
+        }
+
+        // Ghi hết cả lô rồi mới đồng bộ: các fdatasync liên tiếp + 1 fsync thư mục cho entry mới
+        for (int fd : fds) {
+            fdatasync(fd);
+            close(fd);
+        }
+        if (!fds.empty()) {
+            int dir_fd = open(kCaptureDir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (dir_fd >= 0) {
+                fsync(dir_fd);
+                close(dir_fd);
+            }
+        }
+        fds.clear();
+        batch.clear();
+    }
+}
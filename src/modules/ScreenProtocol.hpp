@@ -0,0 +1,184 @@
+#pragma once
+// Định dạng binary frame của SCREEN stream (dùng chung Windows / Linux).
+//
+// Mọi message binary của SCREEN stream bắt đầu bằng header 16 byte (little-endian):
+//   [0..1]  magic 'S','C'   (JPEG thô bắt đầu bằng FF D8 nên client phân biệt được)
+//   [2]     type            (MsgType)
+//   [3]     flags
+//   [4..7]  seq             (u32, tăng dần theo session)
+//   [8..15] timestamp_us    (u64, thời điểm chụp, steady clock)
+// Sau header là payload tuỳ theo type.
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace ScreenProtocol {
+
+constexpr uint8_t MAGIC_0 = 'S';
+constexpr uint8_t MAGIC_1 = 'C';
+constexpr size_t HEADER_SIZE = 16;
+
+enum MsgType : uint8_t {
+    // Payload: u16 width, u16 height, u8 codec, rồi dữ liệu ảnh đã nén
+    MSG_FRAME = 1,
+    // Cập nhật từng phần: u16 screen_w, u16 screen_h, u16 count, rồi count vùng:
+    //   u16 x, u16 y, u16 w, u16 h, u8 codec, u32 len, len byte dữ liệu
+    // Client vẽ đè từng vùng lên ảnh đang có. Đổi độ phân giải -> gửi đủ mọi vùng.
+    MSG_TILES = 2,
+    // Hình con trỏ chuột, chỉ gửi khi hình đổi: u16 w, u16 h, u16 xhot, u16 yhot, rồi w*h*4 byte RGBA
+    // (alpha thường, không premultiply)
+    MSG_CURSOR_SHAPE = 3,
+    // Vị trí con trỏ: u16 x, u16 y, u16 screen_w, u16 screen_h (pixel màn hình gốc, không theo hệ số thu nhỏ).
+    // MSG_CURSOR_POS có dãy seq riêng; MSG_CURSOR_SHAPE dùng chung buffer cho mọi session nên seq = 0.
+    // Client vẽ con trỏ đè lên ảnh.
+    MSG_CURSOR_POS = 4,
+    // Chế độ video: u16 width, u16 height, u8 codec (CODEC_H264), rồi 1 access unit Annex-B.
+    // flags có FLAG_KEYFRAME ở frame IDR (kèm SPS/PPS). Màn hình đứng yên thì không gửi frame nào.
+    MSG_VIDEO = 5,
+    // 1 scan của ảnh CAPTURE_BINARY progressive (payload.progressive): u8 index, u8 count, rồi đoạn byte của scan đó.
+    // Scan 0 mở đầu bằng SOI + bảng, scan cuối kết thúc bằng EOI; seq = số thứ tự lần chụp của kết nối.
+    // Client nối các đoạn đã nhận (+ FF D9 nếu chưa đủ) thành JPEG và vẽ lại sau mỗi scan, thô -> nét dần.
+    MSG_JPEG_SCAN = 6,
+};
+
+enum Codec : uint8_t {
+    CODEC_JPEG = 0,
+    CODEC_H264 = 1,
+    // Lossless, định dạng QOI chuẩn 3 kênh (header "qoif" ... end marker), xem utils/QoiCodec.hpp
+    CODEC_QOI = 2,
+    // Cả vùng 1 màu: 3 byte R, G, B (client tô kín vùng)
+    CODEC_SOLID = 3,
+    // Copy rect (cuộn): u16 src_x, u16 src_y. Client chép vùng w x h từ (src_x, src_y) của ảnh đang có
+    // tới (x, y). Luôn đứng trước các vùng ảnh trong cùng message và phải áp dụng theo đúng thứ tự.
+    CODEC_COPY = 4,
+    // Ảnh WebP lossy (RIFF "WEBP"), trình duyệt giải mã như ảnh thường. Chỉ khi server build với libwebp
+    CODEC_WEBP = 5,
+};
+
+// Bit trong byte flags của header
+constexpr uint8_t FLAG_KEYFRAME = 0x01;
+
+// Lớp simulcast (payload.layer của START_STREAM / SET_LAYER): mọi session cùng lớp dùng chung 1 bộ
+// tham số cố định (hệ số thu nhỏ, FPS, quality) và gửi cùng nhịp, nên mỗi vùng chỉ nén 1 lần cho cả lớp
+enum Layer : uint8_t {
+    LAYER_NONE = 0,         // Tham số riêng của session (fps, quality, view_width...)
+    LAYER_THUMBNAIL = 1,
+    LAYER_MEDIUM = 2,
+    LAYER_FULL = 3,
+};
+
+inline void put_u8(std::vector<uint8_t>& out, uint8_t v) { out.push_back(v); }
+
+inline void put_u16(std::vector<uint8_t>& out, uint16_t v) {
+    out.push_back((uint8_t)(v & 0xff));
+    out.push_back((uint8_t)(v >> 8));
+}
+
+inline void put_u32(std::vector<uint8_t>& out, uint32_t v) {
+    for (int i = 0; i < 4; i++) out.push_back((uint8_t)(v >> (8 * i)));
+}
+
+inline void put_u64(std::vector<uint8_t>& out, uint64_t v) {
+    for (int i = 0; i < 8; i++) out.push_back((uint8_t)(v >> (8 * i)));
+}
+
+// Xoá out rồi ghi header (giữ capacity để dùng lại giữa các frame)
+inline void begin_message(std::vector<uint8_t>& out, MsgType type, uint32_t seq, uint64_t timestamp_us,
+                          uint8_t flags = 0) {
+    out.clear();
+    put_u8(out, MAGIC_0);
+    put_u8(out, MAGIC_1);
+    put_u8(out, type);
+    put_u8(out, flags);
+    put_u32(out, seq);
+    put_u64(out, timestamp_us);
+}
+
+} // namespace ScreenProtocol
+
+// 1 màn hình vật lý trong màn hình ảo (lệnh LIST_MONITORS), toạ độ theo pixel của màn hình ảo
+struct ScreenMonitor {
+    std::string name;
+    int x = 0, y = 0, width = 0, height = 0;
+    bool primary = false;
+};
+
+// Vùng chụp của CAPTURE_BINARY: monitor >= 0 -> cả màn hình đó (index trong LIST_MONITORS),
+// width/height > 0 -> hình chữ nhật tuỳ ý, còn lại -> cả màn hình như trước
+struct ScreenCaptureRegion {
+    int monitor = -1;
+    int x = 0, y = 0, width = 0, height = 0;
+
+    bool whole_screen() const { return monitor < 0 && (width <= 0 || height <= 0); }
+};
+
+// Tham số stream của từng session (client gửi trong payload của START_STREAM)
+struct ScreenStreamOptions {
+    int fps = 15;
+    int quality = 60;
+    // Kích thước vùng hiển thị của client (pixel thiết bị), 0 = không giới hạn chiều đó.
+    // Server thu nhỏ 2x / 4x khi màn hình lớn hơn hẳn vùng hiển thị (chỉ Linux).
+    int view_width = 0;
+    int view_height = 0;
+    // Chế độ video (payload.mode = "video"): H.264 cả khung hình thay vì tile JPEG (Linux + libx264).
+    // bitrate_kbps > 0: giới hạn bitrate, 0: chất lượng cố định theo quality
+    bool video = false;
+    int bitrate_kbps = 0;
+    // Codec của tile (payload.codec = "jpeg" | "lossless" | "webp"): CODEC_JPEG, CODEC_QOI hoặc CODEC_WEBP
+    // (chỉ Linux, chế độ tile; WebP cần libwebp, không có thì dùng JPEG)
+    uint8_t codec = ScreenProtocol::CODEC_JPEG;
+    // Mức nén WebP (payload.webp_method): -1 = preset nhanh cho stream, 0..6 = method của libwebp (chậm dần, nhỏ dần)
+    int webp_method = -1;
+    // payload.codec = "auto": chọn codec theo nội dung từng tile (màu đặc / QOI / JPEG quality riêng), bỏ qua codec
+    bool adaptive = false;
+    // Làm nét dần (chế độ tile): màn hình đứng yên refine_ms (> 0) thì gửi lại các vùng đã gửi JPEG ở
+    // refine_quality (0 = lossless QOI). Trong lúc đổi liên tục vẫn gửi theo quality (thấp) cho nhanh.
+    int refine_ms = 0;
+    int refine_quality = 0;
+    // Độ trễ mục tiêu (ms, > 0 bật bộ điều khiển tốc độ, chỉ Linux): mạng nghẽn thì server tự hạ quality,
+    // FPS rồi thu nhỏ ảnh, mạng thông thì tăng dần lại tới fps / quality ở trên
+    int latency_ms = 0;
+    // Lớp simulcast (chỉ Linux): khác LAYER_NONE thì bỏ qua fps, quality, view_*, codec, refine_*, latency_ms
+    uint8_t layer = ScreenProtocol::LAYER_NONE;
+};
+
+// Số liệu stream của 1 session (lệnh STREAM_STATS).
+// Tuổi frame = lúc gửi xong - lúc chụp, đo trên server (cùng steady clock với timestamp_us).
+struct ScreenStreamStats {
+    uint64_t frames_sent = 0;
+    uint64_t bytes_sent = 0;
+    uint64_t frames_skipped = 0;   // Đến hạn nhưng sender còn bận -> gộp vào frame sau
+    uint64_t frames_merged = 0;    // Lần chụp bị gộp vì stage nén còn bận (chung cho mọi session)
+    double last_age_ms = 0;
+    double avg_age_ms = 0;         // Trung bình trượt (EWMA)
+    double max_age_ms = 0;
+    double avg_encode_ms = 0;      // Thời gian nén 1 lần gửi (mọi vùng, trên cả pool)
+    int scale = 1;                 // Hệ số thu nhỏ đang dùng (1, 2, 4)
+    uint64_t cursor_sent = 0;      // Message con trỏ (hình + vị trí) đã gửi
+    uint64_t copy_rects = 0;       // Lệnh copy rect (cuộn) đã gửi thay cho nén lại vùng
+    uint64_t refine_passes = 0;    // Lượt làm nét đã gửi
+    int layer = 0;                 // Lớp simulcast đang dùng (ScreenProtocol::Layer)
+    uint64_t regions_shared = 0;   // Vùng đã gửi mà bản nén dùng chung với session khác (không nén lại)
+    // Đo kết nối (sender) và quyết định của bộ điều khiển tốc độ (latency_ms > 0)
+    double avg_write_ms = 0;       // Thời gian ghi 1 frame vào socket (chặn khi buffer socket đầy), EWMA
+    double send_kbps = 0;          // Tốc độ gửi thực tế, EWMA theo cửa sổ ~1 s
+    int64_t unsent_bytes = -1;     // Byte còn trong buffer gửi của socket (-1 = không đo được)
+    double rtt_ms = -1;            // RTT ping/pong WebSocket gần nhất (-1 = chưa có)
+    double delay_ms = 0;           // Độ trễ ước lượng mà bộ điều khiển dùng
+    double rate_budget = 1;        // 1 = tham số gốc, nhỏ dần khi nghẽn
+    int rate_fps = 0;              // FPS / quality đang dùng sau điều khiển
+    int rate_quality = 0;
+    uint64_t rate_changes = 0;     // Số lần bộ điều khiển đổi FPS / quality / hệ số thu nhỏ
+};
+
+// Trạng thái kết nối của 1 session do WebSocketServer đo, sender của stream hỏi sau mỗi lần ghi
+struct ScreenLinkState {
+    int64_t unsent_bytes = -1;     // SIOCOUTQ, -1 = không đo được
+    double rtt_ms = -1;            // Theo pong của lần ping gần nhất, -1 = chưa có
+};
+// Đọc trạng thái kết nối, đồng thời gửi ping mới nếu đã tới lúc (gọi từ thread gửi của stream)
+using ScreenLinkProbe = std::function<void(ScreenLinkState&)>;
+
+// Callback gửi 1 message binary đã đóng gói về đúng session
+using ScreenFrameCallback = std::function<void(const std::vector<uint8_t>&)>;
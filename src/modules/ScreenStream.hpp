@@ -0,0 +1,263 @@
+#pragma once
+// Luồng stream màn hình do server chủ động đẩy (chỉ dùng trên Linux).
+// Pipeline 3 stage, nối với nhau bằng SpscRing có giới hạn:
+//   capture thread --(FrameChange)--> encode thread (+ JpegEncoderPool) --(OutPacket)--> sender của từng session
+// Stage sau còn bận thì stage trước gộp thay đổi vào lần sau chứ không xếp hàng frame cũ,
+// nên mạng chậm ở 1 session không làm chậm việc chụp hay các session khác.
+// Con trỏ chuột đi kênh riêng (XFixes): capture thread chỉ ghi trạng thái mới nhất, sender tự gửi
+// hình (khi đổi) + vị trí, chuột di chuyển không phải nén lại ảnh.
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "ScreenCapture.hpp"
+#include "ScreenEncoder.hpp"
+#include "ScreenProtocol.hpp"
+#include "../utils/FrameBufferPool.hpp"
+#include "../utils/RateController.hpp"
+#include "../utils/ScrollDetector.hpp"
+#include "../utils/SpscRing.hpp"
+#include "../utils/TileClassifier.hpp"
+#include "../utils/TileDiffer.hpp"
+
+class ScreenStreamer {
+public:
+    ScreenStreamer(X11CaptureContext& ctx, std::mutex& capture_mtx);
+    ~ScreenStreamer();
+
+    // Bắt đầu (hoặc cập nhật tham số) stream cho 1 session
+    // probe (có thể rỗng): đo kết nối cho bộ điều khiển tốc độ (opts.latency_ms > 0)
+    void start(uint64_t session_id, const ScreenStreamOptions& opts, ScreenFrameCallback callback,
+               ScreenLinkProbe probe = nullptr);
+    void stop(uint64_t session_id);
+
+    // false nếu session không stream
+    bool stats(uint64_t session_id, ScreenStreamStats& out);
+
+    // Gửi lại toàn bộ màn hình ở lần gửi tới (chế độ video: frame IDR), VD khi client mất frame
+    void request_keyframe(uint64_t session_id);
+
+    // Chuyển session sang lớp simulcast khác (LAYER_NONE = quay về tham số của START_STREAM),
+    // không dừng chụp / sender. false nếu session không stream
+    bool set_layer(uint64_t session_id, uint8_t layer);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // Thay đổi của 1 lần chụp (capture -> encode). Pixel của các tile thay đổi được copy ra
+    // vì ảnh của capture context bị ghi đè ở lần chụp sau.
+    struct FrameChange {
+        uint64_t timestamp_us = 0;
+        int width = 0, height = 0, bpp = 0;
+        PixelLayout layout;
+        bool reset = false;             // Frame đầu / đổi độ phân giải: có đủ mọi tile
+        std::vector<uint8_t> changed;   // 1 byte/tile
+        bool has_copy = false;          // Cuộn so với frame trước (chỉ khi không gộp nhiều lần chụp)
+        ScrollCopy copy;
+        std::vector<uint8_t> pixels;    // Các tile thay đổi theo thứ tự tile, mỗi tile các hàng liền nhau
+    };
+
+    // Message đã đóng gói (encode -> sender), buffer thuộc FrameBufferPool
+    struct OutPacket {
+        uint64_t timestamp_us = 0;
+        FrameBuffer data;
+    };
+
+    struct Session {
+        uint64_t id = 0;
+        ScreenFrameCallback callback;
+        ScreenLinkProbe probe;
+
+        // Streamer mtx_
+        ScreenStreamOptions custom;     // Tham số START_STREAM gốc (dùng lại khi quay về LAYER_NONE)
+        ScreenStreamOptions requested;
+        bool resync = true;             // START_STREAM (lại) -> gửi toàn màn hình
+        bool refresh = false;           // REQUEST_KEYFRAME
+
+        // Chỉ encode thread dùng
+        ScreenStreamOptions opts;
+        int scale = 1;                  // Hệ số thu nhỏ theo vùng hiển thị của client
+        RateController rate;            // latency_ms > 0: hạ / tăng fps, quality, scale theo độ trễ đo được
+        int fps = 15, quality = 60;     // Đang dùng (= opts khi tắt bộ điều khiển tốc độ)
+        int rate_scale = 1;
+        std::atomic<bool> rate_enabled{false};   // Sender đọc: có hỏi probe định kỳ khi rảnh không
+        Clock::time_point next_due;
+        uint32_t seq = 0;
+        std::vector<uint8_t> dirty;     // Tile thay đổi từ lần gửi trước (gộp qua các lần chụp)
+        bool full = true;
+        std::vector<size_t> jobs;       // Index trong jobs_ của lần nén hiện tại
+        std::vector<size_t> probes;     // Codec theo tile: index trong probes_, theo thứ tự tile
+        std::vector<ScrollCopy> copies; // Copy rect chưa gửi (toạ độ canvas đã thu nhỏ), theo thứ tự
+        bool tiles_due = false;         // Chế độ tile: đến hạn gửi ở lần này (kể cả khi chỉ có copy rect)
+        bool refining = false;          // Lần gửi này là lượt làm nét (refine_ms)
+        std::vector<uint8_t> unrefined; // Tile đã gửi lossy, chưa gửi lại bản nét
+        Clock::time_point last_change;  // Lần cuối màn hình đổi (dirty / copy rect)
+        bool video_due = false;         // Chế độ video: đến hạn nén 1 frame ở lần này
+        std::unique_ptr<H264Encoder> video;
+        std::vector<uint8_t> video_out;
+        OutPacket staging;
+
+        // Encode -> sender
+        SpscRing<OutPacket> outbox{1};
+        std::mutex send_mtx;
+        std::condition_variable send_cv;
+        bool closed = false;
+        std::thread sender;
+
+        // Chỉ sender dùng: trạng thái con trỏ đã gửi
+        uint64_t cursor_version = 0;
+        uint64_t cursor_shape_id = 0;
+        uint32_t cursor_seq = 0;
+        std::vector<uint8_t> cursor_packet;
+
+        // Chỉ sender dùng: cửa sổ đo tốc độ gửi
+        Clock::time_point rate_window_start;
+        uint64_t rate_window_bytes = 0;
+
+        std::mutex stats_mtx;
+        ScreenStreamStats stats;
+    };
+
+    // 1 vùng cần nén ở 1 codec / quality / hệ số thu nhỏ, dùng chung cho mọi session giống nhau
+    struct EncodeJob {
+        TileRect rect;                  // Toạ độ trên canvas đã thu nhỏ
+        int scale = 1;
+        uint8_t codec = ScreenProtocol::CODEC_JPEG;
+        int quality = 0;                // 0 với CODEC_QOI (lossless, không có quality)
+        int effort = 0;                 // Method của CODEC_WEBP (WebpEncoder), 0 với codec khác
+        int users = 0;                  // Số session gửi vùng này ở lần nén hiện tại
+        bool ok = false;
+        std::vector<uint8_t> jpg;
+    };
+
+    // Tham số cố định của 1 lớp simulcast, index = ScreenProtocol::Layer
+    struct LayerPreset {
+        const char* name;
+        int scale, fps, quality;
+    };
+    static constexpr LayerPreset LAYERS[] = {
+        {"custom", 1, 0, 0},
+        {"thumbnail", 4, 2, 40},
+        {"medium", 2, 10, 55},
+        {"full", 1, 15, 70},
+    };
+    static ScreenStreamOptions layered(const ScreenStreamOptions& custom, uint8_t layer);
+
+    // 1 tile cần phân loại (codec theo tile), dùng chung cho mọi session cùng hệ số thu nhỏ
+    struct TileProbe {
+        TileRect rect;                  // Toạ độ trên canvas đã thu nhỏ
+        int scale = 1;
+        TileClassifier::Result result;
+    };
+    // Tile nhiều chi tiết (chữ trên nền ảnh...) nén JPEG với quality cao hơn quality của session
+    static constexpr int DETAILED_QUALITY_BOOST = 20;
+    // Quá bấy nhiêu copy rect chưa gửi thì session quay về gửi lại tile như thường
+    static constexpr size_t MAX_PENDING_COPIES = 4;
+    // Sender có probe thì thức dậy theo nhịp này, bộ điều khiển tốc độ bật thì hỏi probe (ping, SIOCOUTQ)
+    // cả khi không có frame để độ trễ không cũ
+    static constexpr std::chrono::milliseconds LINK_PROBE_INTERVAL{500};
+
+    void ensure_threads();
+
+    // Stage 1: chụp theo FPS lớn nhất, so tile, đẩy thay đổi sang stage nén
+    void capture_loop();
+    void capture_once();
+
+    // Stage 2: ghép thay đổi vào canvas, nén vùng bẩn cho session đến hạn
+    void encode_loop();
+    void apply_frame(const FrameChange& f, const std::vector<std::shared_ptr<Session>>& sessions);
+    bool apply_copy(Session& s, const FrameChange& f);
+    void tile_rects(const std::vector<uint8_t>& tiles, int scale, int cols, int rows);
+    static void mark_tiles(std::vector<uint8_t>& tiles, const TileRect& r, int scale, int cols, int rows);
+    bool refine_due(const Session& s, Clock::time_point now) const;
+    void encode_due(const std::vector<std::shared_ptr<Session>>& sessions, Clock::time_point now);
+    void encode_video(Session& s);
+    const uint8_t* canvas_at(int scale, const TileRect& r, size_t& stride) const;
+    size_t add_job(const TileRect& r, int scale, uint8_t codec, int quality, int effort = 0);
+    void add_probes(Session& s, int cols, int rows);
+    void add_adaptive_jobs(Session& s);
+    int pick_scale(const ScreenStreamOptions& opts) const;
+    void update_rate(Session& s, Clock::time_point now);
+    void update_scaled(const std::vector<std::shared_ptr<Session>>& sessions);
+
+    // Con trỏ chuột: hỏi vị trí mỗi lần chụp, ảnh con trỏ chỉ lấy khi hình đổi
+    void poll_cursor();
+    void notify_senders();
+
+    // Stage 3: mỗi session 1 thread ghi socket
+    void send_loop(Session* s);
+    bool send_cursor(Session& s);
+    void update_link(Session& s, size_t bytes, double write_ms, double age_ms);
+    static void close_session(Session& s);
+
+    X11CaptureContext& ctx_;
+    std::mutex& capture_mtx_;
+
+    std::map<uint64_t, std::shared_ptr<Session>> sessions_;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    bool running_ = false;
+    std::thread capture_thread_;
+    std::thread encode_thread_;
+
+    // Capture stage
+    TileDiffer differ_;
+    ScrollDetector scroll_;
+    bool scroll_enabled_ = true;
+    std::vector<TileRect> damaged_;     // Vùng XDamage của lần chụp hiện tại
+    std::vector<uint8_t> pending_;      // Tile thay đổi chưa đẩy sang stage nén
+    bool pending_reset_ = false;
+    FrameChange capture_staging_;
+    bool last_capture_failed_ = false;
+    std::atomic<uint64_t> frames_merged_{0};
+
+    // Con trỏ (capture -> sender): chỉ giữ bản mới nhất, sender so version để biết cần gửi
+    bool cursor_enabled_ = true;
+    bool cursor_failed_ = false;
+    X11CaptureContext::PointerShape cursor_staging_;   // Chỉ capture thread dùng
+    int cursor_last_x_ = -1, cursor_last_y_ = -1;
+    std::mutex cursor_mtx_;
+    std::atomic<uint64_t> cursor_version_{0};
+    FrameBuffer cursor_shape_;          // MSG_CURSOR_SHAPE đã đóng gói, dùng chung cho mọi session
+    uint64_t cursor_shape_id_ = 0;
+    int cursor_x_ = 0, cursor_y_ = 0, cursor_screen_w_ = 0, cursor_screen_h_ = 0;
+    uint64_t cursor_ts_ = 0;
+
+    // Capture -> encode
+    SpscRing<FrameChange> frames_{2};
+    std::mutex encode_mtx_;
+    std::condition_variable encode_cv_;
+    bool encode_wake_ = false;
+
+    // Encode stage
+    FrameChange encode_staging_;
+    std::vector<uint8_t> dirty_scratch_;
+    std::vector<uint8_t> unrefined_scratch_;
+    std::vector<uint8_t> canvas_;       // Màn hình hiện tại theo các thay đổi đã nhận (stride = width * bpp)
+    int canvas_w_ = 0, canvas_h_ = 0, canvas_bpp_ = 0;
+    PixelLayout canvas_layout_;
+    uint64_t canvas_ts_ = 0;
+    // Bản thu nhỏ 2x, 4x của canvas_ (box filter), chỉ cập nhật khi có session dùng hệ số đó
+    struct ScaledCanvas {
+        int scale = 1;
+        int w = 0, h = 0;
+        bool valid = false;
+        std::vector<uint8_t> pixels;    // stride = w * 4
+    };
+    ScaledCanvas scaled_[2];
+    JpegEncoderPool pool_;
+    bool stripes_ = true;               // Cắt vùng lớn thành dải ngang để nén song song
+    std::vector<TileRect> rects_;
+    std::vector<EncodeJob> jobs_;
+    size_t job_count_ = 0;
+    std::vector<TileProbe> probes_;
+    size_t probe_count_ = 0;
+    std::vector<int> probe_index_[3];   // Theo hệ số 1, 2, 4: tile -> index trong probes_ (-1 = chưa có)
+    uint64_t probe_frame_[3] = {0, 0, 0};
+    uint64_t probe_generation_ = 0;     // Tăng mỗi lần encode_due, probe_index_ cũ thì xoá trước khi dùng
+};
@@ -0,0 +1,1151 @@
+#include "ScreenStream.hpp"
+#include "../utils/PixelConvert.hpp"
+#include "../utils/QoiCodec.hpp"
+#include "../utils/TileClassifier.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+static int clamp_int(int v, int lo, int hi) { return std::max(lo, std::min(hi, v)); }
+
+static uint64_t steady_now_us() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool any_set(const std::vector<uint8_t>& bits) {
+    return std::find(bits.begin(), bits.end(), 1) != bits.end();
+}
+
+// Mốc kế tiếp (sau now) trên lưới chu kỳ period tính từ gốc steady clock, chung cho mọi session cùng chu kỳ
+static std::chrono::steady_clock::time_point layer_tick(std::chrono::steady_clock::time_point now,
+                                                        std::chrono::microseconds period) {
+    const auto since = std::chrono::duration_cast<std::chrono::microseconds>(now.time_since_epoch());
+    return std::chrono::steady_clock::time_point(
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>((since / period + 1) * period));
+}
+
+ScreenStreamer::ScreenStreamer(X11CaptureContext& ctx, std::mutex& capture_mtx)
+    : ctx_(ctx), capture_mtx_(capture_mtx) {
+    // RC_SCREEN_STRIPES=0 để tắt chia dải (đo hiệu quả khi so với 1 encoder)
+    const char* stripes = std::getenv("RC_SCREEN_STRIPES");
+    stripes_ = !(stripes && stripes[0] == '0');
+    scaled_[0].scale = 2;
+    scaled_[1].scale = 4;
+    // RC_SCREEN_NO_CURSOR=1 để tắt kênh con trỏ
+    const char* no_cursor = std::getenv("RC_SCREEN_NO_CURSOR");
+    cursor_enabled_ = !(no_cursor && no_cursor[0] == '1');
+    // RC_SCREEN_NO_SCROLL=1 để tắt dò cuộn (copy rect)
+    const char* no_scroll = std::getenv("RC_SCREEN_NO_SCROLL");
+    scroll_enabled_ = !(no_scroll && no_scroll[0] == '1');
+}
+
+ScreenStreamer::~ScreenStreamer() {
+    std::vector<std::shared_ptr<Session>> all;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        running_ = false;
+        for (auto& kv : sessions_) all.push_back(kv.second);
+        sessions_.clear();
+    }
+    cv_.notify_all();
+    {
+        std::lock_guard<std::mutex> lock(encode_mtx_);
+        encode_wake_ = true;
+    }
+    encode_cv_.notify_all();
+    if (capture_thread_.joinable()) capture_thread_.join();
+    if (encode_thread_.joinable()) encode_thread_.join();
+    for (auto& s : all) close_session(*s);
+}
+
+void ScreenStreamer::ensure_threads() {
+    // Gọi khi đang giữ mtx_. 2 stage đầu sống tới khi huỷ streamer, không có session thì ngủ.
+    if (running_) return;
+    running_ = true;
+    capture_thread_ = std::thread(&ScreenStreamer::capture_loop, this);
+    encode_thread_ = std::thread(&ScreenStreamer::encode_loop, this);
+    std::cout << "[SCREEN] Stream pipeline started (" << pool_.size() << " encoder threads"
+              << (stripes_ ? ", stripes" : "") << ")\n";
+}
+
+void ScreenStreamer::start(uint64_t session_id, const ScreenStreamOptions& opts, ScreenFrameCallback callback,
+                           ScreenLinkProbe probe) {
+    ScreenStreamOptions clamped;
+    clamped.fps = clamp_int(opts.fps, 1, 60);
+    clamped.quality = clamp_int(opts.quality, 10, 95);
+    clamped.view_width = clamp_int(opts.view_width, 0, 16384);
+    clamped.view_height = clamp_int(opts.view_height, 0, 16384);
+    clamped.video = opts.video && H264Encoder::available();
+    clamped.bitrate_kbps = clamp_int(opts.bitrate_kbps, 0, 100000);
+    clamped.codec = (opts.codec == ScreenProtocol::CODEC_QOI) ? ScreenProtocol::CODEC_QOI
+                  : (opts.codec == ScreenProtocol::CODEC_WEBP && WebpEncoder::available()) ? ScreenProtocol::CODEC_WEBP
+                  : ScreenProtocol::CODEC_JPEG;
+    clamped.webp_method = clamp_int(opts.webp_method, WebpEncoder::FAST, 6);
+    clamped.adaptive = opts.adaptive;
+    clamped.refine_ms = clamp_int(opts.refine_ms, 0, 10000);
+    clamped.refine_quality = opts.refine_quality <= 0 ? 0 : clamp_int(opts.refine_quality, 10, 95);
+    clamped.latency_ms = clamp_int(opts.latency_ms, 0, 10000);
+    clamped.layer = opts.layer <= ScreenProtocol::LAYER_FULL ? opts.layer : (uint8_t)ScreenProtocol::LAYER_NONE;
+    const ScreenStreamOptions effective = layered(clamped, clamped.layer);
+
+    std::shared_ptr<Session> created;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        auto it = sessions_.find(session_id);
+        if (it != sessions_.end()) {
+            // Đang stream: chỉ đổi tham số, giữ nguyên sender
+            it->second->custom = clamped;
+            it->second->requested = effective;
+            it->second->resync = true;
+        } else {
+            created = std::make_shared<Session>();
+            created->id = session_id;
+            created->callback = std::move(callback);
+            created->probe = std::move(probe);
+            created->custom = clamped;
+            created->requested = effective;
+            sessions_[session_id] = created;
+        }
+        ensure_threads();
+    }
+    if (created) created->sender = std::thread(&ScreenStreamer::send_loop, this, created.get());
+
+    cv_.notify_all();
+    {
+        std::lock_guard<std::mutex> lock(encode_mtx_);
+        encode_wake_ = true;
+    }
+    encode_cv_.notify_one();
+    std::cout << "[SCREEN] Stream started for session " << session_id << " (";
+    if (clamped.layer != ScreenProtocol::LAYER_NONE) std::cout << "layer " << LAYERS[clamped.layer].name << ", ";
+    std::cout << effective.fps << " fps, q" << effective.quality;
+    if (clamped.video) std::cout << ", H.264";
+    else if (clamped.adaptive) std::cout << ", codec per tile";
+    else if (clamped.codec == ScreenProtocol::CODEC_QOI) std::cout << ", lossless";
+    else if (clamped.codec == ScreenProtocol::CODEC_WEBP) std::cout << ", WebP";
+    if (clamped.latency_ms > 0) std::cout << ", target " << clamped.latency_ms << " ms";
+    if (clamped.view_width > 0 || clamped.view_height > 0) {
+        std::cout << ", view " << clamped.view_width << "x" << clamped.view_height;
+    }
+    std::cout << ")\n";
+}
+
+void ScreenStreamer::stop(uint64_t session_id) {
+    std::shared_ptr<Session> session;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        auto it = sessions_.find(session_id);
+        if (it == sessions_.end()) return;
+        session = it->second;
+        sessions_.erase(it);
+    }
+    cv_.notify_all();
+    close_session(*session);
+
+    std::lock_guard<std::mutex> lock(session->stats_mtx);
+    std::cout << "[SCREEN] Stream stopped for session " << session_id << " (" << session->stats.frames_sent
+              << " frames, avg age " << session->stats.avg_age_ms << " ms, max " << session->stats.max_age_ms
+              << " ms)\n";
+}
+
+bool ScreenStreamer::stats(uint64_t session_id, ScreenStreamStats& out) {
+    std::shared_ptr<Session> session;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        auto it = sessions_.find(session_id);
+        if (it == sessions_.end()) return false;
+        session = it->second;
+    }
+    std::lock_guard<std::mutex> lock(session->stats_mtx);
+    out = session->stats;
+    out.frames_merged = frames_merged_;
+    return true;
+}
+
+void ScreenStreamer::request_keyframe(uint64_t session_id) {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        auto it = sessions_.find(session_id);
+        if (it == sessions_.end()) return;
+        it->second->refresh = true;
+    }
+    {
+        std::lock_guard<std::mutex> lock(encode_mtx_);
+        encode_wake_ = true;
+    }
+    encode_cv_.notify_one();
+}
+
+bool ScreenStreamer::set_layer(uint64_t session_id, uint8_t layer) {
+    if (layer > ScreenProtocol::LAYER_FULL) layer = ScreenProtocol::LAYER_NONE;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        auto it = sessions_.find(session_id);
+        if (it == sessions_.end()) return false;
+        Session& s = *it->second;
+        s.custom.layer = layer;
+        s.requested = layered(s.custom, layer);
+        s.resync = true;   // Đổi hệ số thu nhỏ -> client nhận lại toàn màn hình ở cỡ mới
+    }
+    // Nhịp chụp theo FPS lớn nhất có thể đổi
+    cv_.notify_all();
+    {
+        std::lock_guard<std::mutex> lock(encode_mtx_);
+        encode_wake_ = true;
+    }
+    encode_cv_.notify_one();
+    std::cout << "[SCREEN] Session " << session_id << " switched to layer " << LAYERS[layer].name << "\n";
+    return true;
+}
+
+ScreenStreamOptions ScreenStreamer::layered(const ScreenStreamOptions& custom, uint8_t layer) {
+    if (layer == ScreenProtocol::LAYER_NONE) return custom;
+    // Mọi session cùng lớp phải giống hệt nhau để dùng chung bản nén: bỏ tham số riêng của client
+    ScreenStreamOptions opts;
+    opts.layer = layer;
+    opts.fps = LAYERS[layer].fps;
+    opts.quality = LAYERS[layer].quality;
+    opts.video = false;
+    return opts;
+}
+
+// ==========================================================
+// Stage 1: capture
+// ==========================================================
+void ScreenStreamer::capture_loop() {
+    std::unique_lock<std::mutex> lock(mtx_);
+    Clock::time_point next = Clock::now();
+    while (running_) {
+        if (sessions_.empty()) {
+            cv_.wait(lock);
+            next = Clock::now();
+            continue;
+        }
+
+        // Chụp theo session có FPS cao nhất, session chậm hơn lấy thay đổi gộp lại
+        int fps = 1;
+        for (const auto& kv : sessions_) fps = std::max(fps, kv.second->requested.fps);
+        auto period = std::chrono::microseconds(1000000 / fps);
+        Clock::time_point now = Clock::now();
+        if (next > now + period) next = now + period;   // Vừa tăng FPS
+        if (next > now) {
+            cv_.wait_until(lock, next);
+            continue;
+        }
+        // Trễ quá 1 chu kỳ thì bỏ nhịp, không dồn frame
+        next = (next + period < now) ? now + period : next + period;
+
+        lock.unlock();
+        capture_once();
+        lock.lock();
+    }
+}
+
+void ScreenStreamer::poll_cursor() {
+    // Gọi khi đang giữ capture_mtx_
+    if (!cursor_enabled_) return;
+    int x = 0, y = 0;
+    bool shape_changed = false;
+    std::string err;
+    if (!ctx_.query_cursor(x, y, shape_changed, cursor_staging_, err)) {
+        if (!cursor_failed_ && ctx_.cursor_tracking()) std::cerr << "[SCREEN] Cursor query failed: " << err << "\n";
+        cursor_failed_ = true;
+        return;
+    }
+    cursor_failed_ = false;
+    if (!shape_changed && x == cursor_last_x_ && y == cursor_last_y_) return;
+    cursor_last_x_ = x;
+    cursor_last_y_ = y;
+
+    const uint64_t ts = steady_now_us();
+    FrameBuffer shape;
+    if (shape_changed) {
+        // Đóng gói 1 lần, mọi sender gửi chung buffer này
+        const X11CaptureContext::PointerShape& c = cursor_staging_;
+        shape = FrameBufferPool::shared().acquire(ScreenProtocol::HEADER_SIZE + 8 + c.rgba.size());
+        std::vector<uint8_t>& packet = shape.bytes();
+        ScreenProtocol::begin_message(packet, ScreenProtocol::MSG_CURSOR_SHAPE, 0, ts);
+        ScreenProtocol::put_u16(packet, (uint16_t)c.width);
+        ScreenProtocol::put_u16(packet, (uint16_t)c.height);
+        ScreenProtocol::put_u16(packet, (uint16_t)c.xhot);
+        ScreenProtocol::put_u16(packet, (uint16_t)c.yhot);
+        packet.insert(packet.end(), c.rgba.begin(), c.rgba.end());
+    }
+    {
+        std::lock_guard<std::mutex> lock(cursor_mtx_);
+        if (shape) {
+            swap(cursor_shape_, shape);
+            cursor_shape_id_++;
+        }
+        cursor_x_ = x;
+        cursor_y_ = y;
+        cursor_screen_w_ = ctx_.width();
+        cursor_screen_h_ = ctx_.height();
+        cursor_ts_ = ts;
+        cursor_version_++;
+    }
+    notify_senders();
+}
+
+void ScreenStreamer::notify_senders() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    for (auto& kv : sessions_) {
+        Session& s = *kv.second;
+        {
+            // Khoá rồi nhả: sender đang kiểm tra điều kiện chờ sẽ không lỡ notify
+            std::lock_guard<std::mutex> send_lock(s.send_mtx);
+        }
+        s.send_cv.notify_one();
+    }
+}
+
+void ScreenStreamer::capture_once() {
+    std::lock_guard<std::mutex> lock(capture_mtx_);
+    poll_cursor();
+
+    std::string err;
+    bool full_read = true;
+    // XDamage (nếu có): chỉ đọc lại vùng thay đổi, màn hình đứng yên thì không đọc gì
+    XImage* img = ctx_.grab_damaged(damaged_, full_read, err);
+    if (!img) {
+        if (!last_capture_failed_) std::cerr << "[SCREEN] Stream capture failed: " << err << "\n";
+        last_capture_failed_ = true;
+        return;
+    }
+    last_capture_failed_ = false;
+
+    const uint64_t timestamp_us = steady_now_us();
+    const int width = img->width;
+    const int height = img->height;
+    const int bpp = img->bits_per_pixel / 8;
+
+    const std::vector<uint8_t>& changed = full_read
+        ? differ_.update((const uint8_t*)img->data, width, height, img->bytes_per_line, bpp)
+        : differ_.update_regions((const uint8_t*)img->data, width, height, img->bytes_per_line, bpp, damaged_);
+    // Copy rect chỉ đúng khi stage nén đang có đúng frame trước (không còn thay đổi gộp lại chưa đẩy đi)
+    const bool in_sync = !pending_reset_ && pending_.size() == changed.size() && !any_set(pending_);
+    ScrollCopy copy;
+    const bool has_copy = scroll_enabled_
+        && scroll_.update((const uint8_t*)img->data, width, height, img->bytes_per_line, bpp, changed,
+                          differ_.was_reset(), copy)
+        && in_sync;
+    if (differ_.was_reset() || pending_.size() != changed.size()) {
+        pending_reset_ = true;
+        pending_.assign(changed.size(), 1);
+    } else {
+        for (size_t i = 0; i < changed.size(); i++) pending_[i] |= changed[i];
+    }
+    if (!pending_reset_ && !any_set(pending_)) return;
+
+    // Stage nén còn 2 frame chưa xử lý -> giữ lại bitmap, lần sau copy pixel mới nhất
+    if (frames_.full()) {
+        frames_merged_++;
+        return;
+    }
+
+    FrameChange& f = capture_staging_;
+    f.timestamp_us = timestamp_us;
+    f.width = width;
+    f.height = height;
+    f.bpp = bpp;
+    f.layout = ctx_.pixel_layout();
+    f.reset = pending_reset_;
+    f.changed = pending_;
+    f.has_copy = has_copy;
+    f.copy = copy;
+    f.pixels.clear();
+    const int cols = differ_.cols(), rows = differ_.rows();
+    for (int ty = 0; ty < rows; ty++) {
+        const int y0 = ty * TileDiffer::TILE_SIZE;
+        const int th = std::min(height, y0 + TileDiffer::TILE_SIZE) - y0;
+        for (int tx = 0; tx < cols; tx++) {
+            if (!pending_[(size_t)ty * cols + tx]) continue;
+            const int x0 = tx * TileDiffer::TILE_SIZE;
+            const size_t len = (size_t)(std::min(width, x0 + TileDiffer::TILE_SIZE) - x0) * bpp;
+            for (int y = 0; y < th; y++) {
+                const uint8_t* src = (const uint8_t*)img->data + (size_t)(y0 + y) * img->bytes_per_line
+                                   + (size_t)x0 * bpp;
+                f.pixels.insert(f.pixels.end(), src, src + len);
+            }
+        }
+    }
+    frames_.try_push(f);
+
+    std::fill(pending_.begin(), pending_.end(), 0);
+    pending_reset_ = false;
+    {
+        std::lock_guard<std::mutex> wake(encode_mtx_);
+        encode_wake_ = true;
+    }
+    encode_cv_.notify_one();
+}
+
+// ==========================================================
+// Stage 2: encode
+// ==========================================================
+void ScreenStreamer::encode_loop() {
+    std::vector<std::shared_ptr<Session>> sessions;
+    Clock::time_point deadline = Clock::time_point::max();
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(encode_mtx_);
+            auto ready = [this] { return encode_wake_ || !frames_.empty(); };
+            if (deadline == Clock::time_point::max()) encode_cv_.wait(lock, ready);
+            else encode_cv_.wait_until(lock, deadline, ready);
+            encode_wake_ = false;
+        }
+
+        sessions.clear();
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            if (!running_) return;
+            for (auto& kv : sessions_) {
+                Session& s = *kv.second;
+                if (s.resync) {
+                    s.resync = false;
+                    s.opts = s.requested;
+                    if (!s.opts.video) s.video.reset();
+                    s.rate.reset(s.opts.latency_ms, s.opts.fps, s.opts.quality);
+                    s.fps = s.opts.fps;
+                    s.quality = s.opts.quality;
+                    s.rate_scale = 1;
+                    s.rate_enabled = s.rate.enabled();
+                    {
+                        std::lock_guard<std::mutex> stats_lock(s.stats_mtx);
+                        s.stats.layer = s.opts.layer;
+                        s.stats.rate_budget = 1;
+                        s.stats.rate_fps = s.fps;
+                        s.stats.rate_quality = s.quality;
+                    }
+                    s.full = true;
+                    s.next_due = Clock::now();
+                }
+                if (s.refresh) {
+                    s.refresh = false;
+                    s.full = true;
+                }
+                sessions.push_back(kv.second);
+            }
+        }
+
+        while (frames_.try_pop(encode_staging_)) apply_frame(encode_staging_, sessions);
+
+        encode_due(sessions, Clock::now());
+
+        // Ngủ tới khi có frame mới, hoặc tới hạn của session còn vùng bẩn chưa gửi
+        deadline = Clock::time_point::max();
+        if (canvas_w_ == 0) continue;
+        for (const auto& s : sessions) {
+            if (s->full || any_set(s->dirty) || !s->copies.empty()) {
+                deadline = std::min(deadline, s->next_due);
+            } else if (s->opts.refine_ms > 0 && !s->opts.video && any_set(s->unrefined)) {
+                // Chờ tới khi màn hình đứng yên đủ refine_ms để làm nét
+                deadline = std::min(deadline, std::max(s->next_due,
+                                                       s->last_change + std::chrono::milliseconds(s->opts.refine_ms)));
+            }
+        }
+    }
+}
+
+void ScreenStreamer::apply_frame(const FrameChange& f, const std::vector<std::shared_ptr<Session>>& sessions) {
+    if (f.reset || f.width != canvas_w_ || f.height != canvas_h_ || f.bpp != canvas_bpp_) {
+        canvas_w_ = f.width;
+        canvas_h_ = f.height;
+        canvas_bpp_ = f.bpp;
+        canvas_.resize((size_t)f.width * f.height * f.bpp);
+        for (ScaledCanvas& sc : scaled_) sc.valid = false;
+        for (const auto& s : sessions) s->full = true;
+    }
+    canvas_layout_ = f.layout;
+    canvas_ts_ = f.timestamp_us;
+
+    const int tile = TileDiffer::TILE_SIZE;
+    const int cols = (f.width + tile - 1) / tile;
+    const int rows = (f.height + tile - 1) / tile;
+    const size_t row_bytes = (size_t)f.width * f.bpp;
+    const uint8_t* src = f.pixels.data();
+    for (int ty = 0; ty < rows; ty++) {
+        const int y0 = ty * tile;
+        const int th = std::min(f.height, y0 + tile) - y0;
+        for (int tx = 0; tx < cols; tx++) {
+            if (!f.changed[(size_t)ty * cols + tx]) continue;
+            const int x0 = tx * tile;
+            const size_t len = (size_t)(std::min(f.width, x0 + tile) - x0) * f.bpp;
+            for (int y = 0; y < th; y++) {
+                std::memcpy(canvas_.data() + (size_t)(y0 + y) * row_bytes + (size_t)x0 * f.bpp, src, len);
+                src += len;
+            }
+            // Tile đã thu nhỏ: biên tile (64) chia hết cho hệ số, phần lẻ ở mép màn hình bị bỏ
+            for (ScaledCanvas& sc : scaled_) {
+                if (!sc.valid) continue;
+                const int k = sc.scale;
+                const int dw = std::min(f.width, x0 + tile) / k - x0 / k;
+                const int dh = std::min(f.height, y0 + tile) / k - y0 / k;
+                if (dw <= 0 || dh <= 0) continue;
+                PixelConvert::downscale(canvas_.data() + (size_t)y0 * row_bytes + (size_t)x0 * 4, (int)row_bytes,
+                                        sc.pixels.data() + (size_t)(y0 / k) * sc.w * 4 + (size_t)(x0 / k) * 4,
+                                        sc.w * 4, dw, dh, k);
+            }
+        }
+    }
+
+    // Session nào cũng phải nhận thay đổi này, kể cả khi chưa đến hạn gửi
+    const Clock::time_point now = Clock::now();
+    for (const auto& s : sessions) {
+        s->last_change = now;
+        if (s->full) continue;
+        if (s->dirty.size() != f.changed.size()) {
+            s->full = true;
+            continue;
+        }
+        if (f.has_copy && apply_copy(*s, f)) continue;
+        for (size_t i = 0; i < f.changed.size(); i++) s->dirty[i] |= f.changed[i];
+    }
+}
+
+// Cuộn: thêm 1 copy rect cho session, dirty dịch theo nội dung (tile client còn cũ ở vùng nguồn thì
+// vùng đích cũng cũ), chỉ tile không nằm trọn trong vùng đích mới phải gửi lại.
+// false nếu session không dùng được copy rect (video, hệ số thu nhỏ không chia hết độ dịch...)
+bool ScreenStreamer::apply_copy(Session& s, const FrameChange& f) {
+    const int k = s.scale;
+    const TileRect& c = f.copy.dst;
+    const int dy = f.copy.dy;
+    if (s.opts.video || s.copies.size() >= MAX_PENDING_COPIES) return false;
+    if (c.y % k != 0 || dy % k != 0) return false;
+
+    const int tile = TileDiffer::TILE_SIZE;
+    const int cols = (f.width + tile - 1) / tile;
+    const int rows = (f.height + tile - 1) / tile;
+    const int tx0 = c.x / tile;
+    const int tx1 = (c.x + c.w + tile - 1) / tile;
+    const int ty0 = (c.y + tile - 1) / tile;
+    // Hàng tile cuối ở mép dưới màn hình ngắn hơn tile -> vẫn nằm trọn nếu vùng đích chạm mép
+    const int ty1 = (c.y + c.h == f.height) ? rows : (c.y + c.h) / tile;
+
+    dirty_scratch_.resize(s.dirty.size());
+    unrefined_scratch_ = s.unrefined;
+    for (int ty = 0; ty < rows; ty++) {
+        const int y0 = ty * tile;
+        const int y1 = std::min(f.height, y0 + tile);
+        for (int tx = 0; tx < cols; tx++) {
+            const size_t t = (size_t)ty * cols + tx;
+            const bool in_cols = tx >= tx0 && tx < tx1;
+            if (in_cols && ty >= ty0 && ty < ty1) {
+                uint8_t stale = 0, lossy = 0;
+                for (int sy = (y0 - dy) / tile; sy <= (y1 - 1 - dy) / tile; sy++) {
+                    stale |= s.dirty[(size_t)sy * cols + tx];
+                    if (!s.unrefined.empty()) lossy |= s.unrefined[(size_t)sy * cols + tx];
+                }
+                dirty_scratch_[t] = stale;
+                // Nội dung đã gửi lossy cũng dịch theo, vẫn cần làm nét ở vị trí mới
+                if (!s.unrefined.empty()) unrefined_scratch_[t] = lossy;
+            } else if (in_cols && y1 > c.y && y0 < c.y + c.h) {
+                dirty_scratch_[t] = 1;   // Tile bị copy đè 1 phần
+            } else {
+                dirty_scratch_[t] = s.dirty[t] | f.changed[t];
+            }
+        }
+    }
+    s.dirty.swap(dirty_scratch_);
+    s.unrefined.swap(unrefined_scratch_);
+
+    ScrollCopy scaled;
+    scaled.dst.x = c.x / k;
+    scaled.dst.y = c.y / k;
+    scaled.dst.w = std::min(f.width / k, (c.x + c.w) / k) - c.x / k;
+    scaled.dst.h = c.h / k;
+    scaled.dy = dy / k;
+    s.copies.push_back(scaled);
+    return true;
+}
+
+// Hệ số thu nhỏ lớn nhất (1, 2, 4) mà ảnh vẫn không nhỏ hơn vùng hiển thị của client.
+// Chiều nào bằng 0 thì không giới hạn theo chiều đó. Chỉ áp dụng cho ảnh 32bpp (box filter trên 4 byte/pixel).
+int ScreenStreamer::pick_scale(const ScreenStreamOptions& opts) const {
+    if (canvas_bpp_ != 4) return 1;
+    if (opts.layer != ScreenProtocol::LAYER_NONE) return LAYERS[opts.layer].scale;
+    if (opts.view_width <= 0 && opts.view_height <= 0) return 1;
+    for (int k : {4, 2}) {
+        if (canvas_w_ / k >= opts.view_width && canvas_h_ / k >= opts.view_height) return k;
+    }
+    return 1;
+}
+
+// Đưa độ trễ sender đo được vào bộ điều khiển, áp quyết định cho các lần gửi sau.
+// Chế độ video chỉ đổi nhịp gửi + hệ số thu nhỏ: đổi quality phải mở lại x264 (thêm 1 IDR)
+void ScreenStreamer::update_rate(Session& s, Clock::time_point now) {
+    if (!s.rate.enabled()) return;
+    std::lock_guard<std::mutex> lock(s.stats_mtx);
+    const int64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
+    if (!s.rate.update(s.stats.delay_ms, now_ms)) return;
+    const RateController::Decision& d = s.rate.decision();
+    s.fps = d.fps;
+    if (!s.opts.video) s.quality = d.quality;
+    s.rate_scale = d.scale;
+    s.stats.rate_budget = s.rate.budget();
+    s.stats.rate_fps = s.fps;
+    s.stats.rate_quality = s.quality;
+    s.stats.rate_changes++;
+}
+
+// Cập nhật hệ số của từng session, dựng canvas thu nhỏ khi có session mới dùng, bỏ khi không còn ai dùng
+void ScreenStreamer::update_scaled(const std::vector<std::shared_ptr<Session>>& sessions) {
+    bool used[2] = {false, false};
+    for (const auto& s : sessions) {
+        // Bộ điều khiển tốc độ chỉ thu nhỏ thêm được khi canvas 32 bit (như pick_scale)
+        const int k = canvas_bpp_ == 4 ? std::max(pick_scale(s->opts), s->rate_scale) : pick_scale(s->opts);
+        if (k != s->scale) {
+            // Đổi kích thước ảnh gửi đi -> client dựng lại canvas, gửi lại toàn màn hình
+            s->scale = k;
+            s->full = true;
+            std::lock_guard<std::mutex> lock(s->stats_mtx);
+            s->stats.scale = k;
+        }
+        if (k == 2) used[0] = true;
+        if (k == 4) used[1] = true;
+    }
+    for (int i = 0; i < 2; i++) {
+        ScaledCanvas& sc = scaled_[i];
+        if (!used[i]) {
+            sc.valid = false;   // Giữ lại bộ nhớ cho lần dùng sau
+            continue;
+        }
+        if (sc.valid) continue;
+        sc.w = canvas_w_ / sc.scale;
+        sc.h = canvas_h_ / sc.scale;
+        sc.pixels.resize((size_t)sc.w * sc.h * 4);
+        PixelConvert::downscale(canvas_.data(), canvas_w_ * 4, sc.pixels.data(), sc.w * 4, sc.w, sc.h, sc.scale);
+        sc.valid = true;
+    }
+}
+
+const uint8_t* ScreenStreamer::canvas_at(int scale, const TileRect& r, size_t& stride) const {
+    const uint8_t* base = canvas_.data();
+    stride = (size_t)canvas_w_ * canvas_bpp_;
+    if (scale > 1) {
+        const ScaledCanvas& sc = scaled_[scale == 2 ? 0 : 1];
+        base = sc.pixels.data();
+        stride = (size_t)sc.w * 4;
+    }
+    return base + (size_t)r.y * stride + (size_t)r.x * canvas_bpp_;
+}
+
+size_t ScreenStreamer::add_job(const TileRect& r, int scale, uint8_t codec, int quality, int effort) {
+    for (size_t j = 0; j < job_count_; j++) {
+        const EncodeJob& job = jobs_[j];
+        if (job.codec == codec && job.quality == quality && job.effort == effort && job.scale == scale && job.rect.x == r.x
+            && job.rect.y == r.y && job.rect.w == r.w && job.rect.h == r.h) {
+            jobs_[j].users++;
+            return j;
+        }
+    }
+    if (job_count_ == jobs_.size()) jobs_.emplace_back();
+    EncodeJob& job = jobs_[job_count_];
+    job.rect = r;
+    job.scale = scale;
+    job.codec = codec;
+    job.quality = quality;
+    job.effort = effort;
+    job.users = 1;
+    job.ok = false;
+    return job_count_++;
+}
+
+void ScreenStreamer::add_probes(Session& s, int cols, int rows) {
+    // Mỗi tile bẩn = 1 ô phân loại (TILE_SIZE / scale trên canvas thu nhỏ), dùng chung giữa các session cùng hệ số
+    const int k = s.scale;
+    const int slot = (k == 1) ? 0 : (k == 2) ? 1 : 2;
+    std::vector<int>& index = probe_index_[slot];
+    if (index.size() != (size_t)cols * rows) index.assign((size_t)cols * rows, -1);
+    if (probe_frame_[slot] != probe_generation_) {
+        std::fill(index.begin(), index.end(), -1);
+        probe_frame_[slot] = probe_generation_;
+    }
+    const int tile = TileDiffer::TILE_SIZE;
+    const int sw = canvas_w_ / k, sh = canvas_h_ / k;
+    for (int ty = 0; ty < rows; ty++) {
+        for (int tx = 0; tx < cols; tx++) {
+            const size_t t = (size_t)ty * cols + tx;
+            if (!s.dirty[t]) continue;
+            if (index[t] < 0) {
+                const int x = tx * tile, y = ty * tile;
+                TileRect d{x / k, y / k, std::min(sw, std::min(canvas_w_, x + tile) / k) - x / k,
+                           std::min(sh, std::min(canvas_h_, y + tile) / k) - y / k};
+                if (d.w <= 0 || d.h <= 0) continue;
+                if (probe_count_ == probes_.size()) probes_.emplace_back();
+                TileProbe& probe = probes_[probe_count_];
+                probe.rect = d;
+                probe.scale = k;
+                index[t] = (int)probe_count_++;
+            }
+            s.probes.push_back((size_t)index[t]);
+        }
+    }
+}
+
+void ScreenStreamer::add_adaptive_jobs(Session& s) {
+    // Gộp các tile liền nhau trên cùng hàng có cùng lựa chọn thành 1 vùng (đỡ header JPEG / tile)
+    auto pick = [&s](const TileClassifier::Result& res, uint8_t& codec, int& quality) {
+        switch (res.kind) {
+        case TileClassifier::SOLID:   codec = ScreenProtocol::CODEC_SOLID; quality = 0; break;
+        case TileClassifier::PALETTE: codec = ScreenProtocol::CODEC_QOI; quality = 0; break;
+        case TileClassifier::DETAILED:
+            codec = ScreenProtocol::CODEC_JPEG;
+            quality = std::min(95, s.quality + DETAILED_QUALITY_BOOST);
+            break;
+        default:                      codec = ScreenProtocol::CODEC_JPEG; quality = s.quality; break;
+        }
+    };
+    TileRect run;
+    uint8_t run_codec = 0;
+    int run_quality = 0;
+    uint32_t run_color = 0;
+    bool open = false;
+    for (size_t p : s.probes) {
+        const TileProbe& probe = probes_[p];
+        uint8_t codec;
+        int quality;
+        pick(probe.result, codec, quality);
+        const TileRect& r = probe.rect;
+        if (open && codec == run_codec && quality == run_quality && r.y == run.y && r.h == run.h
+            && r.x == run.x + run.w && (codec != ScreenProtocol::CODEC_SOLID || probe.result.color == run_color)) {
+            run.w += r.w;
+            continue;
+        }
+        if (open) s.jobs.push_back(add_job(run, s.scale, run_codec, run_quality));
+        run = r;
+        run_codec = codec;
+        run_quality = quality;
+        run_color = probe.result.color;
+        open = true;
+    }
+    if (open) s.jobs.push_back(add_job(run, s.scale, run_codec, run_quality));
+}
+
+// Tile đánh dấu trong bitmap -> rects_ (toạ độ canvas thu nhỏ theo scale, cắt dải nếu bật stripes)
+void ScreenStreamer::tile_rects(const std::vector<uint8_t>& tiles, int scale, int cols, int rows) {
+    TileDiffer::to_rects(tiles, cols, rows, canvas_w_, canvas_h_, rects_);
+    if (scale > 1) {
+        // Đổi sang toạ độ canvas thu nhỏ (x, y là bội số của tile nên chia hết), bỏ vùng chỉ còn phần lẻ ở mép
+        const int k = scale;
+        const int sw = canvas_w_ / k, sh = canvas_h_ / k;
+        size_t kept = 0;
+        for (const TileRect& r : rects_) {
+            TileRect d{r.x / k, r.y / k, std::min(sw, (r.x + r.w) / k) - r.x / k,
+                       std::min(sh, (r.y + r.h) / k) - r.y / k};
+            if (d.w > 0 && d.h > 0) rects_[kept++] = d;
+        }
+        rects_.resize(kept);
+    }
+    if (stripes_) TileDiffer::split_stripes(rects_, pool_.size());
+}
+
+// Ngược lại của tile_rects: đánh dấu các tile mà vùng r (toạ độ canvas thu nhỏ) phủ lên
+void ScreenStreamer::mark_tiles(std::vector<uint8_t>& tiles, const TileRect& r, int scale, int cols, int rows) {
+    const int tile = TileDiffer::TILE_SIZE;
+    if (tiles.size() != (size_t)cols * rows) return;
+    const int tx1 = std::min(cols, ((r.x + r.w) * scale + tile - 1) / tile);
+    const int ty1 = std::min(rows, ((r.y + r.h) * scale + tile - 1) / tile);
+    for (int ty = r.y * scale / tile; ty < ty1; ty++) {
+        for (int tx = r.x * scale / tile; tx < tx1; tx++) tiles[(size_t)ty * cols + tx] = 1;
+    }
+}
+
+bool ScreenStreamer::refine_due(const Session& s, Clock::time_point now) const {
+    if (s.opts.refine_ms <= 0 || s.opts.video || !any_set(s.unrefined)) return false;
+    return now - s.last_change >= std::chrono::milliseconds(s.opts.refine_ms);
+}
+
+void ScreenStreamer::encode_due(const std::vector<std::shared_ptr<Session>>& sessions, Clock::time_point now) {
+    if (canvas_w_ == 0) return;
+    const int tile = TileDiffer::TILE_SIZE;
+    const int cols = (canvas_w_ + tile - 1) / tile;
+    const int rows = (canvas_h_ + tile - 1) / tile;
+    for (const auto& s : sessions) update_rate(*s, now);
+    update_scaled(sessions);
+
+    // 1. Gom vùng cần nén của mọi session đến hạn, mỗi (vùng, hệ số, codec, quality) chỉ nén 1 lần
+    job_count_ = 0;
+    probe_count_ = 0;
+    probe_generation_++;
+    Session* layer_leader[ScreenProtocol::LAYER_FULL + 1] = {};
+    for (const auto& s : sessions) {
+        s->jobs.clear();
+        s->probes.clear();
+        s->tiles_due = false;
+        s->refining = false;
+        if (s->next_due > now) continue;
+        if (!s->full && !any_set(s->dirty) && s->copies.empty()) {
+            // Màn hình đứng yên đủ lâu: gửi lại vùng đã gửi lossy ở quality cao / lossless
+            if (!refine_due(*s, now)) continue;
+            s->refining = true;
+        }
+
+        auto period = std::chrono::microseconds(1000000 / s->fps);
+        if (s->outbox.full()) {
+            // Sender còn đang ghi frame trước: không xếp hàng, vùng bẩn gộp vào lần gửi sau
+            s->next_due = (s->opts.layer != ScreenProtocol::LAYER_NONE) ? layer_tick(now, period) : now + period;
+            std::lock_guard<std::mutex> lock(s->stats_mtx);
+            s->stats.frames_skipped++;
+            continue;
+        }
+        if (s->opts.layer != ScreenProtocol::LAYER_NONE) {
+            // Cùng lớp -> cùng lưới thời gian: các session đến hạn trong cùng 1 lần, vùng giống nhau nén 1 lần
+            s->next_due = layer_tick(now, period);
+        } else {
+            s->next_due = (s->next_due + period < now) ? now + period : s->next_due + period;
+        }
+
+        if (s->full) {
+            s->dirty.assign((size_t)cols * rows, 1);
+            s->unrefined.assign((size_t)cols * rows, 0);
+            s->copies.clear();
+        }
+        if (s->opts.video) {
+            // Video nén cả khung hình ở bước 4, dirty chỉ để biết màn hình có đổi hay không
+            s->video_due = true;
+            continue;
+        }
+        s->tiles_due = true;
+        if (s->refining) {
+            // Lượt làm nét: chỉ các tile đã gửi lossy, codec / quality riêng của lượt này
+            tile_rects(s->unrefined, s->scale, cols, rows);
+            const uint8_t codec = s->opts.refine_quality <= 0 ? ScreenProtocol::CODEC_QOI
+                                : s->opts.codec == ScreenProtocol::CODEC_WEBP ? ScreenProtocol::CODEC_WEBP
+                                : ScreenProtocol::CODEC_JPEG;
+            const int effort = (codec == ScreenProtocol::CODEC_WEBP) ? s->opts.webp_method : 0;
+            for (const TileRect& r : rects_) s->jobs.push_back(add_job(r, s->scale, codec, s->opts.refine_quality, effort));
+            continue;
+        }
+        if (s->opts.adaptive) {
+            // Codec theo từng tile: gom tile cần phân loại, chọn codec + gộp job sau bước phân loại
+            add_probes(*s, cols, rows);
+            continue;
+        }
+        if (s->opts.layer != ScreenProtocol::LAYER_NONE) {
+            // Cùng lớp, cùng vùng bẩn với session trước (thường gặp: đến hạn cùng lần) -> dùng luôn danh sách job
+            Session* leader = layer_leader[s->opts.layer];
+            if (leader && leader->copies.empty() && s->copies.empty() && leader->scale == s->scale
+                && leader->dirty == s->dirty) {
+                s->jobs = leader->jobs;
+                for (size_t j : s->jobs) jobs_[j].users++;
+                continue;
+            }
+            layer_leader[s->opts.layer] = s.get();
+        }
+        tile_rects(s->dirty, s->scale, cols, rows);
+        const uint8_t codec = s->opts.codec;
+        const int quality = (codec == ScreenProtocol::CODEC_QOI) ? 0 : s->quality;
+        const int effort = (codec == ScreenProtocol::CODEC_WEBP) ? s->opts.webp_method : 0;
+        for (const TileRect& r : rects_) s->jobs.push_back(add_job(r, s->scale, codec, quality, effort));
+    }
+    if (probe_count_ > 0) {
+        // 1b. Phân loại tile song song trên pool rồi mới biết codec của từng vùng
+        pool_.run(probe_count_, [this](size_t i, JpegEncoder&) {
+            TileProbe& probe = probes_[i];
+            size_t stride = 0;
+            const uint8_t* origin = canvas_at(probe.scale, probe.rect, stride);
+            probe.result = TileClassifier::classify(origin, probe.rect.w, probe.rect.h, (int)stride, canvas_layout_);
+        });
+        for (const auto& s : sessions) {
+            if (!s->probes.empty()) add_adaptive_jobs(*s);
+        }
+    }
+    // 2. Nén song song trên pool, đọc từ canvas_ / canvas thu nhỏ (chỉ thread này ghi các canvas)
+    // Lambda chỉ bắt this -> nằm gọn trong std::function, không cấp phát mỗi frame
+    const Clock::time_point encode_start = Clock::now();
+    if (job_count_ > 0) pool_.run(job_count_, [this](size_t i, JpegEncoder& encoder) {
+        EncodeJob& job = jobs_[i];
+        size_t stride = 0;
+        const uint8_t* origin = canvas_at(job.scale, job.rect, stride);
+        if (job.codec == ScreenProtocol::CODEC_SOLID) {
+            // Cả vùng 1 màu: chỉ gửi 3 byte RGB
+            job.jpg.resize(3);
+            PixelConvert::to_rgb(origin, (int)stride, job.jpg.data(), 3, 1, 1, canvas_layout_);
+            job.ok = true;
+            return;
+        }
+        if (job.codec == ScreenProtocol::CODEC_QOI) {
+            QoiCodec::encode(origin, job.rect.w, job.rect.h, (int)stride, canvas_layout_, job.jpg);
+            job.ok = true;
+            return;
+        }
+        std::string err;
+        if (job.codec == ScreenProtocol::CODEC_WEBP) {
+            job.ok = WebpEncoder::encode(origin, job.rect.w, job.rect.h, (int)stride, canvas_layout_, job.quality,
+                                         job.effort, job.jpg, err);
+        } else {
+            job.ok = encoder.encode(origin, job.rect.w, job.rect.h, (int)stride, canvas_layout_, job.quality, job.jpg, err);
+        }
+        if (!job.ok) std::cerr << "[SCREEN] Stream encode failed: " << err << "\n";
+    });
+    const double encode_ms = std::chrono::duration<double, std::milli>(Clock::now() - encode_start).count();
+
+    // 3. Đóng gói MSG_TILES cho từng session và chuyển sang sender
+    for (const auto& s : sessions) {
+        if (!s->tiles_due || (s->jobs.empty() && s->copies.empty())) continue;
+        bool ok = std::all_of(s->jobs.begin(), s->jobs.end(), [this](size_t j) { return jobs_[j].ok; });
+        // Nén lỗi thì giữ nguyên dirty để lần sau gửi lại
+        if (!ok) continue;
+
+        // Buffer lấy từ pool đủ lớn ngay từ đầu, sender trả lại pool sau khi ghi socket
+        size_t packet_size = ScreenProtocol::HEADER_SIZE + 6;
+        for (size_t j : s->jobs) packet_size += 13 + jobs_[j].jpg.size();
+        packet_size += s->copies.size() * 17;
+        OutPacket& out = s->staging;
+        out.timestamp_us = canvas_ts_;
+        out.data = FrameBufferPool::shared().acquire(packet_size);
+        std::vector<uint8_t>& packet = out.data.bytes();
+        ScreenProtocol::begin_message(packet, ScreenProtocol::MSG_TILES, s->seq++, canvas_ts_);
+        ScreenProtocol::put_u16(packet, (uint16_t)(canvas_w_ / s->scale));
+        ScreenProtocol::put_u16(packet, (uint16_t)(canvas_h_ / s->scale));
+        ScreenProtocol::put_u16(packet, (uint16_t)(s->copies.size() + s->jobs.size()));
+        // Copy rect trước, theo đúng thứ tự cuộn, rồi mới tới vùng ảnh
+        for (const ScrollCopy& c : s->copies) {
+            ScreenProtocol::put_u16(packet, (uint16_t)c.dst.x);
+            ScreenProtocol::put_u16(packet, (uint16_t)c.dst.y);
+            ScreenProtocol::put_u16(packet, (uint16_t)c.dst.w);
+            ScreenProtocol::put_u16(packet, (uint16_t)c.dst.h);
+            ScreenProtocol::put_u8(packet, ScreenProtocol::CODEC_COPY);
+            ScreenProtocol::put_u32(packet, 4);
+            ScreenProtocol::put_u16(packet, (uint16_t)c.dst.x);
+            ScreenProtocol::put_u16(packet, (uint16_t)(c.dst.y - c.dy));
+        }
+        for (size_t j : s->jobs) {
+            const EncodeJob& job = jobs_[j];
+            ScreenProtocol::put_u16(packet, (uint16_t)job.rect.x);
+            ScreenProtocol::put_u16(packet, (uint16_t)job.rect.y);
+            ScreenProtocol::put_u16(packet, (uint16_t)job.rect.w);
+            ScreenProtocol::put_u16(packet, (uint16_t)job.rect.h);
+            ScreenProtocol::put_u8(packet, job.codec);
+            ScreenProtocol::put_u32(packet, (uint32_t)job.jpg.size());
+            packet.insert(packet.end(), job.jpg.begin(), job.jpg.end());
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(s->stats_mtx);
+            ScreenStreamStats& st = s->stats;
+            st.avg_encode_ms = (st.avg_encode_ms == 0) ? encode_ms : st.avg_encode_ms * 0.9 + encode_ms * 0.1;
+            st.copy_rects += s->copies.size();
+            if (s->refining) st.refine_passes++;
+            for (size_t j : s->jobs) st.regions_shared += (jobs_[j].users > 1);
+        }
+        if (s->refining) {
+            std::fill(s->unrefined.begin(), s->unrefined.end(), 0);
+        } else if (s->opts.refine_ms > 0 && s->unrefined.size() == s->dirty.size()) {
+            // Tile vừa gửi lại thì bản cũ không còn; tile gửi lossy (JPEG / WebP) quality thấp hơn lượt làm nét
+            // -> chờ màn hình đứng yên rồi gửi lại
+            for (size_t t = 0; t < s->dirty.size(); t++) s->unrefined[t] &= (uint8_t)!s->dirty[t];
+            for (size_t j : s->jobs) {
+                const EncodeJob& job = jobs_[j];
+                if (job.codec != ScreenProtocol::CODEC_JPEG && job.codec != ScreenProtocol::CODEC_WEBP) continue;
+                if (s->opts.refine_quality > 0 && job.quality >= s->opts.refine_quality) continue;
+                mark_tiles(s->unrefined, job.rect, s->scale, cols, rows);
+            }
+        }
+
+        // outbox không đầy (đã kiểm tra ở bước 1, chỉ sender lấy ra)
+        s->outbox.try_push(out);
+        s->full = false;
+        std::fill(s->dirty.begin(), s->dirty.end(), 0);
+        s->copies.clear();
+        {
+            // Khoá rồi nhả: sender đang kiểm tra điều kiện chờ sẽ không lỡ notify
+            std::lock_guard<std::mutex> lock(s->send_mtx);
+        }
+        s->send_cv.notify_one();
+    }
+
+    // 4. Session chế độ video: mỗi session 1 encoder H.264 (trạng thái tham chiếu riêng)
+    for (const auto& s : sessions) {
+        if (!s->video_due) continue;
+        s->video_due = false;
+        encode_video(*s);
+    }
+}
+
+void ScreenStreamer::encode_video(Session& s) {
+    const uint8_t* base = canvas_.data();
+    size_t stride = (size_t)canvas_w_ * canvas_bpp_;
+    int w = canvas_w_, h = canvas_h_;
+    if (s.scale > 1) {
+        const ScaledCanvas& sc = scaled_[s.scale == 2 ? 0 : 1];
+        base = sc.pixels.data();
+        stride = (size_t)sc.w * 4;
+        w = sc.w;
+        h = sc.h;
+    }
+    // I420 cần kích thước chẵn: bỏ cột / hàng lẻ cuối cùng
+    w &= ~1;
+    h &= ~1;
+    if (w == 0 || h == 0) return;
+
+    std::string err;
+    bool keyframe = s.full;
+    if (!s.video) s.video = std::make_unique<H264Encoder>();
+    if (!s.video->matches(w, h, s.opts.fps, s.opts.quality, s.opts.bitrate_kbps)) {
+        if (!s.video->open(w, h, s.opts.fps, s.opts.quality, s.opts.bitrate_kbps, pool_.size(), err)) {
+            std::cerr << "[SCREEN] " << err << "\n";
+            return;
+        }
+        keyframe = true;
+    }
+
+    const Clock::time_point encode_start = Clock::now();
+    bool is_keyframe = false;
+    if (!s.video->encode(base, (int)stride, canvas_layout_, keyframe, s.video_out, is_keyframe, err)) {
+        std::cerr << "[SCREEN] Stream encode failed: " << err << "\n";
+        s.video->close();   // Lần sau mở lại -> bắt đầu bằng IDR
+        return;
+    }
+    const double encode_ms = std::chrono::duration<double, std::milli>(Clock::now() - encode_start).count();
+    s.full = false;
+    std::fill(s.dirty.begin(), s.dirty.end(), 0);
+    if (s.video_out.empty()) return;
+
+    OutPacket& out = s.staging;
+    out.timestamp_us = canvas_ts_;
+    out.data = FrameBufferPool::shared().acquire(ScreenProtocol::HEADER_SIZE + 5 + s.video_out.size());
+    std::vector<uint8_t>& packet = out.data.bytes();
+    ScreenProtocol::begin_message(packet, ScreenProtocol::MSG_VIDEO, s.seq++, canvas_ts_,
+                                  is_keyframe ? ScreenProtocol::FLAG_KEYFRAME : 0);
+    ScreenProtocol::put_u16(packet, (uint16_t)w);
+    ScreenProtocol::put_u16(packet, (uint16_t)h);
+    ScreenProtocol::put_u8(packet, ScreenProtocol::CODEC_H264);
+    packet.insert(packet.end(), s.video_out.begin(), s.video_out.end());
+
+    {
+        std::lock_guard<std::mutex> lock(s.stats_mtx);
+        ScreenStreamStats& st = s.stats;
+        st.avg_encode_ms = (st.avg_encode_ms == 0) ? encode_ms : st.avg_encode_ms * 0.9 + encode_ms * 0.1;
+    }
+
+    // outbox không đầy (đã kiểm tra ở bước 1)
+    s.outbox.try_push(out);
+    {
+        std::lock_guard<std::mutex> lock(s.send_mtx);
+    }
+    s.send_cv.notify_one();
+}
+
+// ==========================================================
+// Stage 3: send
+// ==========================================================
+void ScreenStreamer::send_loop(Session* s) {
+    OutPacket packet;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(s->send_mtx);
+            auto ready = [this, s] {
+                return s->closed || !s->outbox.empty() || cursor_version_ != s->cursor_version;
+            };
+            // Bộ điều khiển tốc độ cần độ trễ mới cả khi không có frame (mạng thông lại thì tăng dần lên)
+            bool woke = true;
+            if (s->probe) woke = s->send_cv.wait_for(lock, LINK_PROBE_INTERVAL, ready);
+            else s->send_cv.wait(lock, ready);
+            if (s->closed) return;
+            if (!woke) {
+                lock.unlock();
+                if (s->rate_enabled) update_link(*s, 0, 0, -1);
+                continue;
+            }
+        }
+        // Con trỏ trước: message nhỏ, không để nằm sau 1 frame lớn
+        send_cursor(*s);
+        while (s->outbox.try_pop(packet)) {
+            // Ghi socket (có thể chặn lâu khi mạng chậm) chỉ chặn thread của session này
+            const Clock::time_point write_start = Clock::now();
+            s->callback(packet.data.bytes());
+            const double write_ms = std::chrono::duration<double, std::milli>(Clock::now() - write_start).count();
+
+            const double age_ms = (double)(steady_now_us() - packet.timestamp_us) / 1000.0;
+            const size_t bytes = packet.data.bytes().size();
+            {
+                std::lock_guard<std::mutex> lock(s->stats_mtx);
+                ScreenStreamStats& st = s->stats;
+                st.frames_sent++;
+                st.bytes_sent += bytes;
+                st.last_age_ms = age_ms;
+                st.avg_age_ms = (st.frames_sent == 1) ? age_ms : st.avg_age_ms * 0.9 + age_ms * 0.1;
+                st.max_age_ms = std::max(st.max_age_ms, age_ms);
+            }
+            packet.data.reset();
+            update_link(*s, bytes, write_ms, age_ms);
+        }
+    }
+}
+
+// Đo kết nối sau mỗi lần ghi (age_ms < 0: lần hỏi định kỳ khi rảnh). Độ trễ ước lượng =
+// max(RTT ping, tuổi frame vừa gửi + thời gian xả phần còn trong buffer socket theo tốc độ gửi đo được):
+// ping xếp hàng sau dữ liệu chưa gửi nên RTT đã gồm cả hàng đợi của kernel.
+void ScreenStreamer::update_link(Session& s, size_t bytes, double write_ms, double age_ms) {
+    ScreenLinkState link;
+    if (s.probe) s.probe(link);
+
+    const Clock::time_point now = Clock::now();
+    if (s.rate_window_start == Clock::time_point()) s.rate_window_start = now;
+    s.rate_window_bytes += bytes;
+    const double window_ms = std::chrono::duration<double, std::milli>(now - s.rate_window_start).count();
+
+    std::lock_guard<std::mutex> lock(s.stats_mtx);
+    ScreenStreamStats& st = s.stats;
+    if (window_ms >= 1000) {
+        const double kbps = (double)s.rate_window_bytes * 8.0 / window_ms;
+        st.send_kbps = (st.send_kbps == 0) ? kbps : st.send_kbps * 0.5 + kbps * 0.5;
+        s.rate_window_start = now;
+        s.rate_window_bytes = 0;
+    }
+    if (age_ms >= 0) st.avg_write_ms = (st.avg_write_ms == 0) ? write_ms : st.avg_write_ms * 0.9 + write_ms * 0.1;
+    st.unsent_bytes = link.unsent_bytes;
+    if (link.rtt_ms >= 0) st.rtt_ms = link.rtt_ms;
+
+    double queue_ms = 0;
+    if (link.unsent_bytes > 0 && st.send_kbps > 0) queue_ms = (double)link.unsent_bytes * 8.0 / st.send_kbps;
+    st.delay_ms = std::max(st.rtt_ms, std::max(0.0, age_ms) + queue_ms);
+}
+
+bool ScreenStreamer::send_cursor(Session& s) {
+    if (cursor_version_ == s.cursor_version) return false;
+    FrameBuffer shape;
+    uint64_t ts = 0;
+    {
+        std::lock_guard<std::mutex> lock(cursor_mtx_);
+        s.cursor_version = cursor_version_;
+        if (cursor_shape_ && cursor_shape_id_ != s.cursor_shape_id) {
+            shape = cursor_shape_;   // Thêm tham chiếu, không copy ảnh
+            s.cursor_shape_id = cursor_shape_id_;
+        }
+        ts = cursor_ts_;
+        ScreenProtocol::begin_message(s.cursor_packet, ScreenProtocol::MSG_CURSOR_POS, s.cursor_seq++, ts);
+        ScreenProtocol::put_u16(s.cursor_packet, (uint16_t)std::max(0, cursor_x_));
+        ScreenProtocol::put_u16(s.cursor_packet, (uint16_t)std::max(0, cursor_y_));
+        ScreenProtocol::put_u16(s.cursor_packet, (uint16_t)cursor_screen_w_);
+        ScreenProtocol::put_u16(s.cursor_packet, (uint16_t)cursor_screen_h_);
+    }
+
+    size_t bytes = s.cursor_packet.size();
+    uint64_t count = 1;
+    if (shape) {
+        // Buffer dùng chung: seq trong header của hình con trỏ luôn = 0
+        s.callback(shape.bytes());
+        bytes += shape.bytes().size();
+        count++;
+    }
+    s.callback(s.cursor_packet);
+
+    std::lock_guard<std::mutex> lock(s.stats_mtx);
+    s.stats.cursor_sent += count;
+    s.stats.bytes_sent += bytes;
+    return true;
+}
+
+void ScreenStreamer::close_session(Session& s) {
+    {
+        std::lock_guard<std::mutex> lock(s.send_mtx);
+        s.closed = true;
+    }
+    s.send_cv.notify_all();
+    if (s.sender.joinable()) s.sender.join();
+}
@@ -5,6 +5,7 @@
 #include <algorithm> // std::search
 #include <cstring>   // strerror
 #include <cstdint>   // [FIX] Cần cho uint8_t
+#include "../utils/FrameBufferPool.hpp"
 
 void WebcamManager::stop_stream() {
     running_ = false;
@@ -47,10 +48,12 @@ void WebcamManager::start_stream(StreamCallback callback) {
 
                 if (end_it + 2 > buffer.end()) break; // Safety check
 
-                std::vector<uint8_t> jpg_frame(start_it, end_it + 2);
+                // Buffer lấy từ pool dùng chung, trả lại khi ra khỏi scope -> không cấp phát mỗi frame
+                FrameBuffer jpg_frame = FrameBufferPool::shared().acquire((size_t)(end_it + 2 - start_it));
+                jpg_frame.bytes().assign(start_it, end_it + 2);
                 
                 // Gọi callback trực tiếp (không cần biến thành viên callback_)
-                callback(jpg_frame);
+                callback(jpg_frame.bytes());
 
                 buffer.erase(buffer.begin(), end_it + 2);
             }
@@ -6,6 +6,7 @@
 #include <direct.h> // _mkdir
 #include <chrono>   // Để đo thời gian lưu file
 #include <iostream>
+#include "../utils/FrameBufferPool.hpp"
 
 #pragma comment(lib, "gdiplus.lib")
 #pragma comment(lib, "mf.lib")
@@ -139,7 +140,9 @@ void WebcamManager::start_stream(StreamCallback callback) {
                             STATSTG stg;
                             pStream->Stat(&stg, STATFLAG_NONAME);
                             ULONG sz = stg.cbSize.LowPart;
-                            std::vector<uint8_t> jpgData(sz);
+                            FrameBuffer jpgFrame = FrameBufferPool::shared().acquire(sz);
+                            std::vector<uint8_t>& jpgData = jpgFrame.bytes();
+                            jpgData.resize(sz);
                             LARGE_INTEGER seekPos = {0};
                             pStream->Seek(seekPos, STREAM_SEEK_SET, NULL);
                             ULONG bytesRead;
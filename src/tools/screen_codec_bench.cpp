@@ -0,0 +1,394 @@
+// So sánh codec ảnh màn hình (JPEG vs WebP) trên 1 bộ frame cố định: tổng byte + thời gian nén mỗi frame.
+//
+//   screen_codec_bench record <dir> [count=20] [interval_ms=500]
+//       Chụp count frame màn hình (X11) thành <dir>/frame_NNN.ppm -> bộ frame cố định để so lại về sau
+//   screen_codec_bench synth <dir> [count=6]
+//       Sinh bộ frame tổng hợp 1280x720 (IDE tối, trang web có ảnh, desktop gradient), seed cố định:
+//       máy nào chạy cũng ra cùng bộ frame, dùng khi không có X Server để record
+//   screen_codec_bench <dir> [quality=60] [repeat=3]
+//       Nén mọi file .ppm trong <dir> (theo tên) bằng từng cấu hình, thời gian lấy lần nhanh nhất trong repeat lần
+//   screen_codec_bench encoders <dir> [max_threads=số core] [quality=60] [repeat=3]
+//       Nén cả frame qua đúng đường của stream (TileDiffer::split_stripes + JpegEncoderPool) với 1..max_threads
+//       worker: ms/frame theo số core (RC_SCREEN_ENCODERS)
+//   screen_codec_bench progressive <dir> [quality=60] [repeat=3]
+//       JPEG baseline vs progressive (CAPTURE_BINARY progressive = true): byte, ms/frame, số scan, byte của scan đầu
+//
+// Ảnh được đưa vào encoder dưới dạng BGRX 32 bit (giống bộ nhớ XImage của stream), nên đo đúng đường nén thật.
+#include <dirent.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "modules/ScreenCapture.hpp"
+#include "modules/ScreenEncoder.hpp"
+#include "utils/PixelConvert.hpp"
+#include "utils/TileDiffer.hpp"
+
+namespace {
+
+struct Frame {
+    std::string name;
+    int width = 0, height = 0;
+    std::vector<uint8_t> bgrx;   // stride = width * 4
+};
+
+struct Config {
+    const char* name;
+    bool webp;
+    int method;                  // WebP: WebpEncoder::FAST hoặc 0..6
+};
+
+// PPM nhị phân (P6, maxval 255), không hỗ trợ comment trong header
+bool read_ppm(const std::string& path, Frame& f) {
+    std::ifstream in(path, std::ios::binary);
+    std::string magic;
+    int maxval = 0;
+    if (!(in >> magic >> f.width >> f.height >> maxval) || magic != "P6" || maxval != 255) return false;
+    in.get();
+    std::vector<uint8_t> rgb((size_t)f.width * f.height * 3);
+    if (!in.read((char*)rgb.data(), (std::streamsize)rgb.size())) return false;
+    f.bgrx.resize((size_t)f.width * f.height * 4);
+    for (size_t i = 0, n = (size_t)f.width * f.height; i < n; i++) {
+        f.bgrx[i * 4 + 0] = rgb[i * 3 + 2];
+        f.bgrx[i * 4 + 1] = rgb[i * 3 + 1];
+        f.bgrx[i * 4 + 2] = rgb[i * 3 + 0];
+        f.bgrx[i * 4 + 3] = 0;
+    }
+    return true;
+}
+
+bool write_ppm(const std::string& path, const std::vector<uint8_t>& rgb, int width, int height) {
+    std::ofstream out(path, std::ios::binary);
+    out << "P6\n" << width << " " << height << "\n255\n";
+    out.write((const char*)rgb.data(), (std::streamsize)rgb.size());
+    return (bool)out;
+}
+
+int record(const std::string& dir, int count, int interval_ms) {
+    mkdir(dir.c_str(), 0755);
+    X11CaptureContext ctx;
+    std::vector<uint8_t> rgb;
+    for (int i = 0; i < count; i++) {
+        std::string err;
+        XImage* img = ctx.grab(err);
+        if (!img) {
+            std::cerr << "Capture failed: " << err << "\n";
+            return 1;
+        }
+        rgb.resize((size_t)img->width * img->height * 3);
+        PixelConvert::to_rgb((const uint8_t*)img->data, img->bytes_per_line, rgb.data(), img->width * 3,
+                             img->width, img->height, ctx.pixel_layout());
+        char name[32];
+        std::snprintf(name, sizeof(name), "/frame_%03d.ppm", i);
+        if (!write_ppm(dir + name, rgb, img->width, img->height)) {
+            std::cerr << "Cannot write " << dir << name << "\n";
+            return 1;
+        }
+        std::cout << "Saved " << dir << name << " (" << img->width << "x" << img->height << ")\n";
+        std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
+    }
+    return 0;
+}
+
+// LCG cố định (không dùng std::uniform_*_distribution: kết quả khác nhau giữa các thư viện chuẩn)
+struct Rng {
+    uint32_t state;
+    uint32_t next() { state = state * 1664525u + 1013904223u; return state >> 8; }
+    int range(int n) { return (int)(next() % (uint32_t)n); }
+    bool chance(int percent) { return range(100) < percent; }
+};
+
+int synth(const std::string& dir, int count) {
+    const int W = 1280, H = 720, GLYPHS = 60;
+    mkdir(dir.c_str(), 0755);
+    Rng rng{1};
+    // Glyph 6x10 ngẫu nhiên, đủ giống chữ để encoder gặp cạnh sắc như màn hình thật
+    std::vector<uint16_t> glyphs((size_t)GLYPHS * 10);
+    for (auto& row : glyphs) for (int gx = 0; gx < 6; gx++) if (rng.chance(35)) row |= (uint16_t)(1u << gx);
+
+    std::vector<uint8_t> rgb((size_t)W * H * 3);
+    auto put = [&](int x, int y, int r, int g, int b) {
+        uint8_t* p = &rgb[((size_t)y * W + x) * 3];
+        p[0] = (uint8_t)std::max(0, std::min(255, r));
+        p[1] = (uint8_t)std::max(0, std::min(255, g));
+        p[2] = (uint8_t)std::max(0, std::min(255, b));
+    };
+
+    for (int n = 0; n < count; n++) {
+        const int kind = n % 3;   // 0: IDE nền tối, 1: trang web + ảnh, 2: desktop gradient
+        for (int y = 0; y < H; y++) {
+            for (int x = 0; x < W; x++) {
+                if (kind == 0) {
+                    put(x, y, 30, 30, 36);
+                } else if (kind == 1 && x > 300 && x < 900 && y > 150 && y < 500) {
+                    const int noise = rng.range(25) - 12;
+                    put(x, y, (int)(128 + 100 * std::sin(x / 37.0 + n) * std::cos(y / 23.0)) + noise,
+                        (int)(100 + 80 * std::sin((x + y) / 51.0)) + noise,
+                        (int)(90 + 60 * std::cos(x / 19.0 - y / 31.0)) + noise);
+                } else if (kind == 1) {
+                    put(x, y, 250, 250, 250);
+                } else {
+                    put(x, y, 40 + x * 150 / W, 60 + y * 120 / H, 160 - x * 80 / W);
+                }
+            }
+        }
+        // Các dòng chữ
+        if (kind != 2) {
+            const int col = kind == 0 ? 200 : 20;
+            for (int line = 0; line < H / 14; line++) {
+                const int y0 = line * 14 + 4;
+                if (kind == 1 && y0 > 140 && y0 < 510) continue;
+                int x = 10 + line * 7 % 40;
+                const int length = 20 + rng.range(131);
+                for (int ch = 0; ch < length && x <= W - 10; ch++, x += 7) {
+                    const uint16_t* g = &glyphs[(size_t)rng.range(GLYPHS) * 10];
+                    if (rng.chance(15)) continue;   // Dấu cách
+                    for (int gy = 0; gy < 10 && y0 + gy < H; gy++) {
+                        for (int gx = 0; gx < 6 && x + gx < W; gx++) {
+                            if (g[gy] & (1u << gx)) put(x + gx, y0 + gy, col, col, col);
+                        }
+                    }
+                }
+            }
+        }
+        // Thanh tiêu đề cửa sổ / khối UI
+        for (int b = 0; b < 4; b++) {
+            const int bx = rng.range(W - 300), by = rng.range(H - 200);
+            for (int y = by; y < by + 30; y++) for (int x = bx; x < bx + 300; x++) put(x, y, 60, 110, 200);
+        }
+
+        char name[32];
+        std::snprintf(name, sizeof(name), "/frame_%03d.ppm", n);
+        if (!write_ppm(dir + name, rgb, W, H)) {
+            std::cerr << "Cannot write " << dir << name << "\n";
+            return 1;
+        }
+        std::cout << "Saved " << dir << name << " (" << W << "x" << H << ")\n";
+    }
+    return 0;
+}
+
+// Đọc mọi .ppm trong dir (theo tên). false (đã in lỗi) nếu không có frame nào
+bool load_frames(const std::string& dir, std::vector<Frame>& frames) {
+    std::vector<std::string> names;
+    if (DIR* d = opendir(dir.c_str())) {
+        while (dirent* e = readdir(d)) {
+            std::string n = e->d_name;
+            if (n.size() > 4 && n.compare(n.size() - 4, 4, ".ppm") == 0) names.push_back(n);
+        }
+        closedir(d);
+    }
+    std::sort(names.begin(), names.end());
+
+    for (const std::string& n : names) {
+        Frame f;
+        f.name = n;
+        if (read_ppm(dir + "/" + n, f)) frames.push_back(std::move(f));
+        else std::cerr << "Skip " << n << " (not a binary PPM)\n";
+    }
+    if (frames.empty()) {
+        std::cerr << "No .ppm frames in " << dir << " (record some with: screen_codec_bench record " << dir
+                  << ", or generate: screen_codec_bench synth " << dir << ")\n";
+        return false;
+    }
+    return true;
+}
+
+int bench(const std::string& dir, int quality, int repeat) {
+    std::vector<Frame> frames;
+    if (!load_frames(dir, frames)) return 1;
+
+    const PixelLayout bgrx = PixelLayout::from_masks(0xff0000, 0x00ff00, 0x0000ff, 32, false);
+    std::vector<Config> configs = {{"jpeg", false, 0}};
+    if (WebpEncoder::available()) {
+        configs.insert(configs.end(), {{"webp-fast", true, WebpEncoder::FAST}, {"webp-m0", true, 0},
+                                       {"webp-m2", true, 2}, {"webp-m4", true, 4}, {"webp-m6", true, 6}});
+    } else {
+        std::cout << "(built without libwebp: JPEG only)\n";
+    }
+
+    std::cout << frames.size() << " frames, quality " << quality << ", best of " << repeat << "\n";
+    std::cout << std::left << std::setw(12) << "codec" << std::right << std::setw(14) << "bytes" << std::setw(10)
+              << "vs jpeg" << std::setw(12) << "ms/frame" << "\n";
+
+    JpegEncoder jpeg;
+    std::vector<uint8_t> out;
+    double jpeg_bytes = 0;
+    for (const Config& c : configs) {
+        double bytes = 0, ms = 0;
+        for (const Frame& f : frames) {
+            double best = 1e18;
+            for (int r = 0; r < repeat; r++) {
+                std::string err;
+                const auto start = std::chrono::steady_clock::now();
+                const bool ok = c.webp
+                    ? WebpEncoder::encode(f.bgrx.data(), f.width, f.height, f.width * 4, bgrx, quality, c.method, out, err)
+                    : jpeg.encode(f.bgrx.data(), f.width, f.height, f.width * 4, bgrx, quality, out, err);
+                const double t = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                if (!ok) {
+                    std::cerr << c.name << " failed on " << f.name << ": " << err << "\n";
+                    return 1;
+                }
+                best = std::min(best, t);
+            }
+            bytes += (double)out.size();
+            ms += best;
+        }
+        if (!c.webp) jpeg_bytes = bytes;
+        std::cout << std::left << std::setw(12) << c.name << std::right << std::setw(14) << (uint64_t)bytes
+                  << std::setw(9) << std::fixed << std::setprecision(1) << bytes * 100.0 / jpeg_bytes << "%"
+                  << std::setw(12) << std::setprecision(2) << ms / frames.size() << "\n";
+        std::cout.unsetf(std::ios::fixed);
+    }
+    return 0;
+}
+
+int progressive(const std::string& dir, int quality, int repeat) {
+    std::vector<Frame> frames;
+    if (!load_frames(dir, frames)) return 1;
+
+    const PixelLayout bgrx = PixelLayout::from_masks(0xff0000, 0x00ff00, 0x0000ff, 32, false);
+    JpegEncoder jpeg;
+    std::vector<uint8_t> out;
+    std::vector<size_t> scan_ends;
+    double base_bytes = 0, base_ms = 0, prog_bytes = 0, prog_ms = 0, first_bytes = 0, scans = 0;
+    for (const Frame& f : frames) {
+        double base_best = 1e18, prog_best = 1e18;
+        for (int r = 0; r < repeat; r++) {
+            std::string err;
+            auto start = std::chrono::steady_clock::now();
+            if (!jpeg.encode(f.bgrx.data(), f.width, f.height, f.width * 4, bgrx, quality, out, err)) {
+                std::cerr << "jpeg failed on " << f.name << ": " << err << "\n";
+                return 1;
+            }
+            base_best = std::min(base_best, std::chrono::duration<double, std::milli>(
+                                                std::chrono::steady_clock::now() - start).count());
+            if (r == 0) base_bytes += (double)out.size();
+
+            start = std::chrono::steady_clock::now();
+            if (!jpeg.encode_progressive(f.bgrx.data(), f.width, f.height, f.width * 4, bgrx, quality, out,
+                                         scan_ends, err)) {
+                std::cerr << "progressive failed on " << f.name << ": " << err << "\n";
+                return 1;
+            }
+            prog_best = std::min(prog_best, std::chrono::duration<double, std::milli>(
+                                                std::chrono::steady_clock::now() - start).count());
+        }
+        base_ms += base_best;
+        prog_ms += prog_best;
+        prog_bytes += (double)out.size();
+        first_bytes += scan_ends.empty() ? 0.0 : (double)scan_ends[0];
+        scans += (double)scan_ends.size();
+    }
+
+    const double n = (double)frames.size();
+    std::cout << frames.size() << " frames, quality " << quality << ", best of " << repeat << "\n" << std::fixed;
+    std::cout << std::left << std::setw(13) << "codec" << std::right << std::setw(12) << "bytes/frame" << std::setw(10)
+              << "vs base" << std::setw(12) << "ms/frame" << std::setw(8) << "scans" << std::setw(14)
+              << "scan0 bytes" << std::setw(10) << "scan0 %" << "\n";
+    std::cout << std::left << std::setw(13) << "baseline" << std::right << std::setw(12) << std::setprecision(0)
+              << base_bytes / n << std::setw(9) << std::setprecision(1) << 100.0 << "%" << std::setw(12)
+              << std::setprecision(2) << base_ms / n << "\n";
+    std::cout << std::left << std::setw(13) << "progressive" << std::right << std::setw(12) << std::setprecision(0)
+              << prog_bytes / n << std::setw(9) << std::setprecision(1) << prog_bytes * 100.0 / base_bytes << "%"
+              << std::setw(12) << std::setprecision(2) << prog_ms / n << std::setw(8) << std::setprecision(1)
+              << scans / n << std::setw(14) << std::setprecision(0) << first_bytes / n << std::setw(9)
+              << std::setprecision(1) << first_bytes * 100.0 / prog_bytes << "%\n";
+    std::cout.unsetf(std::ios::fixed);
+    return 0;
+}
+
+// Cả frame đổi (như frame đầu của stream): 1 vùng -> split_stripes -> pool nén song song các dải
+int encoders(const std::string& dir, int max_threads, int quality, int repeat) {
+    std::vector<Frame> frames;
+    if (!load_frames(dir, frames)) return 1;
+
+    const PixelLayout bgrx = PixelLayout::from_masks(0xff0000, 0x00ff00, 0x0000ff, 32, false);
+    std::cout << frames.size() << " frames, quality " << quality << ", best of " << repeat << ", "
+              << std::thread::hardware_concurrency() << " hardware threads\n";
+    std::cout << std::left << std::setw(10) << "workers" << std::right << std::setw(10) << "stripes" << std::setw(14)
+              << "bytes" << std::setw(12) << "ms/frame" << std::setw(10) << "speedup" << "\n";
+
+    double base_ms = 0;
+    for (int workers = 1; workers <= max_threads; workers++) {
+        JpegEncoderPool pool(workers);
+        std::vector<std::vector<uint8_t>> outs;
+        std::vector<TileRect> rects;
+        double bytes = 0, ms = 0;
+        size_t stripes = 0;
+        for (const Frame& f : frames) {
+            rects.assign(1, TileRect{0, 0, f.width, f.height});
+            TileDiffer::split_stripes(rects, pool.size());
+            outs.resize(rects.size());
+            std::atomic<bool> ok{true};
+            double best = 1e18;
+            for (int r = 0; r < repeat; r++) {
+                const auto start = std::chrono::steady_clock::now();
+                pool.run(rects.size(), [&](size_t i, JpegEncoder& encoder) {
+                    const TileRect& rc = rects[i];
+                    const uint8_t* origin = f.bgrx.data() + ((size_t)rc.y * f.width + rc.x) * 4;
+                    std::string err;
+                    if (!encoder.encode(origin, rc.w, rc.h, f.width * 4, bgrx, quality, outs[i], err)) ok = false;
+                });
+                best = std::min(best, std::chrono::duration<double, std::milli>(
+                                          std::chrono::steady_clock::now() - start).count());
+            }
+            if (!ok) {
+                std::cerr << "jpeg failed on " << f.name << "\n";
+                return 1;
+            }
+            for (const auto& o : outs) bytes += (double)o.size();
+            stripes += rects.size();
+            ms += best;
+        }
+        ms /= frames.size();
+        if (workers == 1) base_ms = ms;
+        std::cout << std::left << std::setw(10) << workers << std::right << std::setw(10) << std::fixed
+                  << std::setprecision(1) << (double)stripes / frames.size() << std::setw(14) << (uint64_t)bytes
+                  << std::setw(12) << std::setprecision(2) << ms << std::setw(9) << base_ms / ms << "x\n";
+        std::cout.unsetf(std::ios::fixed);
+    }
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc >= 3 && std::strcmp(argv[1], "record") == 0) {
+        return record(argv[2], argc > 3 ? std::max(1, std::atoi(argv[3])) : 20,
+                      argc > 4 ? std::max(0, std::atoi(argv[4])) : 500);
+    }
+    if (argc >= 3 && std::strcmp(argv[1], "encoders") == 0) {
+        const int cores = (int)std::max(1u, std::thread::hardware_concurrency());
+        return encoders(argv[2], argc > 3 ? std::max(1, std::min(64, std::atoi(argv[3]))) : cores,
+                        argc > 4 ? std::max(0, std::min(100, std::atoi(argv[4]))) : 60,
+                        argc > 5 ? std::max(1, std::atoi(argv[5])) : 3);
+    }
+    if (argc >= 3 && std::strcmp(argv[1], "progressive") == 0) {
+        return progressive(argv[2], argc > 3 ? std::max(0, std::min(100, std::atoi(argv[3]))) : 60,
+                           argc > 4 ? std::max(1, std::atoi(argv[4])) : 3);
+    }
+    if (argc >= 3 && std::strcmp(argv[1], "synth") == 0) {
+        return synth(argv[2], argc > 3 ? std::max(1, std::atoi(argv[3])) : 6);
+    }
+    if (argc >= 2) {
+        return bench(argv[1], argc > 2 ? std::max(0, std::min(100, std::atoi(argv[2]))) : 60,
+                     argc > 3 ? std::max(1, std::atoi(argv[3])) : 3);
+    }
+    std::cerr << "Usage: " << argv[0] << " record <dir> [count] [interval_ms]\n"
+              << "       " << argv[0] << " synth <dir> [count]\n"
+              << "       " << argv[0] << " encoders <dir> [max_threads] [quality] [repeat]\n"
+              << "       " << argv[0] << " progressive <dir> [quality] [repeat]\n"
+              << "       " << argv[0] << " <dir> [quality] [repeat]\n";
+    return 1;
+}
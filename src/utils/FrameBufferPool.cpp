@@ -0,0 +1,97 @@
+#include "FrameBufferPool.hpp"
+
+// ==========================================================
+// FrameBuffer
+// ==========================================================
+FrameBuffer::FrameBuffer(const FrameBuffer& other) : block_(other.block_) {
+    if (block_) block_->refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+FrameBuffer::FrameBuffer(FrameBuffer&& other) noexcept : block_(other.block_) {
+    other.block_ = nullptr;
+}
+
+FrameBuffer& FrameBuffer::operator=(FrameBuffer other) noexcept {
+    swap(*this, other);
+    return *this;
+}
+
+void FrameBuffer::reset() {
+    if (!block_) return;
+    if (block_->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) block_->pool->release(block_);
+    block_ = nullptr;
+}
+
+// ==========================================================
+// FrameBufferPool
+// ==========================================================
+FrameBufferPool::FrameBufferPool() {
+    for (int c = 0; c < CLASSES; c++) free_[c].reserve(MAX_POOLED[c]);
+}
+
+FrameBufferPool::~FrameBufferPool() {
+    for (auto& list : free_) {
+        for (auto* block : list) delete block;
+    }
+}
+
+int FrameBufferPool::class_of(size_t bytes) {
+    return bytes <= SMALL_BYTES ? 0 : bytes <= MEDIUM_BYTES ? 1 : 2;
+}
+
+FrameBufferPool& FrameBufferPool::shared() {
+    static FrameBufferPool* pool = new FrameBufferPool();
+    return *pool;
+}
+
+FrameBuffer FrameBufferPool::acquire(size_t reserve_bytes) {
+    FrameBuffer::Block* block = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stats_.acquired++;
+        stats_.in_use++;
+        auto& list = free_[class_of(reserve_bytes)];
+        if (!list.empty()) {
+            block = list.back();
+            list.pop_back();
+            stats_.reused++;
+            stats_.pooled--;
+            stats_.retained_bytes -= block->data.capacity();
+        } else {
+            stats_.allocated++;
+        }
+    }
+    if (!block) {
+        block = new FrameBuffer::Block();
+        block->pool = this;
+    }
+
+    block->data.clear();
+    block->capacity_at_acquire = block->data.capacity();
+    if (block->data.capacity() < reserve_bytes) block->data.reserve(reserve_bytes);
+    block->refs.store(1, std::memory_order_relaxed);
+    return FrameBuffer(block);
+}
+
+void FrameBufferPool::release(FrameBuffer::Block* block) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    stats_.in_use--;
+    const size_t capacity = block->data.capacity();
+    if (capacity > block->capacity_at_acquire) stats_.grown++;
+    // Xếp theo capacity hiện tại: buffer nhỏ lớn lên thành ảnh cả màn hình thì sang lớp lớn
+    const int cls = class_of(capacity);
+    auto& list = free_[cls];
+    if (capacity <= MAX_POOLED_BYTES && list.size() < MAX_POOLED[cls]) {
+        list.push_back(block);
+        stats_.pooled++;
+        stats_.retained_bytes += capacity;
+        return;
+    }
+    stats_.dropped++;
+    delete block;
+}
+
+FrameBufferStats FrameBufferPool::stats() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return stats_;
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Số liệu của FrameBufferPool. Steady state không cấp phát <=> allocated và grown đứng yên.
+struct FrameBufferStats {
+    uint64_t allocated = 0;   // Buffer mới phải tạo (pool rỗng)
+    uint64_t acquired = 0;    // Tổng số lần lấy buffer
+    uint64_t reused = 0;      // Lấy được buffer có sẵn trong pool
+    uint64_t grown = 0;       // Buffer trả về với capacity lớn hơn lúc lấy ra (vector đã cấp phát lại)
+    uint64_t in_use = 0;      // Đang có người giữ
+    uint64_t pooled = 0;      // Đang nằm chờ trong pool
+    uint64_t retained_bytes = 0;   // Tổng capacity của các buffer đang nằm chờ trong pool
+    uint64_t dropped = 0;     // Buffer trả về bị giải phóng thay vì giữ lại (quá lớn / lớp đã đầy)
+};
+
+class FrameBufferPool;
+
+// Buffer frame đếm tham chiếu (kiểu shared_ptr nhưng không cấp phát control block).
+// Copy handle = thêm 1 tham chiếu; tham chiếu cuối cùng mất đi thì buffer quay về pool,
+// giữ nguyên capacity cho frame sau.
+class FrameBuffer {
+public:
+    FrameBuffer() = default;
+    FrameBuffer(const FrameBuffer& other);
+    FrameBuffer(FrameBuffer&& other) noexcept;
+    FrameBuffer& operator=(FrameBuffer other) noexcept;
+    ~FrameBuffer() { reset(); }
+
+    std::vector<uint8_t>& bytes() { return block_->data; }
+    const std::vector<uint8_t>& bytes() const { return block_->data; }
+
+    explicit operator bool() const { return block_ != nullptr; }
+
+    // Bỏ tham chiếu (trả buffer về pool nếu là tham chiếu cuối)
+    void reset();
+
+    friend void swap(FrameBuffer& a, FrameBuffer& b) noexcept {
+        Block* tmp = a.block_;
+        a.block_ = b.block_;
+        b.block_ = tmp;
+    }
+
+private:
+    friend class FrameBufferPool;
+
+    struct Block {
+        std::atomic<int> refs{0};
+        size_t capacity_at_acquire = 0;
+        std::vector<uint8_t> data;
+        FrameBufferPool* pool = nullptr;
+    };
+
+    explicit FrameBuffer(Block* block) : block_(block) {}
+
+    Block* block_ = nullptr;
+};
+
+// Pool buffer dùng chung giữa stage chụp / nén / gửi (screen stream, CAPTURE_BINARY, webcam).
+// Buffer chia lớp theo capacity: gói nhỏ (con trỏ, vài tile) không giữ chỗ của ảnh cả màn hình và ngược lại.
+// Mỗi lớp giữ tối đa vài buffer; buffer lớn hơn MAX_POOLED_BYTES trả về là giải phóng luôn.
+class FrameBufferPool {
+public:
+    static constexpr size_t SMALL_BYTES = 64 * 1024;
+    static constexpr size_t MEDIUM_BYTES = 1024 * 1024;
+    static constexpr size_t MAX_POOLED_BYTES = 8 * 1024 * 1024;
+
+    FrameBufferPool();
+    ~FrameBufferPool();
+
+    FrameBufferPool(const FrameBufferPool&) = delete;
+    FrameBufferPool& operator=(const FrameBufferPool&) = delete;
+
+    // Buffer rỗng (size = 0), capacity >= reserve_bytes nếu có yêu cầu.
+    // reserve_bytes chọn lớp lấy buffer -> caller nên truyền kích thước dự kiến (VD: cỡ ảnh lần trước)
+    FrameBuffer acquire(size_t reserve_bytes = 0);
+
+    FrameBufferStats stats() const;
+
+    // Pool dùng chung cả process (không bao giờ huỷ, an toàn cho thread còn chạy lúc thoát)
+    static FrameBufferPool& shared();
+
+private:
+    friend class FrameBuffer;
+    void release(FrameBuffer::Block* block);
+
+    // Lớp: 0 = <= SMALL_BYTES, 1 = <= MEDIUM_BYTES, 2 = lớn hơn
+    static constexpr int CLASSES = 3;
+    static constexpr size_t MAX_POOLED[CLASSES] = {32, 16, 4};
+    static int class_of(size_t bytes);
+
+    mutable std::mutex mtx_;
+    std::vector<FrameBuffer::Block*> free_[CLASSES];   // reserve sẵn MAX_POOLED -> push_back không cấp phát
+    FrameBufferStats stats_;
+};
@@ -0,0 +1,213 @@
+#include "FrameHash.hpp"
+#include <cstring>
+#include <vector>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+    #define FRAMEHASH_HAVE_X86 1
+    #include <immintrin.h>
+#endif
+
+namespace {
+constexpr int LANES = 8;
+constexpr size_t STRIPE = 64;   // 8 lane x 8 byte
+constexpr uint32_t PRIME32 = 0x9E3779B1u;
+constexpr uint64_t KEY_STEP = 0x165667B19E3779F9ull;   // Key đổi theo vị trí stripe trong hàng
+
+constexpr uint64_t SECRET[LANES] = {
+    0xbe4ba423396cfeb8ull, 0x1cad21f72c81017cull, 0xdb979083e96dd4deull, 0x1f67b3b7a4a44072ull,
+    0x78e5c0cc4ee679cbull, 0x2172ffcc7dd05a82ull, 0x8e2443f7744608b8ull, 0x4c263a81e69035e0ull,
+};
+constexpr uint64_t ROW_KEY[LANES] = {
+    0xcb00c391bb52283cull, 0xa32e531b8b65d088ull, 0x4ef90da297486471ull, 0xd8acdea946ef1938ull,
+    0x3f349ce33f76faa8ull, 0x1d4f0bc7c7bbdcf9ull, 0x3159b4cd4be0518aull, 0x647378d9c97e9fc8ull,
+};
+
+// Hash các hàng [0, rows) vào acc (8 lane)
+using RowsFn = void (*)(const uint8_t* p, int rows, int stride, size_t row_bytes, uint64_t* acc);
+
+inline uint64_t load64(const uint8_t* p) {
+    uint64_t v;
+    std::memcpy(&v, p, 8);
+    return v;
+}
+
+void rows_scalar(const uint8_t* p, int rows, int stride, size_t row_bytes, uint64_t* acc) {
+    alignas(16) uint8_t tail[STRIPE];
+    for (int y = 0; y < rows; y++) {
+        const uint8_t* row = p + (size_t)y * stride;
+        uint64_t key[LANES];
+        for (int i = 0; i < LANES; i++) key[i] = SECRET[i];
+        for (size_t off = 0; off < row_bytes; off += STRIPE) {
+            const uint8_t* s = row + off;
+            if (off + STRIPE > row_bytes) {
+                // Phần lẻ cuối hàng: đệm 0 cho đủ 1 stripe
+                std::memset(tail, 0, STRIPE);
+                std::memcpy(tail, s, row_bytes - off);
+                s = tail;
+            }
+            for (int i = 0; i < LANES; i++) {
+                const uint64_t d = load64(s + 8 * i);
+                const uint64_t k = d ^ key[i];
+                acc[i ^ 1] += d;
+                acc[i] += (k & 0xffffffffull) * (k >> 32);
+                key[i] += KEY_STEP;
+            }
+        }
+        for (int i = 0; i < LANES; i++) {
+            uint64_t a = acc[i];
+            a ^= a >> 47;
+            a ^= ROW_KEY[i];
+            acc[i] = a * PRIME32;
+        }
+    }
+}
+
+#if defined(FRAMEHASH_HAVE_X86)
+__attribute__((target("sse2")))
+void rows_sse2(const uint8_t* p, int rows, int stride, size_t row_bytes, uint64_t* acc) {
+    alignas(16) uint8_t tail[STRIPE];
+    __m128i a[4];
+    for (int j = 0; j < 4; j++) a[j] = _mm_loadu_si128((const __m128i*)(acc + 2 * j));
+    const __m128i step = _mm_set1_epi64x((long long)KEY_STEP);
+    const __m128i prime = _mm_set1_epi32((int)PRIME32);
+    for (int y = 0; y < rows; y++) {
+        const uint8_t* row = p + (size_t)y * stride;
+        __m128i key[4];
+        for (int j = 0; j < 4; j++) key[j] = _mm_loadu_si128((const __m128i*)(SECRET + 2 * j));
+        for (size_t off = 0; off < row_bytes; off += STRIPE) {
+            const uint8_t* s = row + off;
+            if (off + STRIPE > row_bytes) {
+                std::memset(tail, 0, STRIPE);
+                std::memcpy(tail, s, row_bytes - off);
+                s = tail;
+            }
+            for (int j = 0; j < 4; j++) {
+                const __m128i d = _mm_loadu_si128((const __m128i*)(s + 16 * j));
+                const __m128i k = _mm_xor_si128(d, key[j]);
+                // lo32(k) * hi32(k) mỗi lane 64 bit
+                const __m128i prod = _mm_mul_epu32(k, _mm_srli_epi64(k, 32));
+                a[j] = _mm_add_epi64(a[j], prod);
+                a[j] = _mm_add_epi64(a[j], _mm_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2)));
+                key[j] = _mm_add_epi64(key[j], step);
+            }
+        }
+        for (int j = 0; j < 4; j++) {
+            __m128i v = _mm_xor_si128(a[j], _mm_srli_epi64(a[j], 47));
+            v = _mm_xor_si128(v, _mm_loadu_si128((const __m128i*)(ROW_KEY + 2 * j)));
+            // v * PRIME32 (mod 2^64) = lo * P + (hi * P) << 32
+            const __m128i lo = _mm_mul_epu32(v, prime);
+            const __m128i hi = _mm_mul_epu32(_mm_srli_epi64(v, 32), prime);
+            a[j] = _mm_add_epi64(lo, _mm_slli_epi64(hi, 32));
+        }
+    }
+    for (int j = 0; j < 4; j++) _mm_storeu_si128((__m128i*)(acc + 2 * j), a[j]);
+}
+
+__attribute__((target("avx2")))
+void rows_avx2(const uint8_t* p, int rows, int stride, size_t row_bytes, uint64_t* acc) {
+    alignas(32) uint8_t tail[STRIPE];
+    __m256i a[2];
+    for (int j = 0; j < 2; j++) a[j] = _mm256_loadu_si256((const __m256i*)(acc + 4 * j));
+    const __m256i step = _mm256_set1_epi64x((long long)KEY_STEP);
+    const __m256i prime = _mm256_set1_epi32((int)PRIME32);
+    for (int y = 0; y < rows; y++) {
+        const uint8_t* row = p + (size_t)y * stride;
+        __m256i key[2];
+        for (int j = 0; j < 2; j++) key[j] = _mm256_loadu_si256((const __m256i*)(SECRET + 4 * j));
+        for (size_t off = 0; off < row_bytes; off += STRIPE) {
+            const uint8_t* s = row + off;
+            if (off + STRIPE > row_bytes) {
+                std::memset(tail, 0, STRIPE);
+                std::memcpy(tail, s, row_bytes - off);
+                s = tail;
+            }
+            for (int j = 0; j < 2; j++) {
+                const __m256i d = _mm256_loadu_si256((const __m256i*)(s + 32 * j));
+                const __m256i k = _mm256_xor_si256(d, key[j]);
+                const __m256i prod = _mm256_mul_epu32(k, _mm256_srli_epi64(k, 32));
+                a[j] = _mm256_add_epi64(a[j], prod);
+                a[j] = _mm256_add_epi64(a[j], _mm256_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2)));
+                key[j] = _mm256_add_epi64(key[j], step);
+            }
+        }
+        for (int j = 0; j < 2; j++) {
+            __m256i v = _mm256_xor_si256(a[j], _mm256_srli_epi64(a[j], 47));
+            v = _mm256_xor_si256(v, _mm256_loadu_si256((const __m256i*)(ROW_KEY + 4 * j)));
+            const __m256i lo = _mm256_mul_epu32(v, prime);
+            const __m256i hi = _mm256_mul_epu32(_mm256_srli_epi64(v, 32), prime);
+            a[j] = _mm256_add_epi64(lo, _mm256_slli_epi64(hi, 32));
+        }
+    }
+    for (int j = 0; j < 2; j++) _mm256_storeu_si256((__m256i*)(acc + 4 * j), a[j]);
+}
+#endif
+
+struct RowsKernel {
+    const char* name;
+    RowsFn fn;
+};
+
+uint64_t finish(const uint64_t* acc, int width, int height, int bytes_per_pixel) {
+    uint64_t h = 0x27D4EB2F165667C5ull ^ ((uint64_t)width << 32) ^ ((uint64_t)height << 8) ^ (uint64_t)bytes_per_pixel;
+    for (int i = 0; i < LANES; i++) {
+        h ^= acc[i];
+        h *= 0x9E3779B97F4A7C15ull;
+        h ^= h >> 32;
+    }
+    return h;
+}
+
+uint64_t run(RowsFn fn, const uint8_t* pixels, int width, int height, int stride, int bytes_per_pixel) {
+    uint64_t acc[LANES] = {PRIME32, 0x9E3779B185EBCA87ull, 0xC2B2AE3D27D4EB4Full, 0x165667B19E3779F9ull,
+                           0x85EBCA77C2B2AE63ull, 0x85EBCA77u, 0x27D4EB2F165667C5ull, 0x61C8864Eu};
+    if (width > 0 && height > 0) fn(pixels, height, stride, (size_t)width * bytes_per_pixel, acc);
+    return finish(acc, width, height, bytes_per_pixel);
+}
+
+// Kernel CPU này chạy được, nhanh nhất đứng đầu (độ khớp với scalar do tests/frame_hash_test kiểm)
+std::vector<RowsKernel> supported_kernels() {
+    std::vector<RowsKernel> kernels;
+#if defined(FRAMEHASH_HAVE_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) kernels.push_back({"avx2", rows_avx2});
+    if (__builtin_cpu_supports("sse2")) kernels.push_back({"sse2", rows_sse2});
+#endif
+    kernels.push_back({"scalar", rows_scalar});
+    return kernels;
+}
+
+const RowsKernel& active_kernel() {
+    static const RowsKernel kernel = supported_kernels().front();
+    return kernel;
+}
+} // namespace
+
+uint64_t FrameHash::hash(const uint8_t* pixels, int width, int height, int stride, int bytes_per_pixel) {
+    return run(active_kernel().fn, pixels, width, height, stride, bytes_per_pixel);
+}
+
+uint64_t FrameHash::hash_scalar(const uint8_t* pixels, int width, int height, int stride, int bytes_per_pixel) {
+    return run(rows_scalar, pixels, width, height, stride, bytes_per_pixel);
+}
+
+const char* FrameHash::kernel_name() {
+    return active_kernel().name;
+}
+
+std::vector<const char*> FrameHash::kernels() {
+    std::vector<const char*> names;
+    for (const auto& k : supported_kernels()) names.push_back(k.name);
+    return names;
+}
+
+uint64_t FrameHash::hash_with(const char* kernel, const uint8_t* pixels, int width, int height, int stride,
+                              int bytes_per_pixel, bool& ok) {
+    for (const auto& k : supported_kernels()) {
+        if (std::strcmp(k.name, kernel) == 0) {
+            ok = true;
+            return run(k.fn, pixels, width, height, stride, bytes_per_pixel);
+        }
+    }
+    ok = false;
+    return 0;
+}
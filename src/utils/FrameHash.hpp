@@ -0,0 +1,25 @@
+#pragma once
+// Hash 64 bit của cả ảnh chụp màn hình (kiểu XXH3: 8 lane nhân 32x32 -> 64, trộn sau mỗi hàng).
+// Dùng để biết ảnh có đổi hay không mà không cần giữ frame trước hay nén lại:
+// CAPTURE_BINARY gửi lại JPEG cũ / trả "không đổi" khi hash trùng lần trước.
+// Kernel AVX2 / SSE2 / scalar cho cùng kết quả, chọn 1 lần lúc chạy theo CPU.
+#include <cstdint>
+#include <vector>
+
+namespace FrameHash {
+    // Chỉ đọc width * bytes_per_pixel byte mỗi hàng (bỏ phần đệm của stride)
+    uint64_t hash(const uint8_t* pixels, int width, int height, int stride, int bytes_per_pixel);
+
+    // Bản scalar tham chiếu (tests/frame_hash_test so các kernel SIMD với bản này)
+    uint64_t hash_scalar(const uint8_t* pixels, int width, int height, int stride, int bytes_per_pixel);
+
+    // Tên kernel đang dùng ("avx2", "sse2", "scalar")
+    const char* kernel_name();
+
+    // Các kernel CPU này chạy được, theo thứ tự ưu tiên (cuối cùng luôn là "scalar")
+    std::vector<const char*> kernels();
+
+    // Như hash() nhưng ép dùng kernel tên kernel. ok = false (trả 0) nếu không có kernel đó
+    uint64_t hash_with(const char* kernel, const uint8_t* pixels, int width, int height, int stride,
+                       int bytes_per_pixel, bool& ok);
+}
@@ -0,0 +1,354 @@
+#include "PixelConvert.hpp"
+#include <iostream>
+#include <vector>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+    #define PIXEL_HAVE_X86 1
+    #include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #define PIXEL_HAVE_NEON 1
+    #include <arm_neon.h>
+#endif
+
+// ==========================================================
+// PixelLayout
+// ==========================================================
+static int mask_shift(uint32_t mask) {
+    if (!mask) return 0;
+    int s = 0;
+    while (!(mask & 1u)) { mask >>= 1; s++; }
+    return s;
+}
+
+static int mask_bits(uint32_t mask) {
+    int n = 0;
+    while (mask) { n += mask & 1u; mask >>= 1; }
+    return n;
+}
+
+PixelLayout PixelLayout::from_masks(unsigned long red_mask, unsigned long green_mask, unsigned long blue_mask,
+                                    int bits_per_pixel, bool msb_first) {
+    PixelLayout l;
+    l.bytes_per_pixel = (bits_per_pixel + 7) / 8;
+    l.msb_first = msb_first;
+    l.red_mask = (uint32_t)red_mask;
+    l.green_mask = (uint32_t)green_mask;
+    l.blue_mask = (uint32_t)blue_mask;
+    l.red_shift = mask_shift(l.red_mask);
+    l.green_shift = mask_shift(l.green_mask);
+    l.blue_shift = mask_shift(l.blue_mask);
+    l.red_bits = mask_bits(l.red_mask);
+    l.green_bits = mask_bits(l.green_mask);
+    l.blue_bits = mask_bits(l.blue_mask);
+    return l;
+}
+
+bool PixelLayout::is_byte_aligned_32() const {
+    return bytes_per_pixel == 4 && !msb_first &&
+           red_bits == 8 && green_bits == 8 && blue_bits == 8 &&
+           red_shift % 8 == 0 && green_shift % 8 == 0 && blue_shift % 8 == 0;
+}
+
+// ==========================================================
+// Kernel scalar (tham chiếu, hỗ trợ mọi layout)
+// ==========================================================
+static inline uint32_t load_pixel(const uint8_t* p, int bpp, bool msb) {
+    switch (bpp) {
+        case 4: return msb ? ((uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3])
+                           : ((uint32_t)p[3] << 24 | (uint32_t)p[2] << 16 | (uint32_t)p[1] << 8 | p[0]);
+        case 3: return msb ? ((uint32_t)p[0] << 16 | (uint32_t)p[1] << 8 | p[2])
+                           : ((uint32_t)p[2] << 16 | (uint32_t)p[1] << 8 | p[0]);
+        case 2: return msb ? ((uint32_t)p[0] << 8 | p[1]) : ((uint32_t)p[1] << 8 | p[0]);
+        default: return p[0];
+    }
+}
+
+// Đưa kênh n bit về 8 bit (VD: 5 bit của RGB565 -> 0..255)
+static inline uint8_t channel_to_8bit(uint32_t v, int bits) {
+    if (bits == 8) return (uint8_t)v;
+    if (bits > 8) return (uint8_t)(v >> (bits - 8));
+    if (bits <= 0) return 0;
+    uint32_t max = (1u << bits) - 1;
+    return (uint8_t)((v * 255 + max / 2) / max);
+}
+
+void PixelConvert::to_rgb_scalar(const uint8_t* src, int src_stride, uint8_t* dst, int dst_stride,
+                                 int width, int height, const PixelLayout& l) {
+    for (int y = 0; y < height; y++) {
+        const uint8_t* s = src + (size_t)y * src_stride;
+        uint8_t* d = dst + (size_t)y * dst_stride;
+        for (int x = 0; x < width; x++, s += l.bytes_per_pixel, d += 3) {
+            uint32_t px = load_pixel(s, l.bytes_per_pixel, l.msb_first);
+            d[0] = channel_to_8bit((px & l.red_mask) >> l.red_shift, l.red_bits);
+            d[1] = channel_to_8bit((px & l.green_mask) >> l.green_shift, l.green_bits);
+            d[2] = channel_to_8bit((px & l.blue_mask) >> l.blue_shift, l.blue_bits);
+        }
+    }
+}
+
+// ==========================================================
+// Kernel theo hàng cho layout 32bpp căn byte
+// rb/gb/bb = vị trí byte của R/G/B trong pixel (0..3)
+// ==========================================================
+using RowFn = void (*)(const uint8_t* src, uint8_t* dst, int width, int rb, int gb, int bb);
+
+static void row_scalar(const uint8_t* src, uint8_t* dst, int width, int rb, int gb, int bb) {
+    for (int x = 0; x < width; x++, src += 4, dst += 3) {
+        dst[0] = src[rb];
+        dst[1] = src[gb];
+        dst[2] = src[bb];
+    }
+}
+
+#if defined(PIXEL_HAVE_X86)
+// SSE2: 4 pixel/lần. Không có pshufb nên tách kênh bằng shift + mask rồi
+// nén 2 pixel trong mỗi nửa 64 bit. Mỗi lần ghi dư 2 byte -> cần còn ít nhất 1 pixel phía sau.
+__attribute__((target("sse2")))
+static void row_sse2(const uint8_t* src, uint8_t* dst, int width, int rb, int gb, int bb) {
+    const __m128i ff = _mm_set1_epi32(0xff);
+    const __m128i rs = _mm_cvtsi32_si128(rb * 8);
+    const __m128i gs = _mm_cvtsi32_si128(gb * 8);
+    const __m128i bs = _mm_cvtsi32_si128(bb * 8);
+    const __m128i lo_mask = _mm_set1_epi64x(0x0000000000FFFFFFLL);
+    const __m128i hi_mask = _mm_set1_epi64x(0x0000FFFFFF000000LL);
+
+    int x = 0;
+    for (; x + 5 <= width; x += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + x * 4));
+        __m128i r = _mm_and_si128(_mm_srl_epi32(v, rs), ff);
+        __m128i g = _mm_and_si128(_mm_srl_epi32(v, gs), ff);
+        __m128i b = _mm_and_si128(_mm_srl_epi32(v, bs), ff);
+        __m128i rgb0 = _mm_or_si128(r, _mm_or_si128(_mm_slli_epi32(g, 8), _mm_slli_epi32(b, 16)));
+        // Mỗi nửa 64 bit: [R0 G0 B0 0 R1 G1 B1 0] -> [R0 G0 B0 R1 G1 B1 x x]
+        __m128i packed = _mm_or_si128(_mm_and_si128(rgb0, lo_mask),
+                                      _mm_and_si128(_mm_srli_epi64(rgb0, 8), hi_mask));
+        _mm_storel_epi64((__m128i*)(dst + x * 3), packed);
+        _mm_storel_epi64((__m128i*)(dst + x * 3 + 6), _mm_srli_si128(packed, 8));
+    }
+    row_scalar(src + x * 4, dst + x * 3, width - x, rb, gb, bb);
+}
+
+// AVX2: 8 pixel/lần, 1 lệnh pshufb chọn thẳng byte R/G/B theo layout.
+// Mỗi nửa 128 bit ghi 16 byte (12 byte hợp lệ) -> cần còn ít nhất 2 pixel phía sau.
+__attribute__((target("avx2")))
+static void row_avx2(const uint8_t* src, uint8_t* dst, int width, int rb, int gb, int bb) {
+    alignas(32) int8_t idx[32];
+    for (int lane = 0; lane < 2; lane++) {
+        for (int p = 0; p < 4; p++) {
+            idx[lane * 16 + p * 3 + 0] = (int8_t)(p * 4 + rb);
+            idx[lane * 16 + p * 3 + 1] = (int8_t)(p * 4 + gb);
+            idx[lane * 16 + p * 3 + 2] = (int8_t)(p * 4 + bb);
+        }
+        for (int k = 12; k < 16; k++) idx[lane * 16 + k] = -1;
+    }
+    const __m256i shuf = _mm256_load_si256((const __m256i*)idx);
+
+    int x = 0;
+    for (; x + 10 <= width; x += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(src + x * 4));
+        __m256i packed = _mm256_shuffle_epi8(v, shuf);
+        _mm_storeu_si128((__m128i*)(dst + x * 3), _mm256_castsi256_si128(packed));
+        _mm_storeu_si128((__m128i*)(dst + x * 3 + 12), _mm256_extracti128_si256(packed, 1));
+    }
+    row_sse2(src + x * 4, dst + x * 3, width - x, rb, gb, bb);
+}
+#endif
+
+#if defined(PIXEL_HAVE_NEON)
+// NEON: vld4 tách sẵn 4 byte của 16 pixel thành 4 thanh ghi, vst3 ghi RGB xen kẽ.
+static void row_neon(const uint8_t* src, uint8_t* dst, int width, int rb, int gb, int bb) {
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        uint8x16x4_t px = vld4q_u8(src + x * 4);
+        uint8x16x3_t out;
+        out.val[0] = px.val[rb];
+        out.val[1] = px.val[gb];
+        out.val[2] = px.val[bb];
+        vst3q_u8(dst + x * 3, out);
+    }
+    row_scalar(src + x * 4, dst + x * 3, width - x, rb, gb, bb);
+}
+#endif
+
+// ==========================================================
+// Chọn kernel lúc chạy (độ khớp với bản scalar do tests/pixel_convert_test kiểm)
+// ==========================================================
+struct RowKernel {
+    const char* name;
+    RowFn fn;
+};
+
+// Các kernel CPU này chạy được, kernel nhanh nhất đứng đầu
+static std::vector<RowKernel> supported_kernels() {
+    std::vector<RowKernel> kernels;
+#if defined(PIXEL_HAVE_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) kernels.push_back({"avx2", row_avx2});
+    if (__builtin_cpu_supports("sse2")) kernels.push_back({"sse2", row_sse2});
+#elif defined(PIXEL_HAVE_NEON)
+    kernels.push_back({"neon", row_neon});
+#endif
+    kernels.push_back({"scalar", row_scalar});
+    return kernels;
+}
+
+static RowKernel select_kernel() {
+    const RowKernel k = supported_kernels().front();
+    std::cout << "[PIXEL] Using " << k.name << " conversion kernel\n";
+    return k;
+}
+
+static const RowKernel& active_kernel() {
+    static const RowKernel kernel = select_kernel();
+    return kernel;
+}
+
+const char* PixelConvert::kernel_name() {
+    return active_kernel().name;
+}
+
+std::vector<const char*> PixelConvert::kernels() {
+    std::vector<const char*> names;
+    for (const auto& k : supported_kernels()) names.push_back(k.name);
+    return names;
+}
+
+static void convert_rows(RowFn fn, const uint8_t* src, int src_stride, uint8_t* dst, int dst_stride,
+                         int width, int height, const PixelLayout& layout) {
+    if (!layout.is_byte_aligned_32()) {
+        PixelConvert::to_rgb_scalar(src, src_stride, dst, dst_stride, width, height, layout);
+        return;
+    }
+    const int rb = layout.red_shift / 8, gb = layout.green_shift / 8, bb = layout.blue_shift / 8;
+    for (int y = 0; y < height; y++) {
+        fn(src + (size_t)y * src_stride, dst + (size_t)y * dst_stride, width, rb, gb, bb);
+    }
+}
+
+void PixelConvert::to_rgb(const uint8_t* src, int src_stride, uint8_t* dst, int dst_stride,
+                          int width, int height, const PixelLayout& layout) {
+    convert_rows(active_kernel().fn, src, src_stride, dst, dst_stride, width, height, layout);
+}
+
+bool PixelConvert::to_rgb_with(const char* kernel, const uint8_t* src, int src_stride, uint8_t* dst, int dst_stride,
+                               int width, int height, const PixelLayout& layout) {
+    for (const auto& k : supported_kernels()) {
+        if (std::strcmp(k.name, kernel) == 0) {
+            convert_rows(k.fn, src, src_stride, dst, dst_stride, width, height, layout);
+            return true;
+        }
+    }
+    return false;
+}
+
+// ==========================================================
+// Thu nhỏ ảnh 32bpp (box filter), dùng cho stream theo kích thước khung xem
+// ==========================================================
+static void downscale_row_scalar(const uint8_t* src, int src_stride, uint8_t* dst, int dst_w, int f) {
+    const uint32_t n = (uint32_t)(f * f);
+    for (int x = 0; x < dst_w; x++) {
+        uint32_t sum[4] = {0, 0, 0, 0};
+        for (int dy = 0; dy < f; dy++) {
+            const uint8_t* p = src + (size_t)dy * src_stride + (size_t)x * f * 4;
+            for (int dx = 0; dx < f; dx++, p += 4) {
+                sum[0] += p[0]; sum[1] += p[1]; sum[2] += p[2]; sum[3] += p[3];
+            }
+        }
+        for (int c = 0; c < 4; c++) dst[x * 4 + c] = (uint8_t)((sum[c] + n / 2) / n);
+    }
+}
+
+using DownscaleRow2Fn = void (*)(const uint8_t* src, int src_stride, uint8_t* dst, int dst_w);
+
+static void downscale_row2_scalar(const uint8_t* src, int src_stride, uint8_t* dst, int dst_w) {
+    downscale_row_scalar(src, src_stride, dst, dst_w, 2);
+}
+
+#if defined(PIXEL_HAVE_X86)
+// SSE2, hệ số 2: 8 pixel nguồn x 2 hàng -> 4 pixel đích. Cộng trên 16 bit nên kết quả
+// làm tròn giống hệt bản scalar (không dùng pavgb vì làm tròn 2 lần).
+__attribute__((target("sse2")))
+static void downscale_row2_sse2(const uint8_t* src, int src_stride, uint8_t* dst, int dst_w) {
+    const uint8_t* src1 = src + src_stride;
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i two = _mm_set1_epi16(2);
+
+    int x = 0;
+    for (; x + 4 <= dst_w; x += 4) {
+        __m128i out[2];
+        for (int half = 0; half < 2; half++) {
+            __m128i a = _mm_loadu_si128((const __m128i*)(src + x * 8 + half * 16));
+            __m128i b = _mm_loadu_si128((const __m128i*)(src1 + x * 8 + half * 16));
+            // Cộng 2 hàng: lo = pixel 0,1; hi = pixel 2,3 (mỗi kênh 16 bit)
+            __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+            __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+            // Cộng 2 pixel kề nhau: nửa thấp + nửa cao của mỗi thanh ghi
+            lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+            hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+            __m128i sum = _mm_unpacklo_epi64(lo, hi);
+            out[half] = _mm_srli_epi16(_mm_add_epi16(sum, two), 2);
+        }
+        _mm_storeu_si128((__m128i*)(dst + x * 4), _mm_packus_epi16(out[0], out[1]));
+    }
+    downscale_row_scalar(src + (size_t)x * 8, src_stride, dst + x * 4, dst_w - x, 2);
+}
+#endif
+
+struct DownscaleKernel {
+    const char* name;
+    DownscaleRow2Fn fn;
+};
+
+// Kernel hệ số 2 CPU này chạy được, nhanh nhất đứng đầu (độ khớp do tests/pixel_convert_test kiểm)
+static std::vector<DownscaleKernel> supported_downscale_kernels() {
+    std::vector<DownscaleKernel> kernels;
+#if defined(PIXEL_HAVE_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) kernels.push_back({"sse2", downscale_row2_sse2});
+#endif
+    kernels.push_back({"scalar", downscale_row2_scalar});
+    return kernels;
+}
+
+std::vector<const char*> PixelConvert::downscale_kernels() {
+    std::vector<const char*> names;
+    for (const auto& k : supported_downscale_kernels()) names.push_back(k.name);
+    return names;
+}
+
+void PixelConvert::downscale_scalar(const uint8_t* src, int src_stride, uint8_t* dst, int dst_stride,
+                                    int dst_w, int dst_h, int factor) {
+    for (int y = 0; y < dst_h; y++) {
+        downscale_row_scalar(src + (size_t)y * factor * src_stride, src_stride,
+                             dst + (size_t)y * dst_stride, dst_w, factor);
+    }
+}
+
+static void downscale_rows(DownscaleRow2Fn row2, const uint8_t* src, int src_stride, uint8_t* dst, int dst_stride,
+                           int dst_w, int dst_h, int factor) {
+    if (factor != 2) {
+        PixelConvert::downscale_scalar(src, src_stride, dst, dst_stride, dst_w, dst_h, factor);
+        return;
+    }
+    for (int y = 0; y < dst_h; y++) {
+        row2(src + (size_t)y * 2 * src_stride, src_stride, dst + (size_t)y * dst_stride, dst_w);
+    }
+}
+
+void PixelConvert::downscale(const uint8_t* src, int src_stride, uint8_t* dst, int dst_stride,
+                             int dst_w, int dst_h, int factor) {
+    static const DownscaleRow2Fn row2 = supported_downscale_kernels().front().fn;
+    downscale_rows(row2, src, src_stride, dst, dst_stride, dst_w, dst_h, factor);
+}
+
+bool PixelConvert::downscale_with(const char* kernel, const uint8_t* src, int src_stride, uint8_t* dst, int dst_stride,
+                                  int dst_w, int dst_h, int factor) {
+    for (const auto& k : supported_downscale_kernels()) {
+        if (std::strcmp(k.name, kernel) == 0) {
+            downscale_rows(k.fn, src, src_stride, dst, dst_stride, dst_w, dst_h, factor);
+            return true;
+        }
+    }
+    return false;
+}
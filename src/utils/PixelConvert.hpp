@@ -0,0 +1,57 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// Mô tả cách sắp xếp kênh màu trong 1 pixel của ảnh chụp màn hình.
+// Tính 1 lần từ red_mask/green_mask/blue_mask (mỗi capture context),
+// không tách màu bằng shift cố định trong vòng lặp nữa.
+struct PixelLayout {
+    int bytes_per_pixel = 4;
+    bool msb_first = false;          // Byte order của ảnh (X11: image->byte_order == MSBFirst)
+    uint32_t red_mask = 0, green_mask = 0, blue_mask = 0;
+    int red_shift = 0, green_shift = 0, blue_shift = 0;   // Vị trí bit thấp nhất của mask
+    int red_bits = 0, green_bits = 0, blue_bits = 0;      // Số bit mỗi kênh
+
+    // 32bpp, little-endian, mỗi kênh đúng 8 bit nằm trọn 1 byte -> dùng được kernel SIMD
+    bool is_byte_aligned_32() const;
+
+    static PixelLayout from_masks(unsigned long red_mask, unsigned long green_mask, unsigned long blue_mask,
+                                  int bits_per_pixel, bool msb_first);
+};
+
+namespace PixelConvert {
+    // Chuyển ảnh chụp (BGRX/RGBX/565...) sang RGB 24 bit liền nhau cho encoder.
+    // Kernel (AVX2 / SSE2 / NEON / scalar) được chọn 1 lần lúc chạy theo CPU.
+    void to_rgb(const uint8_t* src, int src_stride, uint8_t* dst, int dst_stride,
+                int width, int height, const PixelLayout& layout);
+
+    // Bản scalar tham chiếu (dùng cho layout lạ và để kiểm tra kernel SIMD)
+    void to_rgb_scalar(const uint8_t* src, int src_stride, uint8_t* dst, int dst_stride,
+                       int width, int height, const PixelLayout& layout);
+
+    // Tên kernel đang dùng ("avx2", "sse2", "neon", "scalar")
+    const char* kernel_name();
+
+    // Các kernel to_rgb() đã biên dịch và CPU này chạy được, theo thứ tự ưu tiên (cuối cùng luôn là "scalar")
+    std::vector<const char*> kernels();
+
+    // Như to_rgb() nhưng ép dùng kernel tên kernel (cho tests/pixel_convert_test). false nếu không có kernel đó
+    bool to_rgb_with(const char* kernel, const uint8_t* src, int src_stride, uint8_t* dst, int dst_stride,
+                     int width, int height, const PixelLayout& layout);
+
+    // Thu nhỏ ảnh 32bpp theo hệ số nguyên factor (box filter: trung bình mỗi khối factor x factor).
+    // src phải có ít nhất dst_w * factor cột và dst_h * factor hàng. factor = 2 dùng kernel SSE2 nếu có.
+    void downscale(const uint8_t* src, int src_stride, uint8_t* dst, int dst_stride,
+                   int dst_w, int dst_h, int factor);
+
+    // Bản scalar tham chiếu của downscale()
+    void downscale_scalar(const uint8_t* src, int src_stride, uint8_t* dst, int dst_stride,
+                          int dst_w, int dst_h, int factor);
+
+    // Các kernel downscale() hệ số 2 CPU này chạy được, theo thứ tự ưu tiên (cuối cùng luôn là "scalar")
+    std::vector<const char*> downscale_kernels();
+
+    // Như downscale() nhưng ép dùng kernel tên kernel cho hệ số 2 (cho tests/pixel_convert_test)
+    bool downscale_with(const char* kernel, const uint8_t* src, int src_stride, uint8_t* dst, int dst_stride,
+                        int dst_w, int dst_h, int factor);
+}
@@ -0,0 +1,107 @@
+#include "QoiCodec.hpp"
+#include <cstring>
+
+namespace {
+constexpr uint8_t QOI_OP_INDEX = 0x00;
+constexpr uint8_t QOI_OP_DIFF = 0x40;
+constexpr uint8_t QOI_OP_LUMA = 0x80;
+constexpr uint8_t QOI_OP_RUN = 0xc0;
+constexpr uint8_t QOI_OP_RGB = 0xfe;
+constexpr int HEADER_SIZE = 14;
+constexpr uint8_t END_MARKER[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+
+// Số pixel chuyển sang RGB mỗi lần (buffer trên stack, dùng kernel SIMD của PixelConvert)
+constexpr int CHUNK = 512;
+
+inline void put_u32_be(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+// Alpha luôn 255 nên gộp luôn 255 * 11 vào hash
+inline int qoi_hash(uint32_t rgb) {
+    return (int)((((rgb >> 16) & 0xff) * 3 + ((rgb >> 8) & 0xff) * 5 + (rgb & 0xff) * 7 + 255 * 11) % 64);
+}
+} // namespace
+
+size_t QoiCodec::max_size(int width, int height) {
+    return HEADER_SIZE + (size_t)width * height * 4 + sizeof(END_MARKER);
+}
+
+void QoiCodec::encode(const uint8_t* pixels, int width, int height, int stride, const PixelLayout& layout,
+                      std::vector<uint8_t>& out) {
+    // Ghi thẳng qua con trỏ vào buffer đủ lớn rồi cắt lại, không push_back từng byte
+    out.resize(max_size(width, height));
+    uint8_t* p = out.data();
+
+    std::memcpy(p, "qoif", 4);
+    put_u32_be(p + 4, (uint32_t)width);
+    put_u32_be(p + 8, (uint32_t)height);
+    p[12] = 3;   // RGB
+    p[13] = 0;   // sRGB
+    p += HEADER_SIZE;
+
+    uint32_t index[64] = {0};   // Pixel RGB 0x00RRGGBB; ô trống = đen alpha 0, không trùng pixel nào
+    bool index_used[64] = {false};
+    uint32_t prev = 0;          // Pixel trước đầu tiên theo chuẩn: (0, 0, 0, 255)
+    int run = 0;
+    uint8_t rgb[CHUNK * 3];
+    const long long total = (long long)width * height;
+    long long n = 0;
+
+    for (int y = 0; y < height; y++) {
+        const uint8_t* row = pixels + (size_t)y * stride;
+        for (int x0 = 0; x0 < width; x0 += CHUNK) {
+            const int count = (width - x0 < CHUNK) ? width - x0 : CHUNK;
+            PixelConvert::to_rgb(row + (size_t)x0 * layout.bytes_per_pixel, stride, rgb, CHUNK * 3, count, 1, layout);
+            const uint8_t* s = rgb;
+            for (int i = 0; i < count; i++, s += 3) {
+                const uint32_t px = ((uint32_t)s[0] << 16) | ((uint32_t)s[1] << 8) | s[2];
+                n++;
+                if (px == prev) {
+                    run++;
+                    if (run == 62 || n == total) {
+                        *p++ = (uint8_t)(QOI_OP_RUN | (run - 1));
+                        run = 0;
+                    }
+                    continue;
+                }
+                if (run > 0) {
+                    *p++ = (uint8_t)(QOI_OP_RUN | (run - 1));
+                    run = 0;
+                }
+
+                const int h = qoi_hash(px);
+                if (index_used[h] && index[h] == px) {
+                    *p++ = (uint8_t)(QOI_OP_INDEX | h);
+                } else {
+                    index[h] = px;
+                    index_used[h] = true;
+                    const int8_t vr = (int8_t)(s[0] - (uint8_t)(prev >> 16));
+                    const int8_t vg = (int8_t)(s[1] - (uint8_t)(prev >> 8));
+                    const int8_t vb = (int8_t)(s[2] - (uint8_t)prev);
+                    const int vg_r = vr - vg;
+                    const int vg_b = vb - vg;
+                    if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2) {
+                        *p++ = (uint8_t)(QOI_OP_DIFF | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2));
+                    } else if (vg_r > -9 && vg_r < 8 && vg > -33 && vg < 32 && vg_b > -9 && vg_b < 8) {
+                        *p++ = (uint8_t)(QOI_OP_LUMA | (vg + 32));
+                        *p++ = (uint8_t)((vg_r + 8) << 4 | (vg_b + 8));
+                    } else {
+                        *p++ = QOI_OP_RGB;
+                        *p++ = s[0];
+                        *p++ = s[1];
+                        *p++ = s[2];
+                    }
+                }
+                prev = px;
+            }
+        }
+    }
+
+    std::memcpy(p, END_MARKER, sizeof(END_MARKER));
+    p += sizeof(END_MARKER);
+    out.resize((size_t)(p - out.data()));
+}
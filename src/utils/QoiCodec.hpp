@@ -0,0 +1,17 @@
+#pragma once
+// Nén lossless kiểu QOI (https://qoiformat.org, đúng định dạng chuẩn, 3 kênh RGB) cho tile màn hình.
+// Chữ trong terminal / IDE giữ nguyên từng pixel, nhanh hơn JPEG quality cao và thường nhỏ hơn
+// với vùng ít màu (nền phẳng -> QOI_OP_RUN, màu lặp lại -> QOI_OP_INDEX).
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "PixelConvert.hpp"
+
+namespace QoiCodec {
+    // Kích thước tối đa của ảnh đã nén (header + 4 byte/pixel + end marker)
+    size_t max_size(int width, int height);
+
+    // Nén ảnh (pixels theo layout, stride = bytes_per_line) ra out (ghi đè, giữ capacity giữa các lần gọi)
+    void encode(const uint8_t* pixels, int width, int height, int stride, const PixelLayout& layout,
+                std::vector<uint8_t>& out);
+}
@@ -0,0 +1,67 @@
+#include "RateController.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+constexpr double MIN_BUDGET = 0.05;
+// Giảm: quá target thì x0.75, quá 2 lần target thì x0.5, mỗi lần cách nhau ít nhất DECREASE_INTERVAL_MS
+// để kịp thấy tác dụng của lần giảm trước (socket xả bớt hàng đợi)
+constexpr double DECREASE = 0.75;
+constexpr double DECREASE_HARD = 0.5;
+constexpr int64_t DECREASE_INTERVAL_MS = 250;
+// Tăng: độ trễ dưới 60% target, sau lần giảm gần nhất ít nhất HOLD_MS, mỗi INCREASE_INTERVAL_MS cộng INCREASE
+constexpr double INCREASE_BELOW = 0.6;
+constexpr double INCREASE = 0.05;
+constexpr int64_t INCREASE_INTERVAL_MS = 200;
+constexpr int64_t HOLD_MS = 1000;
+// budget 1 -> 0.5: hạ quality; 0.5 -> 0.2: hạ FPS; dưới 0.2: thu nhỏ 2x, dưới 0.1: 4x.
+// Đổi hệ số thu nhỏ = gửi lại toàn màn hình nên lúc quay về cần vượt ngưỡng thêm 1 đoạn (trễ)
+constexpr double QUALITY_FLOOR = 0.5;
+constexpr double FPS_FLOOR = 0.2;
+constexpr double SCALE2_BELOW = 0.2, SCALE2_ABOVE = 0.25;
+constexpr double SCALE4_BELOW = 0.1, SCALE4_ABOVE = 0.13;
+
+double ramp(double b, double lo, double hi) { return std::min(1.0, std::max(0.0, (b - lo) / (hi - lo))); }
+} // namespace
+
+void RateController::reset(int target_ms, int fps, int quality) {
+    target_ms_ = std::max(0, target_ms);
+    base_fps_ = fps;
+    base_quality_ = quality;
+    budget_ = 1.0;
+    last_decrease_ms_ = 0;
+    last_increase_ms_ = 0;
+    decision_ = Decision{fps, quality, 1};
+}
+
+bool RateController::update(double delay_ms, int64_t now_ms) {
+    if (!enabled()) return false;
+    const Decision before = decision_;
+    if (delay_ms > target_ms_) {
+        if (now_ms - last_decrease_ms_ < DECREASE_INTERVAL_MS) return false;
+        budget_ = std::max(MIN_BUDGET, budget_ * (delay_ms > 2.0 * target_ms_ ? DECREASE_HARD : DECREASE));
+        last_decrease_ms_ = now_ms;
+    } else if (delay_ms < INCREASE_BELOW * target_ms_ && budget_ < 1.0) {
+        if (now_ms - last_decrease_ms_ < HOLD_MS || now_ms - last_increase_ms_ < INCREASE_INTERVAL_MS) return false;
+        budget_ = std::min(1.0, budget_ + INCREASE);
+        last_increase_ms_ = now_ms;
+    } else {
+        return false;
+    }
+    apply();
+    return decision_.fps != before.fps || decision_.quality != before.quality || decision_.scale != before.scale;
+}
+
+void RateController::apply() {
+    const int min_quality = std::min(base_quality_, MIN_QUALITY);
+    const int min_fps = std::min(base_fps_, MIN_FPS);
+    decision_.quality = min_quality + (int)std::lround((base_quality_ - min_quality) * ramp(budget_, QUALITY_FLOOR, 1.0));
+    decision_.fps = min_fps + (int)std::lround((base_fps_ - min_fps) * ramp(budget_, FPS_FLOOR, QUALITY_FLOOR));
+
+    int scale = decision_.scale;
+    if (budget_ < SCALE4_BELOW) scale = 4;
+    else if (budget_ < SCALE2_BELOW) scale = std::max(scale, 2);
+    if (scale == 4 && budget_ >= SCALE4_ABOVE) scale = 2;
+    if (scale == 2 && budget_ >= SCALE2_ABOVE) scale = 1;
+    decision_.scale = scale;
+}
@@ -0,0 +1,41 @@
+#pragma once
+// Bộ điều khiển tốc độ gửi của 1 session screen stream: giữ độ trễ đo được (RTT ping, byte còn
+// nằm trong socket, tuổi frame) quanh mức target bằng cách hạ / tăng quality JPEG, FPS rồi tới
+// hệ số thu nhỏ, theo thứ tự đó (ít ảnh hưởng trước). Kiểu AIMD: quá target thì giảm nhân,
+// dưới target đủ lâu thì tăng cộng dần, nên không dao động theo từng frame.
+#include <cstdint>
+
+class RateController {
+public:
+    struct Decision {
+        int fps = 0;
+        int quality = 0;
+        int scale = 1;          // Hệ số thu nhỏ tối thiểu (1, 2, 4), session dùng max với hệ số theo khung nhìn
+    };
+
+    // Quality / FPS thấp nhất bộ điều khiển được phép hạ tới
+    static constexpr int MIN_QUALITY = 30;
+    static constexpr int MIN_FPS = 2;
+
+    // target_ms = 0: tắt, decision() luôn là tham số client yêu cầu
+    void reset(int target_ms, int fps, int quality);
+
+    bool enabled() const { return target_ms_ > 0; }
+
+    // delay_ms: độ trễ ước lượng mới nhất, now_ms: đồng hồ đơn điệu. true nếu decision() đổi
+    bool update(double delay_ms, int64_t now_ms);
+
+    const Decision& decision() const { return decision_; }
+    // Mức "ngân sách" hiện tại, 1 = tham số gốc, nhỏ dần khi mạng nghẽn
+    double budget() const { return budget_; }
+
+private:
+    void apply();
+
+    int target_ms_ = 0;
+    int base_fps_ = 0, base_quality_ = 0;
+    double budget_ = 1.0;
+    int64_t last_decrease_ms_ = 0;
+    int64_t last_increase_ms_ = 0;
+    Decision decision_;
+};
@@ -0,0 +1,169 @@
+#include "ScrollDetector.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+constexpr int TILE = TileDiffer::TILE_SIZE;
+// Ít nhất bấy nhiêu tile thay đổi mới dò (gõ phím, nháy con trỏ không đáng dò)
+constexpr int MIN_CHANGED_TILES = 4;
+// Số hàng (có hash duy nhất ở frame trước) phải cùng chỉ về 1 độ dịch
+constexpr int MIN_VOTES = 16;
+// Vùng cuộn phải cao ít nhất 1 tile, và ít nhất 1/4 số hàng trong vùng thực sự đổi
+constexpr int MIN_RUN_ROWS = TILE;
+
+inline uint64_t mix(uint64_t h, uint64_t v) {
+    h ^= v;
+    h *= 0x9E3779B97F4A7C15ull;
+    return h ^ (h >> 29);
+}
+
+uint64_t hash_bytes(const uint8_t* p, size_t len) {
+    uint64_t h = 0xcbf29ce484222325ull ^ len;
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t v;
+        std::memcpy(&v, p + i, 8);
+        h = mix(h, v);
+    }
+    if (i < len) {
+        uint64_t v = 0;
+        std::memcpy(&v, p + i, len - i);
+        h = mix(h, v);
+    }
+    return h;
+}
+} // namespace
+
+void ScrollDetector::hash_tile(const uint8_t* pixels, int stride, int tx, int ty) {
+    const int x0 = tx * TILE;
+    const size_t len = (size_t)(std::min(width_, x0 + TILE) - x0) * bpp_;
+    const int y1 = std::min(height_, (ty + 1) * TILE);
+    for (int y = ty * TILE; y < y1; y++) {
+        cur_[(size_t)y * cols_ + tx] = hash_bytes(pixels + (size_t)y * stride + (size_t)x0 * bpp_, len);
+    }
+}
+
+bool ScrollDetector::update(const uint8_t* pixels, int width, int height, int stride, int bytes_per_pixel,
+                            const std::vector<uint8_t>& changed, bool reset, ScrollCopy& out) {
+    const int cols = (width + TILE - 1) / TILE;
+    const int rows = (height + TILE - 1) / TILE;
+    if (reset || width != width_ || height != height_ || bytes_per_pixel != bpp_
+        || changed.size() != (size_t)cols * rows) {
+        width_ = width;
+        height_ = height;
+        bpp_ = bytes_per_pixel;
+        cols_ = cols;
+        cur_.resize((size_t)height * cols);
+        for (int ty = 0; ty < rows; ty++) {
+            for (int tx = 0; tx < cols; tx++) hash_tile(pixels, stride, tx, ty);
+        }
+        prev_ = cur_;
+        return false;
+    }
+
+    for (int ty = 0; ty < rows; ty++) {
+        for (int tx = 0; tx < cols; tx++) {
+            if (changed[(size_t)ty * cols + tx]) hash_tile(pixels, stride, tx, ty);
+        }
+    }
+    const bool found = detect(changed, out);
+
+    // Frame hiện tại thành frame trước của lần sau (chỉ tile đã tính lại)
+    for (int ty = 0; ty < rows; ty++) {
+        const int y1 = std::min(height_, (ty + 1) * TILE);
+        for (int tx = 0; tx < cols; tx++) {
+            if (!changed[(size_t)ty * cols + tx]) continue;
+            for (int y = ty * TILE; y < y1; y++) prev_[(size_t)y * cols_ + tx] = cur_[(size_t)y * cols_ + tx];
+        }
+    }
+    return found;
+}
+
+bool ScrollDetector::detect(const std::vector<uint8_t>& changed, ScrollCopy& out) {
+    const int rows = (height_ + TILE - 1) / TILE;
+    int c0 = cols_, c1 = -1, r0 = rows, r1 = -1, count = 0;
+    for (int ty = 0; ty < rows; ty++) {
+        for (int tx = 0; tx < cols_; tx++) {
+            if (!changed[(size_t)ty * cols_ + tx]) continue;
+            c0 = std::min(c0, tx);
+            c1 = std::max(c1, tx);
+            r0 = std::min(r0, ty);
+            r1 = std::max(r1, ty);
+            count++;
+        }
+    }
+    if (count < MIN_CHANGED_TILES) return false;
+    // Cột biên thường lẫn phần đứng yên (sidebar, thanh cuộn) -> bỏ đi nếu vùng đủ rộng
+    if (c1 - c0 >= 2) {
+        c0++;
+        c1--;
+    }
+
+    // Hash cả hàng trong dải cột [c0, c1] của frame trước / frame mới
+    const int y0 = r0 * TILE;
+    const int y1 = std::min(height_, (r1 + 1) * TILE);
+    const int n = y1 - y0;
+    if (n < MIN_RUN_ROWS) return false;
+    old_rows_.resize(n);
+    new_rows_.resize(n);
+    for (int i = 0; i < n; i++) {
+        const size_t base = (size_t)(y0 + i) * cols_;
+        uint64_t a = 0, b = 0;
+        for (int tx = c0; tx <= c1; tx++) {
+            a = mix(a, prev_[base + tx]);
+            b = mix(b, cur_[base + tx]);
+        }
+        old_rows_[i] = a;
+        new_rows_[i] = b;
+    }
+
+    // Mỗi hàng đã đổi mà trùng đúng 1 hàng cũ -> bầu cho độ dịch tương ứng
+    // (hàng cũ lặp lại nhiều lần như nền trống thì không bầu)
+    sorted_.resize(n);
+    for (int i = 0; i < n; i++) sorted_[i] = {old_rows_[i], i};
+    std::sort(sorted_.begin(), sorted_.end());
+    votes_.assign((size_t)2 * n + 1, 0);
+    for (int i = 0; i < n; i++) {
+        if (new_rows_[i] == old_rows_[i]) continue;
+        auto lo = std::lower_bound(sorted_.begin(), sorted_.end(), std::make_pair(new_rows_[i], -1));
+        if (lo == sorted_.end() || lo->first != new_rows_[i]) continue;
+        if (lo + 1 != sorted_.end() && (lo + 1)->first == new_rows_[i]) continue;
+        votes_[(size_t)(i - lo->second + n)]++;
+    }
+    int best = 0, best_votes = 0;
+    for (int d = -n + 1; d < n; d++) {
+        if (d != 0 && votes_[(size_t)(d + n)] > best_votes) {
+            best_votes = votes_[(size_t)(d + n)];
+            best = d;
+        }
+    }
+    if (best_votes < MIN_VOTES) return false;
+
+    // Đoạn hàng liền nhau dài nhất khớp với độ dịch best
+    int run_start = 0, run_len = 0, run_moved = 0;
+    for (int i = std::max(0, best); i < n && i - best < n;) {
+        if (new_rows_[i] != old_rows_[i - best]) {
+            i++;
+            continue;
+        }
+        int j = i, moved = 0;
+        while (j < n && j - best < n && new_rows_[j] == old_rows_[j - best]) {
+            if (new_rows_[j] != old_rows_[j]) moved++;
+            j++;
+        }
+        if (j - i > run_len) {
+            run_start = i;
+            run_len = j - i;
+            run_moved = moved;
+        }
+        i = j;
+    }
+    if (run_len < MIN_RUN_ROWS || run_moved * 4 < run_len) return false;
+
+    out.dst.x = c0 * TILE;
+    out.dst.w = std::min(width_, (c1 + 1) * TILE) - out.dst.x;
+    out.dst.y = y0 + run_start;
+    out.dst.h = run_len;
+    out.dy = best;
+    return true;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "TileDiffer.hpp"
+
+// Vùng vừa cuộn dọc: nội dung của (x, y, w, h) ở frame mới = (x, y - dy, w, h) ở frame trước
+struct ScrollCopy {
+    TileRect dst;
+    int dy = 0;
+};
+
+// Phát hiện cuộn dọc (trình duyệt, log viewer...) giữa 2 lần chụp liên tiếp bằng hash từng hàng.
+// Giữ hash của mỗi đoạn hàng dài 1 tile (64 pixel) của frame trước; mỗi lần chụp chỉ tính lại
+// đoạn thuộc tile thay đổi, rồi tìm độ dịch dy mà nhiều hàng mới trùng hàng cũ nhất.
+// Cuộn -> stream gửi 1 lệnh copy rect + phần mới lộ ra thay vì nén lại cả vùng.
+class ScrollDetector {
+public:
+    // Gọi sau TileDiffer::update()/update_regions() với cùng ảnh và bitmap changed của lần đó.
+    // reset = true (frame đầu / đổi độ phân giải): chỉ tính hash, không dò.
+    // true nếu tìm được vùng cuộn (cạnh trái/phải theo biên tile, trên/dưới chính xác tới từng hàng).
+    bool update(const uint8_t* pixels, int width, int height, int stride, int bytes_per_pixel,
+                const std::vector<uint8_t>& changed, bool reset, ScrollCopy& out);
+
+private:
+    void hash_tile(const uint8_t* pixels, int stride, int tx, int ty);
+    bool detect(const std::vector<uint8_t>& changed, ScrollCopy& out);
+
+    int width_ = 0, height_ = 0, bpp_ = 0;
+    int cols_ = 0;
+    std::vector<uint64_t> prev_;    // height_ x cols_ hash đoạn hàng của frame trước
+    std::vector<uint64_t> cur_;     // Của frame hiện tại
+
+    // Bộ nhớ tạm của detect(), giữ lại giữa các lần gọi
+    std::vector<uint64_t> old_rows_, new_rows_;
+    std::vector<std::pair<uint64_t, int>> sorted_;
+    std::vector<int> votes_;
+};
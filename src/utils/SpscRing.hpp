@@ -0,0 +1,52 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Hàng đợi vòng có giới hạn, 1 thread ghi (producer) + 1 thread đọc (consumer), không khoá.
+// Phần tử được swap vào/ra slot thay vì copy: producer nhận lại nội dung cũ của slot,
+// nên các std::vector bên trong được dùng lại giữa các frame thay vì cấp phát mới.
+// Đầy thì try_push() trả về false để producer tự quyết định gộp / bỏ frame, không bao giờ chặn.
+template <typename T>
+class SpscRing {
+public:
+    explicit SpscRing(size_t capacity) : slots_(capacity + 1) {}
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // Chỉ gọi từ producer
+    bool try_push(T& item) {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        const size_t next = (head + 1) % slots_.size();
+        if (next == tail_.load(std::memory_order_acquire)) return false;
+        std::swap(slots_[head], item);
+        head_.store(next, std::memory_order_release);
+        return true;
+    }
+
+    // Chỉ gọi từ consumer
+    bool try_pop(T& item) {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail == head_.load(std::memory_order_acquire)) return false;
+        std::swap(item, slots_[tail]);
+        tail_.store((tail + 1) % slots_.size(), std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+
+    bool full() const {
+        return (head_.load(std::memory_order_acquire) + 1) % slots_.size() == tail_.load(std::memory_order_acquire);
+    }
+
+    size_t capacity() const { return slots_.size() - 1; }
+
+private:
+    std::vector<T> slots_;
+    alignas(64) std::atomic<size_t> head_{0};   // Slot producer ghi tiếp
+    alignas(64) std::atomic<size_t> tail_{0};   // Slot consumer đọc tiếp
+};
@@ -0,0 +1,73 @@
+#include "TileClassifier.hpp"
+#include <cstdlib>
+
+namespace {
+// Tổng chênh lệch 3 kênh với pixel bên trái vượt ngưỡng này -> tính là cạnh sắc
+constexpr int EDGE_THRESHOLD = 96;
+// PALETTE khi có cạnh từ 2% pixel trở lên, hoặc ít hơn 16 màu (UI phẳng, gradient đơn giản)
+constexpr int PALETTE_MIN_EDGE_PERMILLE = 20;
+constexpr int PALETTE_FEW_COLORS = 16;
+// Nhiều màu mà cạnh từ 10% trở lên -> DETAILED
+constexpr int DETAILED_MIN_EDGE_PERMILLE = 100;
+
+constexpr int CHUNK = 256;
+constexpr int HASH_SIZE = 1024;   // > 2 * PALETTE_MAX_COLORS, dò tuyến tính
+
+inline uint32_t hash_rgb(uint32_t px) { return (px * 2654435761u) >> 22; }   // 10 bit
+} // namespace
+
+TileClassifier::Result TileClassifier::classify(const uint8_t* pixels, int width, int height, int stride,
+                                                const PixelLayout& layout) {
+    Result res;
+    if (width <= 0 || height <= 0) return res;
+
+    // Khoá = pixel | 0x01000000, 0 = ô trống
+    uint32_t table[HASH_SIZE] = {0};
+    int colors = 0;
+    bool overflow = false;
+    long long edges = 0;
+    uint8_t rgb[CHUNK * 3];
+
+    for (int y = 0; y < height; y++) {
+        const uint8_t* row = pixels + (size_t)y * stride;
+        for (int x0 = 0; x0 < width; x0 += CHUNK) {
+            const int count = (width - x0 < CHUNK) ? width - x0 : CHUNK;
+            PixelConvert::to_rgb(row + (size_t)x0 * layout.bytes_per_pixel, stride, rgb, CHUNK * 3, count, 1, layout);
+            uint32_t prev_key = 0;
+            for (int i = 0; i < count; i++) {
+                const uint8_t* s = rgb + i * 3;
+                const uint32_t key = 0x01000000u | ((uint32_t)s[0] << 16) | ((uint32_t)s[1] << 8) | s[2];
+                if (i > 0 && key != prev_key) {
+                    const uint8_t* l = s - 3;
+                    if (std::abs(s[0] - l[0]) + std::abs(s[1] - l[1]) + std::abs(s[2] - l[2]) > EDGE_THRESHOLD) edges++;
+                }
+                // Pixel liền nhau trùng màu rất hay gặp (nền UI) -> bỏ qua tra bảng
+                if (!overflow && key != prev_key) {
+                    uint32_t h = hash_rgb(key);
+                    while (table[h] != 0 && table[h] != key) h = (h + 1) & (HASH_SIZE - 1);
+                    if (table[h] == 0) {
+                        table[h] = key;
+                        if (++colors > PALETTE_MAX_COLORS) overflow = true;
+                    }
+                }
+                prev_key = key;
+            }
+        }
+    }
+
+    res.colors = colors;
+    res.edge_permille = (int)(edges * 1000 / ((long long)width * height));
+    if (colors == 1) {
+        res.kind = SOLID;
+        for (uint32_t key : table) {
+            if (key != 0) res.color = key & 0xffffff;
+        }
+    } else if (!overflow && (colors < PALETTE_FEW_COLORS || res.edge_permille >= PALETTE_MIN_EDGE_PERMILLE)) {
+        res.kind = PALETTE;
+    } else if (res.edge_permille >= DETAILED_MIN_EDGE_PERMILLE) {
+        res.kind = DETAILED;
+    } else {
+        res.kind = PHOTO;
+    }
+    return res;
+}
@@ -0,0 +1,29 @@
+#pragma once
+// Phân loại nội dung 1 tile để chọn codec riêng cho từng tile của screen stream:
+// màu đặc -> gửi 3 byte màu, giao diện / chữ (ít màu, nhiều cạnh sắc) -> lossless QOI,
+// ảnh / video -> JPEG, quality cao hơn khi tile nhiều chi tiết.
+// Chỉ đếm số màu (dừng sớm khi vượt ngưỡng) và mật độ cạnh, rẻ hơn nhiều so với nén thử.
+#include <cstdint>
+#include "PixelConvert.hpp"
+
+namespace TileClassifier {
+    enum Kind : uint8_t {
+        SOLID = 0,      // Đúng 1 màu
+        PALETTE = 1,    // Ít màu + có cạnh sắc (chữ, icon, UI) hoặc rất ít màu
+        DETAILED = 2,   // Nhiều màu, nhiều cạnh (chữ trên nền ảnh, ảnh nhiều chi tiết)
+        PHOTO = 3,      // Nhiều màu, chuyển màu mượt (ảnh, video, gradient)
+    };
+
+    // Số màu tối đa để coi là PALETTE, quá ngưỡng thì ngừng đếm
+    constexpr int PALETTE_MAX_COLORS = 256;
+
+    struct Result {
+        Kind kind = PHOTO;
+        uint32_t color = 0;     // SOLID: màu 0x00RRGGBB
+        int colors = 0;         // Số màu đếm được (PALETTE_MAX_COLORS + 1 = nhiều hơn ngưỡng)
+        int edge_permille = 0;  // Số pixel khác hẳn pixel bên trái, trên 1000 pixel
+    };
+
+    // pixels theo layout (stride = bytes_per_line), tile nên <= 64x64 (mỗi hàng chuyển RGB trên stack)
+    Result classify(const uint8_t* pixels, int width, int height, int stride, const PixelLayout& layout);
+}
@@ -0,0 +1,137 @@
+#include "TileDiffer.hpp"
+#include <algorithm>
+#include <cstring>
+
+const std::vector<uint8_t>& TileDiffer::update(const uint8_t* pixels, int width, int height, int stride,
+                                               int bytes_per_pixel) {
+    const size_t row_bytes = (size_t)width * bytes_per_pixel;
+
+    reset_ = (width != width_ || height != height_ || bytes_per_pixel != bpp_ || prev_.empty());
+    if (reset_) {
+        width_ = width;
+        height_ = height;
+        bpp_ = bytes_per_pixel;
+        cols_ = (width + TILE_SIZE - 1) / TILE_SIZE;
+        rows_ = (height + TILE_SIZE - 1) / TILE_SIZE;
+        prev_.resize(row_bytes * height);
+        for (int y = 0; y < height; y++) {
+            std::memcpy(prev_.data() + y * row_bytes, pixels + (size_t)y * stride, row_bytes);
+        }
+        changed_.assign((size_t)cols_ * rows_, 1);
+        return changed_;
+    }
+
+    changed_.assign((size_t)cols_ * rows_, 0);
+    for (int ty = 0; ty < rows_; ty++) {
+        for (int tx = 0; tx < cols_; tx++) compare_tile(pixels, stride, tx, ty);
+    }
+    return changed_;
+}
+
+const std::vector<uint8_t>& TileDiffer::update_regions(const uint8_t* pixels, int width, int height, int stride,
+                                                       int bytes_per_pixel, const std::vector<TileRect>& regions) {
+    if (width != width_ || height != height_ || bytes_per_pixel != bpp_ || prev_.empty()) {
+        return update(pixels, width, height, stride, bytes_per_pixel);
+    }
+    reset_ = false;
+
+    // Damage có thể báo thừa (vẽ lại cùng nội dung) -> vẫn so pixel, nhưng chỉ ở tile bị chạm tới
+    changed_.assign((size_t)cols_ * rows_, 0);
+    visited_.assign((size_t)cols_ * rows_, 0);
+    for (const TileRect& r : regions) {
+        const int tx0 = std::max(0, r.x / TILE_SIZE);
+        const int ty0 = std::max(0, r.y / TILE_SIZE);
+        const int tx1 = std::min(cols_, (r.x + r.w + TILE_SIZE - 1) / TILE_SIZE);
+        const int ty1 = std::min(rows_, (r.y + r.h + TILE_SIZE - 1) / TILE_SIZE);
+        for (int ty = ty0; ty < ty1; ty++) {
+            for (int tx = tx0; tx < tx1; tx++) {
+                uint8_t& seen = visited_[(size_t)ty * cols_ + tx];
+                if (seen) continue;
+                seen = 1;
+                compare_tile(pixels, stride, tx, ty);
+            }
+        }
+    }
+    return changed_;
+}
+
+void TileDiffer::compare_tile(const uint8_t* pixels, int stride, int tx, int ty) {
+    const size_t row_bytes = (size_t)width_ * bpp_;
+    const int y0 = ty * TILE_SIZE;
+    const int y1 = std::min(height_, y0 + TILE_SIZE);
+    const int x0 = tx * TILE_SIZE;
+    const size_t off = (size_t)x0 * bpp_;
+    const size_t len = (size_t)(std::min(width_, x0 + TILE_SIZE) - x0) * bpp_;
+
+    // So từng hàng của tile, dừng ngay ở hàng khác đầu tiên
+    int y = y0;
+    for (; y < y1; y++) {
+        if (std::memcmp(pixels + (size_t)y * stride + off, prev_.data() + y * row_bytes + off, len) != 0) break;
+    }
+    if (y == y1) return;
+
+    changed_[(size_t)ty * cols_ + tx] = 1;
+    // Chỉ cập nhật frame tham chiếu ở tile thay đổi (các hàng trước y vốn đã giống)
+    for (; y < y1; y++) {
+        std::memcpy(prev_.data() + y * row_bytes + off, pixels + (size_t)y * stride + off, len);
+    }
+}
+
+void TileDiffer::to_rects(const std::vector<uint8_t>& dirty, int cols, int rows, int width, int height,
+                          std::vector<TileRect>& out) {
+    out.clear();
+    // Dải ngang đang mở từ hàng tile trước: [tx0, tx1) -> index trong out
+    struct Run { int tx0, tx1; size_t rect; };
+    std::vector<Run> open_runs, next_runs;
+
+    for (int ty = 0; ty < rows; ty++) {
+        next_runs.clear();
+        const int y0 = ty * TILE_SIZE;
+        const int h = std::min(height, y0 + TILE_SIZE) - y0;
+
+        int tx = 0;
+        while (tx < cols) {
+            if (!dirty[(size_t)ty * cols + tx]) { tx++; continue; }
+            int tx0 = tx;
+            while (tx < cols && dirty[(size_t)ty * cols + tx]) tx++;
+            int tx1 = tx;
+
+            // Dải trùng khoảng x với dải ngay phía trên -> kéo dài hình chữ nhật xuống
+            auto it = std::find_if(open_runs.begin(), open_runs.end(),
+                                   [&](const Run& r) { return r.tx0 == tx0 && r.tx1 == tx1; });
+            if (it != open_runs.end()) {
+                out[it->rect].h += h;
+                next_runs.push_back({tx0, tx1, it->rect});
+            } else {
+                TileRect r;
+                r.x = tx0 * TILE_SIZE;
+                r.y = y0;
+                r.w = std::min(width, tx1 * TILE_SIZE) - r.x;
+                r.h = h;
+                out.push_back(r);
+                next_runs.push_back({tx0, tx1, out.size() - 1});
+            }
+        }
+        open_runs.swap(next_runs);
+    }
+}
+
+void TileDiffer::split_stripes(std::vector<TileRect>& rects, int workers) {
+    if (workers <= 1 || (int)rects.size() >= workers) return;
+    const size_t n = rects.size();
+    for (size_t i = 0; i < n; i++) {
+        TileRect r = rects[i];
+        if ((long long)r.w * r.h < STRIPE_MIN_PIXELS) continue;
+        int stripe_h = (r.h + workers - 1) / workers;
+        stripe_h = std::max(TILE_SIZE, (stripe_h + TILE_SIZE - 1) / TILE_SIZE * TILE_SIZE);
+        if (stripe_h >= r.h) continue;
+
+        rects[i].h = stripe_h;
+        for (int y = r.y + stripe_h; y < r.y + r.h; y += stripe_h) {
+            TileRect stripe = r;
+            stripe.y = y;
+            stripe.h = std::min(stripe_h, r.y + r.h - y);
+            rects.push_back(stripe);
+        }
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// Vùng chữ nhật trên màn hình (pixel)
+struct TileRect {
+    int x = 0, y = 0, w = 0, h = 0;
+};
+
+// So sánh frame mới với frame trước theo từng ô (tile) cố định,
+// để stream chỉ nén + gửi những vùng thực sự thay đổi.
+class TileDiffer {
+public:
+    static constexpr int TILE_SIZE = 64;   // Bội số của MCU JPEG (16x16)
+
+    // So sánh và cập nhật frame tham chiếu. Trả về bitmap 1 byte/tile (1 = thay đổi).
+    // Lần đầu hoặc khi đổi kích thước: mọi tile đều được đánh dấu và was_reset() trả về true.
+    const std::vector<uint8_t>& update(const uint8_t* pixels, int width, int height, int stride, int bytes_per_pixel);
+
+    // Như update() nhưng chỉ so các tile giao với regions (VD: vùng XDamage báo),
+    // tile ngoài regions coi như không đổi. regions rỗng -> không so gì cả.
+    const std::vector<uint8_t>& update_regions(const uint8_t* pixels, int width, int height, int stride,
+                                               int bytes_per_pixel, const std::vector<TileRect>& regions);
+
+    // true nếu lần update() gần nhất phải khởi tạo lại (frame đầu / đổi độ phân giải)
+    bool was_reset() const { return reset_; }
+
+    int cols() const { return cols_; }
+    int rows() const { return rows_; }
+    int width() const { return width_; }
+    int height() const { return height_; }
+
+    // Gộp các tile bẩn thành ít hình chữ nhật nhất có thể: gộp ngang thành dải,
+    // rồi gộp dọc các dải có cùng khoảng x. Giảm overhead header JPEG mỗi vùng.
+    static void to_rects(const std::vector<uint8_t>& dirty, int cols, int rows, int width, int height,
+                         std::vector<TileRect>& out);
+
+    // Vùng nhỏ hơn mức này nén 1 lần đã đủ nhanh, chia dải chỉ thêm header JPEG
+    static constexpr long long STRIPE_MIN_PIXELS = 256 * 256;
+
+    // Ít vùng hơn số encoder (VD: frame đầu = 1 vùng cả màn hình) -> cắt vùng lớn thành các dải ngang
+    // để mọi core cùng nén. Biên dải nằm trên biên tile (64 = bội số MCU 16), client ghép như tile thường.
+    static void split_stripes(std::vector<TileRect>& rects, int workers);
+
+private:
+    // So 1 tile với frame tham chiếu, khác thì đánh dấu và cập nhật tham chiếu
+    void compare_tile(const uint8_t* pixels, int stride, int tx, int ty);
+
+    std::vector<uint8_t> prev_;     // Frame tham chiếu (copy, stride = width * bpp)
+    std::vector<uint8_t> changed_;
+    std::vector<uint8_t> visited_;  // Tile đã so trong update_regions()
+    int width_ = 0, height_ = 0, bpp_ = 0;
+    int cols_ = 0, rows_ = 0;
+    bool reset_ = false;
+};
@@ -0,0 +1,76 @@
+// So từng kernel FrameHash (AVX2 / SSE2) với hash_scalar: mọi độ dài phần lẻ cuối hàng 0..63 byte
+// (qua nhiều stripe 64 byte), bpp 1/3/4, nhiều hàng, stride có đệm. Thêm 2 tính chất hash() dựa vào:
+// đệm cuối hàng không ảnh hưởng kết quả, đổi 1 byte pixel thì hash đổi. Chạy qua ctest.
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include "utils/FrameHash.hpp"
+
+namespace {
+
+std::vector<uint8_t> random_bytes(size_t n, uint32_t seed) {
+    std::vector<uint8_t> v(n);
+    for (auto& b : v) { seed = seed * 1664525u + 1013904223u; b = (uint8_t)(seed >> 24); }
+    return v;
+}
+
+// Trả về số trường hợp sai
+int check_kernel(const char* kernel) {
+    const int max_row_bytes = 64 * 3 + 63, rows = 3;
+    int failures = 0;
+    for (int bpp : {1, 3, 4}) {
+        for (int w = 0; w * bpp <= max_row_bytes; w++) {
+            const int stride = w * bpp + 7;
+            const std::vector<uint8_t> src = random_bytes((size_t)stride * rows, 0x9e3779b9u + (uint32_t)w);
+            bool ok = false;
+            const uint64_t got = FrameHash::hash_with(kernel, src.data(), w, rows, stride, bpp, ok);
+            if (!ok) {
+                std::printf("[FAIL] %s: kernel không có\n", kernel);
+                return 1;
+            }
+            if (got != FrameHash::hash_scalar(src.data(), w, rows, stride, bpp)) {
+                std::printf("[FAIL] %s, bpp %d, width %d (tail %d byte)\n", kernel, bpp, w, (w * bpp) % 64);
+                failures++;
+            }
+        }
+    }
+    return failures;
+}
+
+int check_properties() {
+    const int w = 37, h = 5, bpp = 4, stride = w * bpp + 20;
+    std::vector<uint8_t> a = random_bytes((size_t)stride * h, 1u), b = a;
+    int failures = 0;
+
+    for (int y = 0; y < h; y++) b[(size_t)y * stride + w * bpp] ^= 0xFF;   // Chỉ sửa phần đệm
+    if (FrameHash::hash(a.data(), w, h, stride, bpp) != FrameHash::hash(b.data(), w, h, stride, bpp)) {
+        std::printf("[FAIL] stride padding changes hash\n");
+        failures++;
+    }
+
+    b = a;
+    b[(size_t)2 * stride + 17] ^= 0x01;
+    if (FrameHash::hash(a.data(), w, h, stride, bpp) == FrameHash::hash(b.data(), w, h, stride, bpp)) {
+        std::printf("[FAIL] 1-bit pixel change keeps hash\n");
+        failures++;
+    }
+    return failures;
+}
+
+} // namespace
+
+int main() {
+    int failures = 0;
+    for (const char* kernel : FrameHash::kernels()) {
+        failures += check_kernel(kernel);
+        std::printf("hash %-6s checked\n", kernel);
+    }
+    failures += check_properties();
+
+    if (failures) {
+        std::printf("%d case(s) failed\n", failures);
+        return 1;
+    }
+    std::printf("OK\n");
+    return 0;
+}
@@ -0,0 +1,97 @@
+// So từng kernel PixelConvert đã biên dịch (AVX2 / SSE2 / NEON) với bản scalar tham chiếu:
+// to_rgb: mọi độ rộng 0..67 (đủ phần đuôi của mỗi kernel), nhiều layout, stride có đệm.
+// downscale: mọi độ rộng đích 0..35, hệ số 1..4 (hệ số khác 2 phải rơi về scalar).
+// Đệm cuối hàng và vùng sau ảnh phải giữ nguyên (kernel không được ghi lố). Chạy qua ctest.
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include "utils/PixelConvert.hpp"
+
+namespace {
+
+struct LayoutCase {
+    const char* name;
+    PixelLayout layout;
+};
+
+std::vector<uint8_t> random_bytes(size_t n, uint32_t seed) {
+    std::vector<uint8_t> v(n);
+    for (auto& b : v) { seed = seed * 1664525u + 1013904223u; b = (uint8_t)(seed >> 24); }
+    return v;
+}
+
+// Trả về số trường hợp sai
+int check_to_rgb(const char* kernel, const LayoutCase& lc) {
+    const int max_width = 67, height = 3, guard = 32;
+    int failures = 0;
+    for (int w = 0; w <= max_width; w++) {
+        const int src_stride = w * lc.layout.bytes_per_pixel + 12;
+        const int dst_stride = w * 3 + 5;
+        const std::vector<uint8_t> src = random_bytes((size_t)src_stride * height, 0x12345678u + (uint32_t)w);
+        std::vector<uint8_t> expect((size_t)dst_stride * height + guard, 0xA5), got(expect);
+
+        PixelConvert::to_rgb_scalar(src.data(), src_stride, expect.data(), dst_stride, w, height, lc.layout);
+        if (!PixelConvert::to_rgb_with(kernel, src.data(), src_stride, got.data(), dst_stride, w, height, lc.layout)) {
+            std::printf("[FAIL] to_rgb %s: kernel không có\n", kernel);
+            return 1;
+        }
+        if (expect != got) {
+            std::printf("[FAIL] to_rgb %s, layout %s, width %d\n", kernel, lc.name, w);
+            failures++;
+        }
+    }
+    return failures;
+}
+
+int check_downscale(const char* kernel, int factor) {
+    const int max_dst_w = 35, dst_h = 3, guard = 32;
+    int failures = 0;
+    for (int w = 0; w <= max_dst_w; w++) {
+        const int src_stride = w * factor * 4 + 12;
+        const int dst_stride = w * 4 + 8;
+        const std::vector<uint8_t> src = random_bytes((size_t)src_stride * dst_h * factor, 0x9e3779b9u + (uint32_t)w);
+        std::vector<uint8_t> expect((size_t)dst_stride * dst_h + guard, 0xA5), got(expect);
+
+        PixelConvert::downscale_scalar(src.data(), src_stride, expect.data(), dst_stride, w, dst_h, factor);
+        if (!PixelConvert::downscale_with(kernel, src.data(), src_stride, got.data(), dst_stride, w, dst_h, factor)) {
+            std::printf("[FAIL] downscale %s: kernel không có\n", kernel);
+            return 1;
+        }
+        if (expect != got) {
+            std::printf("[FAIL] downscale %s, factor %d, width %d\n", kernel, factor, w);
+            failures++;
+        }
+    }
+    return failures;
+}
+
+} // namespace
+
+int main() {
+    const LayoutCase layouts[] = {
+        {"BGRX", PixelLayout::from_masks(0x00ff0000, 0x0000ff00, 0x000000ff, 32, false)},
+        {"RGBX", PixelLayout::from_masks(0x000000ff, 0x0000ff00, 0x00ff0000, 32, false)},
+        {"XBGR", PixelLayout::from_masks(0xff000000, 0x00ff0000, 0x0000ff00, 32, false)},
+        // Layout không căn byte -> mọi kernel phải rơi về scalar
+        {"BGRX-MSB", PixelLayout::from_masks(0x00ff0000, 0x0000ff00, 0x000000ff, 32, true)},
+        {"RGB565", PixelLayout::from_masks(0xf800, 0x07e0, 0x001f, 16, false)},
+        {"BGR24", PixelLayout::from_masks(0xff0000, 0x00ff00, 0x0000ff, 24, false)},
+    };
+
+    int failures = 0;
+    for (const char* kernel : PixelConvert::kernels()) {
+        for (const auto& lc : layouts) failures += check_to_rgb(kernel, lc);
+        std::printf("to_rgb %-6s checked\n", kernel);
+    }
+    for (const char* kernel : PixelConvert::downscale_kernels()) {
+        for (int factor = 1; factor <= 4; factor++) failures += check_downscale(kernel, factor);
+        std::printf("downscale %-6s checked\n", kernel);
+    }
+
+    if (failures) {
+        std::printf("%d case(s) failed\n", failures);
+        return 1;
+    }
+    std::printf("OK\n");
+    return 0;
+}
@@ -0,0 +1,247 @@
+// QoiCodec::encode -> bộ giải mã tham chiếu (chép đúng logic web-client/src/app/services/screen-qoi.ts)
+// phải ra lại từng pixel. Thêm các ca biên của định dạng: run 62 / 63 pixel, run kết thúc ở pixel cuối,
+// QOI_OP_INDEX, biên DIFF (-2..1) và LUMA (vg -32..31, vr/vb - vg -8..7), độ rộng không chia hết CHUNK (512),
+// stride lớn hơn width * 4. Chạy qua ctest.
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "utils/QoiCodec.hpp"
+
+namespace {
+
+struct Rgb {
+    uint8_t r, g, b;
+};
+
+enum Op { OP_INDEX, OP_DIFF, OP_LUMA, OP_RUN, OP_RGB, OP_RGBA };
+
+// Giải mã như decodeQoi() của client. ops nhận loại từng op theo thứ tự. false nếu dữ liệu hỏng.
+bool decode_reference(const std::vector<uint8_t>& data, int w, int h, std::vector<Rgb>& out, std::vector<Op>& ops) {
+    const size_t header = 14, end_size = 8;
+    if (data.size() < header + end_size || std::memcmp(data.data(), "qoif", 4) != 0) return false;
+    auto u32 = [&](size_t at) {
+        return (uint32_t)data[at] << 24 | (uint32_t)data[at + 1] << 16 | (uint32_t)data[at + 2] << 8 | data[at + 3];
+    };
+    if (u32(4) != (uint32_t)w || u32(8) != (uint32_t)h || w == 0 || h == 0) return false;
+    static const uint8_t end_marker[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+    if (std::memcmp(data.data() + data.size() - end_size, end_marker, end_size) != 0) return false;
+
+    out.assign((size_t)w * h, Rgb{0, 0, 0});
+    ops.clear();
+    uint32_t index[64] = {0};
+    int r = 0, g = 0, b = 0, a = 255;
+    int run = 0;
+    size_t p = header;
+    const size_t end = data.size() - end_size;
+    for (Rgb& px : out) {
+        if (run > 0) {
+            run--;
+        } else if (p < end) {
+            const uint8_t b1 = data[p++];
+            if (b1 == 0xfe) {
+                r = data[p]; g = data[p + 1]; b = data[p + 2];
+                p += 3;
+                ops.push_back(OP_RGB);
+            } else if (b1 == 0xff) {
+                r = data[p]; g = data[p + 1]; b = data[p + 2]; a = data[p + 3];
+                p += 4;
+                ops.push_back(OP_RGBA);
+            } else if ((b1 & 0xc0) == 0x00) {
+                const uint32_t v = index[b1];
+                r = v >> 24; g = (v >> 16) & 0xff; b = (v >> 8) & 0xff; a = v & 0xff;
+                ops.push_back(OP_INDEX);
+            } else if ((b1 & 0xc0) == 0x40) {
+                r = (r + ((b1 >> 4) & 0x03) - 2) & 0xff;
+                g = (g + ((b1 >> 2) & 0x03) - 2) & 0xff;
+                b = (b + (b1 & 0x03) - 2) & 0xff;
+                ops.push_back(OP_DIFF);
+            } else if ((b1 & 0xc0) == 0x80) {
+                const uint8_t b2 = data[p++];
+                const int vg = (b1 & 0x3f) - 32;
+                r = (r + vg - 8 + ((b2 >> 4) & 0x0f)) & 0xff;
+                g = (g + vg) & 0xff;
+                b = (b + vg - 8 + (b2 & 0x0f)) & 0xff;
+                ops.push_back(OP_LUMA);
+            } else {
+                run = b1 & 0x3f;
+                ops.push_back(OP_RUN);
+            }
+            index[(r * 3 + g * 5 + b * 7 + a * 11) % 64] = (uint32_t)r << 24 | (uint32_t)g << 16 | (uint32_t)b << 8 | a;
+        } else {
+            return false;
+        }
+        px = Rgb{(uint8_t)r, (uint8_t)g, (uint8_t)b};
+    }
+    return p == end && run == 0;   // Không thừa op, không thừa run
+}
+
+struct Image {
+    int width = 0, height = 0, stride = 0;
+    std::vector<uint8_t> bgrx;
+    std::vector<Rgb> rgb;   // Pixel mong đợi, theo hàng
+};
+
+// BGRX giống XImage của stream; đệm cuối hàng (stride > width * 4) điền rác để bắt lỗi đọc lố
+Image make_image(const std::vector<Rgb>& pixels, int width, int pad = 0) {
+    Image img;
+    img.width = width;
+    img.height = (int)(pixels.size() / width);
+    img.stride = width * 4 + pad;
+    img.rgb = pixels;
+    img.bgrx.assign((size_t)img.stride * img.height, 0xA5);
+    for (size_t i = 0; i < pixels.size(); i++) {
+        uint8_t* p = &img.bgrx[(i / width) * img.stride + (i % width) * 4];
+        p[0] = pixels[i].b;
+        p[1] = pixels[i].g;
+        p[2] = pixels[i].r;
+        p[3] = 0;
+    }
+    return img;
+}
+
+int failures = 0;
+
+void fail(const std::string& name, const char* what) {
+    std::printf("[FAIL] %s: %s\n", name.c_str(), what);
+    failures++;
+}
+
+// Nén + giải mã lại, so từng pixel. Trả về danh sách op (rỗng nếu lỗi)
+std::vector<Op> round_trip(const std::string& name, const Image& img, std::vector<uint8_t>* encoded = nullptr) {
+    static const PixelLayout bgrx = PixelLayout::from_masks(0xff0000, 0x00ff00, 0x0000ff, 32, false);
+    std::vector<uint8_t> out;
+    QoiCodec::encode(img.bgrx.data(), img.width, img.height, img.stride, bgrx, out);
+    if (out.size() > QoiCodec::max_size(img.width, img.height)) fail(name, "output larger than max_size");
+
+    std::vector<Rgb> decoded;
+    std::vector<Op> ops;
+    if (!decode_reference(out, img.width, img.height, decoded, ops)) {
+        fail(name, "reference decoder rejected stream");
+        return {};
+    }
+    for (size_t i = 0; i < decoded.size(); i++) {
+        if (decoded[i].r != img.rgb[i].r || decoded[i].g != img.rgb[i].g || decoded[i].b != img.rgb[i].b) {
+            std::printf("[FAIL] %s: pixel %zu differs\n", name.c_str(), i);
+            failures++;
+            return {};
+        }
+    }
+    if (encoded) *encoded = out;
+    return ops;
+}
+
+void expect_ops(const std::string& name, const std::vector<Op>& got, const std::vector<Op>& expect) {
+    if (got != expect) fail(name, "unexpected op sequence");
+}
+
+uint32_t g_seed = 0x2545F491u;
+uint8_t rnd() { g_seed = g_seed * 1664525u + 1013904223u; return (uint8_t)(g_seed >> 24); }
+
+void test_runs() {
+    const Rgb a{200, 10, 30}, b{7, 99, 180};
+    // 1 pixel a + 62 pixel a nữa = run đầy (62), rồi b để run không phải ở cuối ảnh
+    for (int len : {62, 63}) {
+        std::vector<Rgb> px(1, a);
+        px.insert(px.end(), len, a);
+        px.push_back(b);
+        std::vector<uint8_t> enc;
+        const std::vector<Op> ops = round_trip("run " + std::to_string(len), make_image(px, (int)px.size()), &enc);
+        if (len == 62) {
+            expect_ops("run 62", ops, {OP_RGB, OP_RUN, OP_RGB});
+            if (enc.size() > 18 && enc[18] != (0xc0 | 61)) fail("run 62", "run byte is not 0xfd");
+        } else {
+            expect_ops("run 63", ops, {OP_RGB, OP_RUN, OP_RUN, OP_RGB});
+            if (enc.size() > 19 && (enc[18] != (0xc0 | 61) || enc[19] != 0xc0)) fail("run 63", "runs are not 62 + 1");
+        }
+    }
+    // Run kết thúc đúng pixel cuối (n == total), giữa chừng qua biên hàng
+    {
+        std::vector<Rgb> px = {b, a, b};
+        px.insert(px.end(), 10 * 3 - px.size(), a);
+        const std::vector<Op> ops = round_trip("run to last pixel", make_image(px, 10));
+        if (ops.empty() || ops.back() != OP_RUN) fail("run to last pixel", "last op is not a run");
+    }
+    // Pixel đầu tiên trùng pixel trước mặc định (0, 0, 0) -> run ngay từ đầu, cả ảnh
+    round_trip("all black", make_image(std::vector<Rgb>(5 * 4, Rgb{0, 0, 0}), 5));
+}
+
+void test_index() {
+    const Rgb a{200, 10, 30}, b{7, 99, 180};
+    expect_ops("index", round_trip("index", make_image({a, b, a, b}, 4)), {OP_RGB, OP_RGB, OP_INDEX, OP_INDEX});
+}
+
+// prev -> prev + (dr, dg, db) là pixel thứ 2; pixel đầu dùng RGB
+void expect_second_op(const std::string& name, int dr, int dg, int db, Op expect) {
+    const Rgb base{128, 128, 128};
+    const Rgb next{(uint8_t)(base.r + dr), (uint8_t)(base.g + dg), (uint8_t)(base.b + db)};
+    const std::vector<Op> ops = round_trip(name, make_image({base, next}, 2));
+    if (ops.size() != 2 || ops[1] != expect) fail(name, "wrong op chosen");
+}
+
+void test_diff_luma_bounds() {
+    expect_second_op("diff -2", -2, -2, -2, OP_DIFF);
+    expect_second_op("diff +1", 1, 1, 1, OP_DIFF);
+    expect_second_op("diff r -3", -3, 0, 0, OP_LUMA);
+    expect_second_op("diff r +2", 2, 0, 0, OP_LUMA);
+    expect_second_op("diff g -3", 0, -3, 0, OP_LUMA);
+    expect_second_op("diff g +2", 0, 2, 0, OP_LUMA);
+    expect_second_op("diff b -3", 0, 0, -3, OP_LUMA);
+    expect_second_op("diff b +2", 0, 0, 2, OP_LUMA);
+    expect_second_op("luma vg -32", -32, -32, -32, OP_LUMA);
+    expect_second_op("luma vg +31", 31, 31, 31, OP_LUMA);
+    expect_second_op("luma vg -33", -33, -33, -33, OP_RGB);
+    expect_second_op("luma vg +32", 32, 32, 32, OP_RGB);
+    expect_second_op("luma dr-dg -8", 10 - 8, 10, 10 + 7, OP_LUMA);
+    expect_second_op("luma dr-dg +7", 10 + 7, 10, 10 - 8, OP_LUMA);
+    expect_second_op("luma dr-dg -9", 10 - 9, 10, 10, OP_RGB);
+    expect_second_op("luma db-dg +8", 10, 10, 10 + 8, OP_RGB);
+    // Tràn 8 bit: 255 -> 0 là +1 theo modulo 256
+    {
+        const std::vector<Op> ops = round_trip("diff wrap", make_image({{255, 255, 255}, {0, 0, 0}}, 2));
+        if (ops.size() != 2 || ops[1] != OP_DIFF) fail("diff wrap", "wrap-around delta is not DIFF");
+    }
+}
+
+// Ảnh kiểu màn hình: dải màu phẳng (run), vài màu lặp (index), gradient (diff/luma), nhiễu (rgb)
+std::vector<Rgb> screen_like(int width, int height) {
+    std::vector<Rgb> px((size_t)width * height);
+    const Rgb palette[4] = {{30, 30, 36}, {250, 250, 250}, {60, 110, 200}, {200, 200, 200}};
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            Rgb& p = px[(size_t)y * width + x];
+            const int zone = (x / 97 + y) % 4;
+            if (zone == 0) p = palette[(x / 13) % 4];
+            else if (zone == 1) p = Rgb{(uint8_t)x, (uint8_t)(x + y), (uint8_t)(y * 3)};
+            else if (zone == 2) p = Rgb{rnd(), rnd(), rnd()};
+            else p = palette[1];
+        }
+    }
+    return px;
+}
+
+void test_widths_and_stride() {
+    for (int width : {1, 3, 511, 512, 513, 1024, 1100}) {
+        for (int pad : {0, 36}) {
+            const std::string name = "width " + std::to_string(width) + " pad " + std::to_string(pad);
+            round_trip(name, make_image(screen_like(width, 4), width, pad));
+        }
+    }
+}
+
+} // namespace
+
+int main() {
+    test_runs();
+    test_index();
+    test_diff_luma_bounds();
+    test_widths_and_stride();
+
+    if (failures) {
+        std::printf("%d case(s) failed\n", failures);
+        return 1;
+    }
+    std::printf("OK\n");
+    return 0;
+}
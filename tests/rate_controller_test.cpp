@@ -0,0 +1,133 @@
+// RateController với chuỗi độ trễ tổng hợp (target 200 ms, 30 fps, quality 80).
+// Kiểm: latency_ms = 0 thì tắt hẳn; nghẽn kéo dài thì hạ quality tới 30 trước, rồi FPS tới 2, rồi
+// thu nhỏ 2x / 4x, không xuống dưới sàn; giữa 2 lần giảm cách ít nhất 250 ms; hết nghẽn thì chờ 1 s
+// dưới 60% target mới tăng và quay về đúng fps / quality / scale ban đầu. Chạy qua ctest.
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include "utils/RateController.hpp"
+
+namespace {
+
+constexpr int TARGET = 200, FPS = 30, QUALITY = 80;
+
+int failures = 0;
+
+void fail(const std::string& name, const std::string& what) {
+    std::printf("[FAIL] %s: %s\n", name.c_str(), what.c_str());
+    failures++;
+}
+
+std::string describe(const RateController::Decision& d) {
+    return std::to_string(d.fps) + " fps, quality " + std::to_string(d.quality) + ", scale " + std::to_string(d.scale);
+}
+
+bool same(const RateController::Decision& a, const RateController::Decision& b) {
+    return a.fps == b.fps && a.quality == b.quality && a.scale == b.scale;
+}
+
+void expect_decision(const std::string& name, const RateController& rc, int fps, int quality, int scale) {
+    const RateController::Decision& d = rc.decision();
+    if (d.fps != fps || d.quality != quality || d.scale != scale) {
+        fail(name, "got " + describe(d) + ", expected " + std::to_string(fps) + " fps, quality " +
+                       std::to_string(quality) + ", scale " + std::to_string(scale));
+    }
+}
+
+void test_disabled() {
+    RateController rc;
+    rc.reset(0, FPS, QUALITY);
+    if (rc.enabled()) fail("disabled", "enabled() with latency_ms 0");
+    for (int64_t t = 1000; t < 20000; t += 300) {
+        if (rc.update(5000, t)) fail("disabled", "update() reported a change");
+    }
+    expect_decision("disabled", rc, FPS, QUALITY, 1);
+    if (rc.budget() != 1.0) fail("disabled", "budget moved");
+}
+
+void test_decrease_factor() {
+    RateController rc;
+    rc.reset(TARGET, FPS, QUALITY);
+    if (!rc.enabled()) fail("decrease factor", "not enabled with latency_ms 200");
+    rc.update(TARGET + 50, 1000);
+    if (rc.budget() != 0.75) fail("decrease factor", "over target should scale the budget by 0.75");
+    // Lần giảm kế tiếp phải chờ 250 ms
+    rc.update(3 * TARGET, 1100);
+    if (rc.budget() != 0.75) fail("decrease factor", "decreased again within 250 ms");
+    rc.update(3 * TARGET, 1250);
+    if (rc.budget() != 0.375) fail("decrease factor", "over 2x target should halve the budget");
+    // Giữa 60% và 100% target: giữ nguyên
+    const RateController::Decision d = rc.decision();
+    for (int64_t t = 1500; t < 6000; t += 100) {
+        if (rc.update(0.8 * TARGET, t)) fail("decrease factor", "changed between 60% and 100% of target");
+    }
+    if (!same(d, rc.decision()) || rc.budget() != 0.375) fail("decrease factor", "drifted inside the dead band");
+}
+
+// Nghẽn liên tục rồi hết nghẽn: thứ tự bậc, sàn, hold 1 s, quay về đúng tham số gốc
+void test_steps_and_recovery(int base_fps, int base_quality) {
+    const std::string name = "steps " + std::to_string(base_fps) + " fps / quality " + std::to_string(base_quality);
+    const int min_fps = base_fps < RateController::MIN_FPS ? base_fps : RateController::MIN_FPS;
+    const int min_quality = base_quality < RateController::MIN_QUALITY ? base_quality : RateController::MIN_QUALITY;
+    RateController rc;
+    rc.reset(TARGET, base_fps, base_quality);
+    expect_decision(name + " initial", rc, base_fps, base_quality, 1);
+
+    RateController::Decision prev = rc.decision();
+    int64_t t = 1000;
+    int64_t last_decrease = 0;
+    bool saw_scale2 = false;
+    for (int i = 0; i < 40; i++, t += 250) {
+        const bool changed = rc.update(1.5 * TARGET, t);
+        last_decrease = t;
+        const RateController::Decision& d = rc.decision();
+        if (changed == same(prev, d)) fail(name, "update() return value does not match the decision change");
+        if (d.quality > prev.quality || d.fps > prev.fps || d.scale < prev.scale) fail(name, "went up while congested");
+        if (d.quality < min_quality || d.fps < min_fps || d.scale > 4) fail(name, "below the floor: " + describe(d));
+        // Thứ tự: FPS chỉ giảm khi quality đã ở sàn, thu nhỏ chỉ khi FPS đã ở sàn
+        if (d.fps < base_fps && d.quality != min_quality) fail(name, "fps dropped before quality hit the floor: " + describe(d));
+        if (d.scale > 1 && d.fps != min_fps) fail(name, "scaled before fps hit the floor: " + describe(d));
+        if (d.scale == 2) saw_scale2 = true;
+        if (d.scale == 4 && !saw_scale2) fail(name, "jumped to 4x without passing 2x");
+        prev = d;
+    }
+    expect_decision(name + " congested", rc, min_fps, min_quality, 4);
+
+    // Hết nghẽn: chưa đủ 1 s từ lần giảm cuối thì chưa tăng
+    const double budget = rc.budget();
+    for (t = last_decrease + 100; t < last_decrease + 1000; t += 100) {
+        rc.update(0.5 * TARGET, t);
+    }
+    if (rc.budget() != budget) fail(name, "increased within 1 s of the last decrease");
+    // Dưới target nhưng trên 60%: không tăng
+    rc.update(0.7 * TARGET, last_decrease + 1000);
+    if (rc.budget() != budget) fail(name, "increased above 60% of target");
+
+    for (t = last_decrease + 1000; t < last_decrease + 60000; t += 100) {
+        rc.update(0.5 * TARGET, t);
+        const RateController::Decision& d = rc.decision();
+        if (d.quality > min_quality && (d.fps != base_fps || d.scale != 1)) {
+            fail(name, "quality raised before fps / scale recovered: " + describe(d));
+            break;
+        }
+    }
+    expect_decision(name + " recovered", rc, base_fps, base_quality, 1);
+    if (rc.budget() != 1.0) fail(name, "budget did not return to 1");
+}
+
+} // namespace
+
+int main() {
+    test_disabled();
+    test_decrease_factor();
+    test_steps_and_recovery(FPS, QUALITY);
+    // Tham số gốc dưới sàn: sàn là chính tham số gốc, không bị nâng lên
+    test_steps_and_recovery(1, 20);
+
+    if (failures) {
+        std::printf("%d case(s) failed\n", failures);
+        return 1;
+    }
+    std::printf("OK\n");
+    return 0;
+}
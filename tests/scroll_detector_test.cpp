@@ -0,0 +1,175 @@
+// ScrollDetector trên frame tổng hợp: 1 vùng nội dung (như trang web) cuộn dọc giữa phần đứng yên
+// (thanh tiêu đề, sidebar). Bitmap changed lấy từ TileDiffer::update như stream thật.
+// Kiểm: dst / dy đúng từng hàng với dy dương, âm, không chia hết 64, cuộn nối tiếp nhiều lần;
+// nội dung frame mới trong dst đúng bằng frame cũ ở (y - dy) (đúng nghĩa copy rect client sẽ làm);
+// không báo cuộn khi vùng đổi sang nội dung khác hẳn, chỉ dịch ngang, hoặc đoạn hàng khớp chủ yếu do
+// nền lặp (chỉ 1 khối nhỏ thật sự dịch). Chạy qua ctest.
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "utils/ScrollDetector.hpp"
+#include "utils/TileDiffer.hpp"
+
+namespace {
+
+constexpr int W = 1280, H = 720, BPP = 4;
+constexpr int TILE = TileDiffer::TILE_SIZE;
+// Vùng cuộn: cột theo biên tile, trên / dưới không theo biên tile
+constexpr int REGION_X = 2 * TILE, REGION_W = 14 * TILE;
+constexpr int REGION_Y = 100, REGION_H = 520;
+constexpr int DOC_H = 3000;
+
+struct Rng {
+    uint32_t state;
+    uint8_t next() { state = state * 1664525u + 1013904223u; return (uint8_t)(state >> 24); }
+};
+
+// Mỗi hàng ngẫu nhiên -> hash hàng duy nhất (như chữ trên trang web)
+std::vector<uint8_t> random_rows(int width, int height, uint32_t seed) {
+    std::vector<uint8_t> v((size_t)width * height * BPP);
+    Rng rng{seed};
+    for (auto& b : v) b = rng.next();
+    return v;
+}
+
+const std::vector<uint8_t> g_background = random_rows(W, H, 1);
+const std::vector<uint8_t> g_document = random_rows(REGION_W, DOC_H, 2);
+
+// Frame: nền đứng yên + vùng cuộn hiện doc từ hàng doc_top, dịch ngang shift_x pixel
+std::vector<uint8_t> make_frame(int doc_top, int shift_x = 0, const std::vector<uint8_t>* doc = nullptr) {
+    const std::vector<uint8_t>& d = doc ? *doc : g_document;
+    std::vector<uint8_t> f = g_background;
+    for (int y = 0; y < REGION_H; y++) {
+        for (int x = 0; x < REGION_W; x++) {
+            const int sx = (x + shift_x) % REGION_W;
+            const uint8_t* s = &d[((size_t)(doc_top + y) * REGION_W + sx) * BPP];
+            uint8_t* p = &f[((size_t)(REGION_Y + y) * W + REGION_X + x) * BPP];
+            for (int c = 0; c < BPP; c++) p[c] = s[c];
+        }
+    }
+    return f;
+}
+
+int failures = 0;
+
+void fail(const std::string& name, const std::string& what) {
+    std::printf("[FAIL] %s: %s\n", name.c_str(), what.c_str());
+    failures++;
+}
+
+struct Stream {
+    TileDiffer differ;
+    ScrollDetector detector;
+    std::vector<uint8_t> prev;
+
+    bool feed(const std::vector<uint8_t>& frame, ScrollCopy& copy) {
+        const std::vector<uint8_t>& changed = differ.update(frame.data(), W, H, W * BPP, BPP);
+        const bool found = detector.update(frame.data(), W, H, W * BPP, BPP, changed, differ.was_reset(), copy);
+        prev = frame;
+        return found;
+    }
+};
+
+// Cuộn từ doc_top cũ sang doc_top - dy (dy > 0: nội dung đi xuống)
+void expect_scroll(const std::string& name, Stream& s, int& doc_top, int dy) {
+    const std::vector<uint8_t> old = s.prev;
+    doc_top -= dy;
+    const std::vector<uint8_t> frame = make_frame(doc_top);
+    ScrollCopy copy;
+    if (!s.feed(frame, copy)) {
+        fail(name, "scroll not detected");
+        return;
+    }
+    // Cột biên của vùng đổi bị bỏ (có thể lẫn phần đứng yên), trên / dưới chính xác tới từng hàng
+    const int ex = REGION_X + TILE, ew = REGION_W - 2 * TILE;
+    const int ey = dy > 0 ? REGION_Y + dy : REGION_Y;
+    const int eh = REGION_H - (dy > 0 ? dy : -dy);
+    if (copy.dy != dy || copy.dst.x != ex || copy.dst.w != ew || copy.dst.y != ey || copy.dst.h != eh) {
+        char buf[160];
+        std::snprintf(buf, sizeof(buf), "got dy %d dst (%d,%d %dx%d), expected dy %d dst (%d,%d %dx%d)", copy.dy,
+                      copy.dst.x, copy.dst.y, copy.dst.w, copy.dst.h, dy, ex, ey, ew, eh);
+        fail(name, buf);
+    }
+    // Copy rect phải tái tạo đúng frame mới trong dst
+    for (int y = copy.dst.y; y < copy.dst.y + copy.dst.h; y++) {
+        const int sy = y - copy.dy;
+        if (sy < 0 || sy >= H) {
+            fail(name, "copy source outside the frame");
+            return;
+        }
+        const size_t row = (size_t)copy.dst.w * BPP;
+        const auto dst_row = frame.begin() + ((size_t)y * W + copy.dst.x) * BPP;
+        if (!std::equal(dst_row, dst_row + row, old.begin() + ((size_t)sy * W + copy.dst.x) * BPP)) {
+            fail(name, "copied rows do not match the new frame at y " + std::to_string(y));
+            return;
+        }
+    }
+}
+
+void expect_no_scroll(const std::string& name, Stream& s, const std::vector<uint8_t>& frame) {
+    ScrollCopy copy;
+    if (s.feed(frame, copy)) fail(name, "reported dy " + std::to_string(copy.dy) + " for a frame that did not scroll");
+}
+
+} // namespace
+
+int main() {
+    // Cuộn nối tiếp trên cùng detector: chỉ tile đổi được hash lại giữa các lần
+    {
+        Stream s;
+        int doc_top = 1200;
+        ScrollCopy copy;
+        if (s.feed(make_frame(doc_top), copy)) fail("first frame", "reported a scroll on reset");
+        for (int dy : {37, -53, 64, -128, 1, -1, 200, -191}) {
+            expect_scroll("dy " + std::to_string(dy), s, doc_top, dy);
+        }
+        // Nhảy gần hết chiều cao vùng: đoạn khớp còn 50 hàng < 1 tile -> không đáng copy
+        doc_top -= REGION_H - 50;
+        expect_no_scroll("run shorter than a tile", s, make_frame(doc_top));
+        expect_no_scroll("identical frame", s, s.prev);
+    }
+    // Vùng đổi sang nội dung khác hẳn (chuyển tab): không có hàng cũ nào khớp
+    {
+        Stream s;
+        ScrollCopy copy;
+        s.feed(make_frame(500), copy);
+        const std::vector<uint8_t> other = random_rows(REGION_W, DOC_H, 3);
+        expect_no_scroll("unrelated content", s, make_frame(500, 0, &other));
+    }
+    // Chỉ dịch ngang (cuộn ngang): hàng không trùng hàng cũ nào, không được báo cuộn dọc
+    {
+        Stream s;
+        ScrollCopy copy;
+        s.feed(make_frame(500), copy);
+        expect_no_scroll("horizontal shift", s, make_frame(500, 8));
+    }
+
+    // Nền sọc lặp chu kỳ 16 hàng, chỉ 40 hàng thật sự dịch 16 + 1 tile hoạt hình ở đáy vùng: hàng khớp
+    // với dy 16 chủ yếu là nền không đổi -> copy không đáng, phải để TileDiffer gửi tile như thường
+    {
+        std::vector<uint8_t> striped = g_document;
+        const size_t row = (size_t)REGION_W * BPP;
+        for (int r = 1240; r < DOC_H; r++) {
+            std::copy_n(&g_document[(size_t)(1240 + (r - 1240) % 16) * row], row, &striped[(size_t)r * row]);
+        }
+        Stream s;
+        ScrollCopy copy;
+        s.feed(make_frame(1200, 0, &striped), copy);
+        std::vector<uint8_t> frame = make_frame(1184, 0, &striped);
+        const std::vector<uint8_t> noise = random_rows(TILE, 20, 4);
+        for (int y = 0; y < 20; y++) {
+            std::copy_n(&noise[(size_t)y * TILE * BPP], TILE * BPP,
+                        &frame[((size_t)(REGION_Y + REGION_H - 20 + y) * W + REGION_X + TILE) * BPP]);
+        }
+        expect_no_scroll("mostly static run", s, frame);
+    }
+
+    if (failures) {
+        std::printf("%d case(s) failed\n", failures);
+        return 1;
+    }
+    std::printf("OK\n");
+    return 0;
+}
@@ -4,6 +4,7 @@ import { ActivatedRoute } from '@angular/router';
 import { CommonModule, JsonPipe } from '@angular/common';
 import { FormsModule } from '@angular/forms';
 import { WebSocketService } from '../../services/websocket.service';
+import { ScreenVideoDecoder } from '../../services/screen-video';
 import { ElementRef, ViewChild } from '@angular/core';
 import { effect } from '@angular/core';
 import { ExplorerEntry } from '../../services/websocket.service';
@@ -80,17 +81,49 @@ stopNoSaveDelay = 0;   // giây
   galleryItems = computed(() => this.ws.galleryItems());
   // Remote control state
   remoteActive = signal<boolean>(false);
-  private remoteIntervalId: any = null;
+  // Tham số stream màn hình (server tự đẩy frame theo FPS)
+  remoteFps = 15;
+  remoteQuality = 60;
+  // Fit: server thu nhỏ ảnh về cỡ khung hiển thị (đỡ băng thông), Native: độ phân giải gốc
+  remoteFit = true;
+  // Tiles: JPEG từng vùng thay đổi; Video: H.264 (nhỏ hơn nhiều khi màn hình đổi liên tục, cần WebCodecs)
+  remoteMode: 'tiles' | 'video' = 'tiles';
+  readonly videoSupported = ScreenVideoDecoder.supported();
+  // Codec của tile: Auto (server chọn theo nội dung từng tile), JPEG (ảnh, video), WebP (nhỏ hơn JPEG,
+  // server tốn CPU hơn, cần libwebp) hoặc lossless (chữ terminal / IDE giữ nét từng pixel)
+  remoteCodec: 'auto' | 'jpeg' | 'webp' | 'lossless' = 'auto';
+  // Làm nét dần: đang đổi thì gửi theo Quality, đứng yên remoteRefineMs thì server gửi lại bản nét
+  remoteRefine: 'off' | 'lossless' | 'high' = 'off';
+  private readonly remoteRefineMs = 300;
+  // Auto: server tự hạ / tăng quality, FPS, cỡ ảnh để giữ độ trễ quanh remoteLatencyMs
+  remoteRate: 'fixed' | 'auto' = 'auto';
+  private readonly remoteLatencyMs = 150;
+  // Lớp simulcast: Thumbnail / Medium / Full dùng chung bản nén với viewer khác cùng lớp, Custom = tham số ở trên
+  remoteLayer: 'custom' | 'thumbnail' | 'medium' | 'full' = 'custom';
+  private remoteViewWidth = 0;
+  private remoteViewResizeTimer: any = null;
   startExeName = "";
   startExeArgs = "";
   startAppName = "";
   startAppArgs = "";
   killAppName = "";
   screenBusy = false;
+  screenMonitor = -1;   // -1 = cả màn hình, >= 0 = chỉ chụp màn hình đó (server chỉ đọc + nén vùng đó)
+  screenFormat: 'jpeg' | 'webp' = 'jpeg';   // WebP: ảnh nhỏ hơn, server không có libwebp thì vẫn trả JPEG
+  screenProgressive = false;   // JPEG progressive: server gửi từng scan, hiện bản thô trước (mạng chậm)
 
   
   killExeName: string = "";
   @ViewChild('webcamCanvas') webcamCanvas!: ElementRef<HTMLCanvasElement>;
+  // Canvas hiển thị REMOTE stream dạng TILES, compositor vẽ trực tiếp lên đây
+  @ViewChild('remoteCanvas') set remoteCanvas(ref: ElementRef<HTMLCanvasElement> | undefined) {
+    this.ws.screenCompositor.attach(ref ? ref.nativeElement : null);
+  }
+  @ViewChild('remoteWrapper') remoteWrapper?: ElementRef<HTMLElement>;
+  // Con trỏ remote (kênh riêng, không nằm trong ảnh)
+  @ViewChild('remoteCursor') set remoteCursor(ref: ElementRef<HTMLCanvasElement> | undefined) {
+    this.ws.screenCursor.attach(ref ? ref.nativeElement : null);
+  }
   private recorder: MediaRecorder | null = null;
   private recordedChunks: Blob[] = [];
   private recording = false;
@@ -159,10 +192,12 @@ stopNoSaveDelay = 0;   // giây
     });
   }
   ngOnDestroy() {
-    if (this.remoteIntervalId) {
-      clearInterval(this.remoteIntervalId);
-      this.remoteIntervalId = null;
+    if (this.remoteActive()) {
+      this.stopRemoteStream();
     }
+    this.ws.screenCompositor.attach(null);
+    this.ws.screenCursor.attach(null);
+    clearTimeout(this.remoteViewResizeTimer);
   }
 
   // ================================
@@ -236,6 +271,8 @@ onDisconnectedCleanup() {
     } else if (m === 'GALLERY') {
       // load media list
       this.ws.sendJson({ module: 'FILE', command: 'LIST' });
+    } else if (m === 'SCREEN') {
+      this.ws.sendJson({ module: 'SCREEN', command: 'LIST_MONITORS' });
     }
   }
   // ================================
@@ -345,7 +382,10 @@ confirmSystemAction() {
   sendScreenCaptureBinary() {
     if (this.screenBusy) return;
   this.screenBusy = true;
-    this.ws.sendJson({ module: "SCREEN", command: "CAPTURE_BINARY" });
+    const payload: any = { format: this.screenFormat };
+    if (this.screenProgressive && this.screenFormat === 'jpeg') payload.progressive = true;
+    if (this.screenMonitor >= 0) payload.monitor = Number(this.screenMonitor);
+    this.ws.sendJson({ module: "SCREEN", command: "CAPTURE_BINARY", payload });
       setTimeout(() => {
     this.screenBusy = false;
   }, 400); // giả lập chờ phản hồi
@@ -814,7 +854,7 @@ private stopWebcamInternal() {
   // GALLERY
   // ================================
   isImage(name: string) {
-  return name.endsWith(".jpg") || name.endsWith(".jpeg") || name.endsWith(".png");
+  return name.endsWith(".jpg") || name.endsWith(".jpeg") || name.endsWith(".png") || name.endsWith(".webp");
 }
   isVideo(name: string) {
     return name.endsWith(".webm") || name.endsWith(".mp4");
@@ -847,32 +887,70 @@ private stopWebcamInternal() {
     this.remoteActive.set(next);
     if (next) {
       // === GẮN KEYBOARD EVENT ===
-    window.addEventListener('keydown', this.keyDownHandler);
-    window.addEventListener('keyup', this.keyUpHandler);
-      // start loop CAPTURE_BINARY (remote)
-      this.ws.sendJson({
-        module: 'SCREEN',
-        command: 'CAPTURE_BINARY',
-        payload: { save: false }
-      });
-      this.remoteIntervalId = setInterval(() => {
-        if (!this.remoteActive()) return;
-        this.ws.sendJson({
-          module: 'SCREEN',
-          command: 'CAPTURE_BINARY',
-          payload: { save: false }
-        });
-      }, 80); // ~12 FPS, tuỳ bạn chỉnh
+      window.addEventListener('keydown', this.keyDownHandler);
+      window.addEventListener('keyup', this.keyUpHandler);
+      // Server tự đẩy frame theo FPS, không cần setInterval gửi CAPTURE_BINARY
+      this.ws.resetScreenStream();
+      this.startRemoteStream();
     } else {
-      if (this.remoteIntervalId) {
-        clearInterval(this.remoteIntervalId);
-        this.remoteIntervalId = null;
-         // === GỠ KEYBOARD EVENT ===
-        window.removeEventListener('keydown', this.keyDownHandler);
-        window.removeEventListener('keyup', this.keyUpHandler);
-      }
+      this.stopRemoteStream();
     }
   }
+  // Bề rộng canvas tính theo pixel thiết bị. Canvas luôn rộng 100% khung nên chỉ giới hạn chiều ngang
+  // (view_height = 0), server chọn hệ số thu nhỏ 2x / 4x sao cho ảnh vẫn không hẹp hơn khung.
+  private measureRemoteView(): number {
+    if (!this.remoteFit) return 0;
+    const el = this.remoteWrapper?.nativeElement;
+    const cssWidth = el && el.clientWidth > 0 ? el.clientWidth - 24 : window.innerWidth; // trừ padding 12px
+    return Math.round(cssWidth * (window.devicePixelRatio || 1));
+  }
+  startRemoteStream() {
+    this.remoteViewWidth = this.measureRemoteView();
+    this.ws.sendJson({
+      module: 'SCREEN',
+      command: 'START_STREAM',
+      payload: {
+        fps: Number(this.remoteFps),
+        quality: Number(this.remoteQuality),
+        view_width: this.remoteViewWidth,
+        view_height: 0,
+        mode: this.remoteMode,
+        codec: this.remoteCodec,
+        refine_ms: this.remoteRefine === 'off' ? 0 : this.remoteRefineMs,
+        refine_quality: this.remoteRefine === 'high' ? 90 : 0,
+        latency_ms: this.remoteRate === 'auto' ? this.remoteLatencyMs : 0,
+        layer: this.remoteLayer
+      }
+    });
+  }
+  // Đổi cỡ cửa sổ / zoom (đổi devicePixelRatio) -> báo lại server, chờ kéo xong mới gửi
+  @HostListener('window:resize')
+  onRemoteViewResize() {
+    if (!this.remoteActive() || !this.remoteFit) return;
+    clearTimeout(this.remoteViewResizeTimer);
+    this.remoteViewResizeTimer = setTimeout(() => {
+      if (this.remoteActive() && this.measureRemoteView() !== this.remoteViewWidth) this.startRemoteStream();
+    }, 300);
+  }
+  stopRemoteStream() {
+    this.ws.sendJson({ module: 'SCREEN', command: 'STOP_STREAM' });
+    // === GỠ KEYBOARD EVENT ===
+    window.removeEventListener('keydown', this.keyDownHandler);
+    window.removeEventListener('keyup', this.keyUpHandler);
+  }
+  // Đổi FPS / quality / Size khi đang stream -> gửi lại START_STREAM để cập nhật
+  onRemoteStreamSettingsChange() {
+    if (this.remoteActive()) this.startRemoteStream();
+  }
+  // Đổi lớp khi đang xem: không gửi lại START_STREAM, server chỉ chuyển session sang lớp mới
+  onRemoteLayerChange() {
+    if (!this.remoteActive()) return;
+    this.ws.sendJson({
+      module: 'SCREEN',
+      command: 'SET_LAYER',
+      payload: { layer: this.remoteLayer }
+    });
+  }
   onRemoteMouseMove(evt: MouseEvent) {
     if (!this.remoteActive()) return;
     const pos = this.getRelativeCoords(evt);
@@ -0,0 +1,137 @@
+// Ghép các vùng (tile) nhận từ message TILES lên 1 canvas giữ ảnh màn hình hiện tại.
+// Server chỉ gửi vùng thay đổi, nên client phải giữ lại phần còn lại của frame trước.
+import { SCREEN_HEADER_SIZE, ScreenCodec } from "./screen-protocol";
+import { decodeQoi } from "./screen-qoi";
+
+interface TileData {
+  x: number;
+  y: number;
+  w: number;
+  h: number;
+  codec: number;
+  data: Uint8Array;
+}
+
+export class ScreenCompositor {
+  // Canvas nền luôn giữ đủ frame, kể cả khi giao diện chưa gắn canvas hiển thị
+  private backing = document.createElement("canvas");
+  private backingCtx = this.backing.getContext("2d")!;
+  private view: HTMLCanvasElement | null = null;
+  private viewCtx: CanvasRenderingContext2D | null = null;
+
+  // Các message được vẽ tuần tự đúng thứ tự nhận (decode ảnh là bất đồng bộ)
+  private chain: Promise<void> = Promise.resolve();
+
+  hasFrame = false;
+
+  attach(canvas: HTMLCanvasElement | null) {
+    this.view = canvas;
+    this.viewCtx = canvas ? canvas.getContext("2d") : null;
+    if (canvas && this.hasFrame) {
+      canvas.width = this.backing.width;
+      canvas.height = this.backing.height;
+      this.viewCtx!.drawImage(this.backing, 0, 0);
+    }
+  }
+
+  reset() {
+    this.chain = Promise.resolve();
+    this.hasFrame = false;
+    this.backing.width = 0;
+    this.backing.height = 0;
+    if (this.view) {
+      this.view.width = 0;
+      this.view.height = 0;
+    }
+  }
+
+  // payload: u16 screen_w, u16 screen_h, u16 count, rồi count × (u16 x,y,w,h, u8 codec, u32 len, data)
+  // Gọi onPainted sau khi vẽ xong message này
+  pushTiles(buff: ArrayBuffer, onPainted?: () => void) {
+    const view = new DataView(buff);
+    let off = SCREEN_HEADER_SIZE;
+    const screenW = view.getUint16(off, true);
+    const screenH = view.getUint16(off + 2, true);
+    const count = view.getUint16(off + 4, true);
+    off += 6;
+
+    const tiles: TileData[] = [];
+    for (let i = 0; i < count && off + 13 <= buff.byteLength; i++) {
+      const x = view.getUint16(off, true);
+      const y = view.getUint16(off + 2, true);
+      const w = view.getUint16(off + 4, true);
+      const h = view.getUint16(off + 6, true);
+      const codec = view.getUint8(off + 8);
+      const len = view.getUint32(off + 9, true);
+      off += 13;
+      if (off + len > buff.byteLength) break;
+      tiles.push({ x, y, w, h, codec, data: new Uint8Array(buff, off, len) });
+      off += len;
+    }
+
+    // Decode song song ngay khi nhận, chỉ phần vẽ là xếp hàng
+    const decoded = Promise.all(tiles.map(t => this.decodeTile(t)));
+    this.chain = this.chain
+      .then(() => decoded)
+      .then(bitmaps => {
+        this.resize(screenW, screenH);
+        bitmaps.forEach((bmp, i) => {
+          const t = tiles[i];
+          if (t.codec === ScreenCodec.COPY && t.data.length >= 4) {
+            // Vẽ canvas lên chính nó: trình duyệt xử lý vùng chồng lấn như copy qua ảnh tạm
+            const sx = t.data[0] | (t.data[1] << 8);
+            const sy = t.data[2] | (t.data[3] << 8);
+            this.backingCtx.drawImage(this.backing, sx, sy, t.w, t.h, t.x, t.y, t.w, t.h);
+          } else if (t.codec === ScreenCodec.SOLID && t.data.length >= 3) {
+            this.backingCtx.fillStyle = `rgb(${t.data[0]}, ${t.data[1]}, ${t.data[2]})`;
+            this.backingCtx.fillRect(t.x, t.y, t.w, t.h);
+          } else if (bmp) {
+            this.backingCtx.drawImage(bmp, t.x, t.y);
+            bmp.close();
+          } else {
+            return;
+          }
+          if (this.viewCtx) {
+            this.viewCtx.drawImage(this.backing, t.x, t.y, t.w, t.h, t.x, t.y, t.w, t.h);
+          }
+        });
+        this.hasFrame = true;
+        onPainted?.();
+      })
+      .catch(err => console.warn("[SCREEN] Tile paint failed:", err));
+  }
+
+  // Chế độ video: vẽ cả khung hình (caller tự close frame)
+  drawFrame(frame: VideoFrame) {
+    this.resize(frame.displayWidth, frame.displayHeight);
+    this.backingCtx.drawImage(frame, 0, 0);
+    if (this.viewCtx) this.viewCtx.drawImage(frame, 0, 0);
+    this.hasFrame = true;
+  }
+
+  private decodeTile(t: TileData): Promise<ImageBitmap | null> {
+    if (t.codec === ScreenCodec.QOI) {
+      const img = decodeQoi(t.data, t.w, t.h);
+      return img ? createImageBitmap(img) : Promise.resolve(null);
+    }
+    if (t.codec === ScreenCodec.WEBP) {
+      return createImageBitmap(new Blob([t.data], { type: "image/webp" }));
+    }
+    // SOLID / COPY không cần decode, xử lý trực tiếp lúc vẽ
+    if (t.codec !== ScreenCodec.JPEG) return Promise.resolve(null);
+    return createImageBitmap(new Blob([t.data], { type: "image/jpeg" }));
+  }
+
+  // Đổi kích thước canvas sẽ xoá nội dung -> chỉ làm khi độ phân giải thật sự đổi
+  private resize(w: number, h: number) {
+    if (this.backing.width !== w || this.backing.height !== h) {
+      this.backing.width = w;
+      this.backing.height = h;
+    }
+    if (this.view && (this.view.width !== w || this.view.height !== h)) {
+      this.view.width = w;
+      this.view.height = h;
+      this.viewCtx!.drawImage(this.backing, 0, 0);
+    }
+  }
+}
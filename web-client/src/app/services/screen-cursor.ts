@@ -0,0 +1,75 @@
+// Con trỏ chuột của máy remote, vẽ đè lên ảnh stream (CURSOR_SHAPE / CURSOR_POS).
+// Server chỉ gửi hình khi đổi, còn lại chỉ vài byte vị trí -> di chuột không phải nhận lại ảnh màn hình.
+import { SCREEN_HEADER_SIZE } from "./screen-protocol";
+
+export class ScreenCursor {
+  private el: HTMLCanvasElement | null = null;
+  private shape: ImageData | null = null;
+  private hotX = 0;
+  private hotY = 0;
+  private x = -1;
+  private y = -1;
+  private screenW = 0;
+  private screenH = 0;
+
+  // el: canvas đặt absolute trong khung chứa ảnh stream, pointer-events: none
+  attach(el: HTMLCanvasElement | null) {
+    this.el = el;
+    if (el) {
+      this.drawShape();
+      this.place();
+    }
+  }
+
+  reset() {
+    this.shape = null;
+    this.x = this.y = -1;
+    if (this.el) this.el.style.display = "none";
+  }
+
+  // payload: u16 w, u16 h, u16 xhot, u16 yhot, rồi w*h*4 byte RGBA
+  setShape(buff: ArrayBuffer) {
+    const view = new DataView(buff);
+    let off = SCREEN_HEADER_SIZE;
+    const w = view.getUint16(off, true);
+    const h = view.getUint16(off + 2, true);
+    this.hotX = view.getUint16(off + 4, true);
+    this.hotY = view.getUint16(off + 6, true);
+    off += 8;
+    if (w === 0 || h === 0 || off + w * h * 4 > buff.byteLength) return;
+    this.shape = new ImageData(new Uint8ClampedArray(buff.slice(off, off + w * h * 4)), w, h);
+    this.drawShape();
+    this.place();
+  }
+
+  // payload: u16 x, u16 y, u16 screen_w, u16 screen_h (pixel màn hình gốc)
+  setPosition(buff: ArrayBuffer) {
+    const view = new DataView(buff);
+    const off = SCREEN_HEADER_SIZE;
+    this.x = view.getUint16(off, true);
+    this.y = view.getUint16(off + 2, true);
+    this.screenW = view.getUint16(off + 4, true);
+    this.screenH = view.getUint16(off + 6, true);
+    this.place();
+  }
+
+  private drawShape() {
+    if (!this.el || !this.shape) return;
+    this.el.width = this.shape.width;
+    this.el.height = this.shape.height;
+    this.el.getContext("2d")!.putImageData(this.shape, 0, 0);
+  }
+
+  // Vị trí / kích thước theo % khung -> tự co giãn theo cỡ ảnh đang hiển thị (kể cả khi server thu nhỏ)
+  private place() {
+    if (!this.el) return;
+    if (!this.shape || this.x < 0 || this.screenW === 0 || this.screenH === 0) {
+      this.el.style.display = "none";
+      return;
+    }
+    this.el.style.display = "block";
+    this.el.style.left = `${((this.x - this.hotX) / this.screenW) * 100}%`;
+    this.el.style.top = `${((this.y - this.hotY) / this.screenH) * 100}%`;
+    this.el.style.width = `${(this.shape.width / this.screenW) * 100}%`;
+  }
+}
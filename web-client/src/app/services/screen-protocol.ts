@@ -0,0 +1,53 @@
+// Định dạng binary của SCREEN stream (khớp với src/modules/ScreenProtocol.hpp)
+//
+// Header 16 byte, little-endian:
+//   [0..1] magic 'S','C' | [2] type | [3] flags | [4..7] seq (u32) | [8..15] timestamp_us (u64)
+
+export const SCREEN_HEADER_SIZE = 16;
+
+export enum ScreenMsgType {
+  FRAME = 1,
+  TILES = 2,   // Chỉ các vùng thay đổi, xem screen-compositor.ts
+  CURSOR_SHAPE = 3,  // Hình con trỏ (RGBA), chỉ gửi khi đổi, xem screen-cursor.ts
+  CURSOR_POS = 4,    // Vị trí con trỏ theo pixel màn hình gốc
+  VIDEO = 5,         // Chế độ video: 1 access unit H.264, xem screen-video.ts
+  JPEG_SCAN = 6,     // 1 scan của ảnh CAPTURE_BINARY progressive: u8 index, u8 count, rồi đoạn byte JPEG
+}
+
+export enum ScreenCodec {
+  JPEG = 0,
+  H264 = 1,
+  QOI = 2,     // Lossless, xem screen-qoi.ts
+  SOLID = 3,   // Cả vùng 1 màu: 3 byte R, G, B
+  COPY = 4,    // Cuộn: u16 src_x, u16 src_y, chép vùng từ ảnh đang có (đứng trước các vùng ảnh)
+  WEBP = 5,    // Ảnh WebP, trình duyệt giải mã như JPEG
+}
+
+// Bit trong byte flags của header
+export const SCREEN_FLAG_KEYFRAME = 0x01;
+
+// Marker kết thúc ảnh JPEG: nối sau các scan đã nhận để giải mã ảnh progressive chưa đủ scan
+export const JPEG_EOI = new Uint8Array([0xff, 0xd9]);
+
+export interface ScreenHeader {
+  type: number;
+  flags: number;
+  seq: number;
+  timestampUs: number;
+}
+
+// JPEG thô bắt đầu bằng FF D8 (WebP bằng "RIFF"), message stream bắt đầu bằng 'S','C'
+export function isScreenMessage(buff: ArrayBuffer): boolean {
+  if (buff.byteLength < SCREEN_HEADER_SIZE) return false;
+  const b = new Uint8Array(buff, 0, 2);
+  return b[0] === 0x53 && b[1] === 0x43;
+}
+
+export function parseScreenHeader(view: DataView): ScreenHeader {
+  return {
+    type: view.getUint8(2),
+    flags: view.getUint8(3),
+    seq: view.getUint32(4, true),
+    timestampUs: Number(view.getBigUint64(8, true)),
+  };
+}
@@ -0,0 +1,67 @@
+// Giải nén tile lossless QOI (CODEC_QOI, khớp với src/utils/QoiCodec.cpp).
+// Định dạng chuẩn https://qoiformat.org: header 14 byte "qoif" + u32 width/height big-endian
+// + channels + colorspace, rồi chuỗi op, kết thúc bằng 7 byte 0x00 và 1 byte 0x01.
+
+const QOI_OP_INDEX = 0x00;
+const QOI_OP_DIFF = 0x40;
+const QOI_OP_LUMA = 0x80;
+const QOI_OP_RUN = 0xc0;
+const QOI_OP_RGB = 0xfe;
+const QOI_OP_RGBA = 0xff;
+const QOI_MASK_2 = 0xc0;
+const QOI_HEADER_SIZE = 14;
+const QOI_END_SIZE = 8;
+
+// null nếu dữ liệu hỏng hoặc kích thước không khớp với tile (w, h)
+export function decodeQoi(data: Uint8Array, w: number, h: number): ImageData | null {
+  if (data.length < QOI_HEADER_SIZE + QOI_END_SIZE) return null;
+  if (data[0] !== 0x71 || data[1] !== 0x6f || data[2] !== 0x69 || data[3] !== 0x66) return null;
+  const view = new DataView(data.buffer, data.byteOffset, data.byteLength);
+  if (view.getUint32(4) !== w || view.getUint32(8) !== h || w === 0 || h === 0) return null;
+
+  const out = new Uint8ClampedArray(w * h * 4);
+  // Bảng 64 màu gần đây, mỗi ô 1 pixel RGBA đóng gói (r<<24 | g<<16 | b<<8 | a)
+  const index = new Uint32Array(64);
+  let r = 0, g = 0, b = 0, a = 255;
+  let run = 0;
+  let p = QOI_HEADER_SIZE;
+  const end = data.length - QOI_END_SIZE;
+
+  for (let o = 0; o < out.length; o += 4) {
+    if (run > 0) {
+      run--;
+    } else if (p < end) {
+      const b1 = data[p++];
+      if (b1 === QOI_OP_RGB) {
+        r = data[p]; g = data[p + 1]; b = data[p + 2];
+        p += 3;
+      } else if (b1 === QOI_OP_RGBA) {
+        r = data[p]; g = data[p + 1]; b = data[p + 2]; a = data[p + 3];
+        p += 4;
+      } else if ((b1 & QOI_MASK_2) === QOI_OP_INDEX) {
+        const px = index[b1];
+        r = px >>> 24; g = (px >>> 16) & 0xff; b = (px >>> 8) & 0xff; a = px & 0xff;
+      } else if ((b1 & QOI_MASK_2) === QOI_OP_DIFF) {
+        r = (r + ((b1 >> 4) & 0x03) - 2) & 0xff;
+        g = (g + ((b1 >> 2) & 0x03) - 2) & 0xff;
+        b = (b + (b1 & 0x03) - 2) & 0xff;
+      } else if ((b1 & QOI_MASK_2) === QOI_OP_LUMA) {
+        const b2 = data[p++];
+        const vg = (b1 & 0x3f) - 32;
+        r = (r + vg - 8 + ((b2 >> 4) & 0x0f)) & 0xff;
+        g = (g + vg) & 0xff;
+        b = (b + vg - 8 + (b2 & 0x0f)) & 0xff;
+      } else if ((b1 & QOI_MASK_2) === QOI_OP_RUN) {
+        run = b1 & 0x3f;
+      }
+      index[(r * 3 + g * 5 + b * 7 + a * 11) % 64] = ((r << 24) | (g << 16) | (b << 8) | a) >>> 0;
+    } else {
+      return null;
+    }
+    out[o] = r;
+    out[o + 1] = g;
+    out[o + 2] = b;
+    out[o + 3] = a;
+  }
+  return new ImageData(out, w, h);
+}
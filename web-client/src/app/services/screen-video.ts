@@ -0,0 +1,85 @@
+// Giải mã stream chế độ video (MSG_VIDEO: H.264 Annex-B) bằng WebCodecs VideoDecoder.
+// Mỗi message là 1 access unit; frame IDR có cờ KEYFRAME và mang SPS/PPS nên không cần "description".
+import { SCREEN_FLAG_KEYFRAME, SCREEN_HEADER_SIZE } from "./screen-protocol";
+
+export class ScreenVideoDecoder {
+  private decoder: VideoDecoder | null = null;
+  private codec = "";
+  private waitingKey = true;
+  private keyRequested = false;
+
+  // onFrame nhận quyền sở hữu VideoFrame (phải close); onNeedKeyframe: gửi REQUEST_KEYFRAME lên server
+  constructor(private onFrame: (frame: VideoFrame) => void, private onNeedKeyframe: () => void) {}
+
+  static supported(): boolean {
+    return typeof (globalThis as any).VideoDecoder === "function";
+  }
+
+  reset() {
+    this.close();
+    this.waitingKey = true;
+    this.keyRequested = false;
+  }
+
+  // payload: u16 width, u16 height, u8 codec, rồi access unit Annex-B
+  push(buff: ArrayBuffer, flags: number, timestampUs: number) {
+    const data = new Uint8Array(buff, SCREEN_HEADER_SIZE + 5);
+    const key = (flags & SCREEN_FLAG_KEYFRAME) !== 0;
+    if (key) {
+      // Cấu hình lại khi profile / level trong SPS đổi (VD đổi độ phân giải)
+      const codec = codecFromSps(data);
+      if (codec && (codec !== this.codec || !this.decoder)) this.configure(codec);
+      this.waitingKey = false;
+      this.keyRequested = false;
+    }
+    if (this.waitingKey || !this.decoder) {
+      // Vào giữa chừng / vừa lỗi: bỏ frame P, xin 1 IDR (chỉ xin 1 lần)
+      if (!this.keyRequested) {
+        this.keyRequested = true;
+        this.onNeedKeyframe();
+      }
+      return;
+    }
+    try {
+      this.decoder.decode(new EncodedVideoChunk({ type: key ? "key" : "delta", timestamp: timestampUs, data }));
+    } catch (err) {
+      this.fail(err);
+    }
+  }
+
+  private configure(codec: string) {
+    this.close();
+    this.decoder = new VideoDecoder({
+      output: frame => this.onFrame(frame),
+      error: err => this.fail(err),
+    });
+    this.decoder.configure({ codec, optimizeForLatency: true });
+    this.codec = codec;
+  }
+
+  private fail(err: unknown) {
+    console.warn("[SCREEN] Video decode failed:", err);
+    this.reset();
+    this.keyRequested = true;
+    this.onNeedKeyframe();
+  }
+
+  private close() {
+    if (this.decoder && this.decoder.state !== "closed") this.decoder.close();
+    this.decoder = null;
+    this.codec = "";
+  }
+}
+
+// Tìm NAL SPS (type 7) trong access unit -> chuỗi codec "avc1.PPCCLL" (profile, constraint, level)
+function codecFromSps(data: Uint8Array): string | null {
+  for (let i = 0; i + 6 < data.length; i++) {
+    if (data[i] !== 0 || data[i + 1] !== 0 || data[i + 2] !== 1) continue;
+    if ((data[i + 3] & 0x1f) === 7) {
+      const hex = (b: number) => b.toString(16).padStart(2, "0");
+      return `avc1.${hex(data[i + 4])}${hex(data[i + 5])}${hex(data[i + 6])}`;
+    }
+    i += 2;
+  }
+  return null;
+}
@@ -1,4 +1,8 @@
 import { Injectable, signal } from "@angular/core";
+import { isScreenMessage, JPEG_EOI, parseScreenHeader, ScreenMsgType, SCREEN_HEADER_SIZE } from "./screen-protocol";
+import { ScreenCompositor } from "./screen-compositor";
+import { ScreenCursor } from "./screen-cursor";
+import { ScreenVideoDecoder } from "./screen-video";
 
 export type WsStatus = "disconnected" | "connecting" | "connected";
 
@@ -28,6 +32,27 @@ export class WebSocketService {
   lastMessage = signal<any>(null);
 
   screenshotUrl = signal<string | null>(null);   // SCREEN / REMOTE frame
+  screenCompositor = new ScreenCompositor();     // REMOTE stream dạng TILES (cập nhật từng vùng)
+  screenTilesActive = signal<boolean>(false);
+  screenCursor = new ScreenCursor();             // Con trỏ remote vẽ đè lên canvas stream
+  screenStreamMode = signal<"tiles" | "video">("tiles");   // Chế độ server thực sự dùng (response START_STREAM)
+  private screenVideo = new ScreenVideoDecoder(
+    frame => {
+      this.screenCompositor.drawFrame(frame);
+      frame.close();
+      if (!this.screenTilesActive()) this.screenTilesActive.set(true);
+    },
+    () => this.sendJson({ module: "SCREEN", command: "REQUEST_KEYFRAME" })
+  );
+  screenMonitors = signal<any[]>([]);            // SCREEN LIST_MONITORS (index dùng cho CAPTURE_BINARY)
+  // Từ lúc gửi CAPTURE_BINARY tới lúc ảnh đầu tiên (progressive: bản thô) / ảnh đủ nét hiện lên (img load)
+  screenshotTiming = signal<{ firstPaintMs: number; fullMs: number | null; scans: number } | null>(null);
+  private captureSentAt = 0;
+  private captureFinalUrl: string | null = null;
+  private captureScans = 0;
+  // Các scan đã nhận của ảnh progressive đang tới (MSG_JPEG_SCAN cùng seq)
+  private scanSeq = -1;
+  private scanParts: Uint8Array[] = [];
   webcamFrameUrl = signal<string | null>(null);  // WEBCAM live
 
   processList = signal<any[]>([]);
@@ -118,6 +143,10 @@ export class WebSocketService {
     if (data.module === "SCREEN" && data.command === "CAPTURE_BINARY") {
       // báo hiệu frame binary tới tiếp theo là screenshot / remote frame
       this.expectingScreenshot = true;
+      this.captureSentAt = performance.now();
+      this.captureFinalUrl = null;
+      this.captureScans = 0;
+      this.screenshotTiming.set(null);
     }
 
     this.socket.send(JSON.stringify(data));
@@ -128,6 +157,21 @@ export class WebSocketService {
   // =============================
   private routeJSON(msg: any) {
 
+    // ---------- SCREEN ----------
+    if (msg.module === "SCREEN" && msg.command === "LIST_MONITORS") {
+      this.screenMonitors.set(msg.data?.monitors || []);
+      return;
+    }
+    if (msg.module === "SCREEN" && msg.command === "CAPTURE_UNCHANGED") {
+      // Ảnh giống lần trước (payload.if_changed): không có frame binary nào theo sau
+      this.expectingScreenshot = false;
+      return;
+    }
+    if (msg.module === "SCREEN" && msg.command === "START_STREAM" && msg.status === "success") {
+      this.screenStreamMode.set(msg.mode === "video" ? "video" : "tiles");
+      return;
+    }
+
     // ---------- PROCESS ----------
     if (msg.module === "PROCESS" && msg.command === "LIST") {
       this.processList.set(msg.data?.process_list || []);
@@ -310,6 +354,12 @@ if (msg.command === "READ_TEXT") {
   // }
   private handleBinary(buff: ArrayBuffer) {
 
+    // SCREEN stream (server tự đẩy, có header 'S','C')
+    if (isScreenMessage(buff)) {
+      this.handleScreenMessage(buff);
+      return;
+    }
+
     // Nếu đang mở 1 file từ gallery → trả binary vào mediaUrl
     if (this.viewingFile()) {
       const file = this.viewingFile()!;
@@ -328,6 +378,8 @@ if (msg.command === "READ_TEXT") {
     if (this.expectingScreenshot) {
       this.expectingScreenshot = false;
       const url = URL.createObjectURL(new Blob([buff]));
+      this.captureFinalUrl = url;
+      this.captureScans = 1;
       this.screenshotUrl.set(url);
       return;
     }
@@ -338,4 +390,83 @@ if (msg.command === "READ_TEXT") {
     this.webcamFrameUrl.set(url);
   }
 
+  // =============================
+  // SCREEN STREAM
+  // =============================
+  // Ảnh CAPTURE_BINARY progressive: nối các scan đã nhận, thêm EOI (FF D9) nếu chưa đủ rồi hiện luôn,
+  // trình duyệt giải mã phần đã có thành ảnh thô, mỗi scan sau nét hơn
+  private handleJpegScan(buff: ArrayBuffer, seq: number) {
+    const view = new DataView(buff);
+    const index = view.getUint8(SCREEN_HEADER_SIZE);
+    const count = view.getUint8(SCREEN_HEADER_SIZE + 1);
+    if (index === 0) {
+      this.scanSeq = seq;
+      this.scanParts = [];
+    } else if (seq !== this.scanSeq || this.scanParts.length !== index) {
+      return;   // Thiếu scan trước đó (ảnh cũ / lỗi) -> bỏ, chờ ảnh sau
+    }
+    this.expectingScreenshot = false;
+    this.scanParts.push(new Uint8Array(buff, SCREEN_HEADER_SIZE + 2));
+
+    const last = index + 1 >= count;
+    const parts: BlobPart[] = last ? this.scanParts : [...this.scanParts, JPEG_EOI];
+    const url = URL.createObjectURL(new Blob(parts, { type: "image/jpeg" }));
+    const old = this.screenshotUrl();
+    if (old && old.startsWith("blob:")) URL.revokeObjectURL(old);
+    this.captureScans = index + 1;
+    if (last) {
+      this.captureFinalUrl = url;
+      this.scanParts = [];
+    }
+    this.screenshotUrl.set(url);
+  }
+
+  // Gọi từ (load) của ảnh screenshot: ghi lại thời điểm ảnh đầu tiên / ảnh cuối cùng của lần chụp hiện lên
+  onScreenshotPainted() {
+    if (!this.captureSentAt) return;
+    const ms = performance.now() - this.captureSentAt;
+    const done = this.screenshotUrl() === this.captureFinalUrl;
+    const firstPaintMs = this.screenshotTiming()?.firstPaintMs ?? ms;
+    this.screenshotTiming.set({ firstPaintMs, fullMs: done ? ms : null, scans: this.captureScans });
+    if (done) {
+      console.log(`[SCREEN] Capture: first paint ${firstPaintMs.toFixed(0)} ms, full ${ms.toFixed(0)} ms (${this.captureScans} scan)`);
+      this.captureSentAt = 0;
+    }
+  }
+
+  private handleScreenMessage(buff: ArrayBuffer) {
+    const view = new DataView(buff);
+    const header = parseScreenHeader(view);
+
+    if (header.type === ScreenMsgType.FRAME) {
+      // payload: u16 width, u16 height, u8 codec, rồi ảnh JPEG
+      const data = new Uint8Array(buff, SCREEN_HEADER_SIZE + 5);
+      const url = URL.createObjectURL(new Blob([data], { type: "image/jpeg" }));
+
+      // Thu hồi URL frame cũ, tránh rò bộ nhớ khi stream liên tục
+      const old = this.screenshotUrl();
+      if (old && old.startsWith("blob:")) URL.revokeObjectURL(old);
+      this.screenshotUrl.set(url);
+    } else if (header.type === ScreenMsgType.TILES) {
+      this.screenCompositor.pushTiles(buff, () => {
+        if (!this.screenTilesActive()) this.screenTilesActive.set(true);
+      });
+    } else if (header.type === ScreenMsgType.JPEG_SCAN) {
+      this.handleJpegScan(buff, header.seq);
+    } else if (header.type === ScreenMsgType.VIDEO) {
+      this.screenVideo.push(buff, header.flags, header.timestampUs);
+    } else if (header.type === ScreenMsgType.CURSOR_SHAPE) {
+      this.screenCursor.setShape(buff);
+    } else if (header.type === ScreenMsgType.CURSOR_POS) {
+      this.screenCursor.setPosition(buff);
+    }
+  }
+
+  resetScreenStream() {
+    this.screenCompositor.reset();
+    this.screenCursor.reset();
+    this.screenVideo.reset();
+    this.screenTilesActive.set(false);
+  }
+
 }